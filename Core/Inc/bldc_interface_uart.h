@@ -27,11 +27,23 @@
 
 // Includes
 #include "packet.h" // For the MAX_PACKET_LEN define
+#include "main.h"
 
 // Functions
 void bldc_interface_uart_init(void(*func)(unsigned char *data, unsigned int len));
 void bldc_interface_uart_process_byte(unsigned char b);
+HAL_StatusTypeDef bldc_interface_uart_start_rx(void);
+void bldc_interface_uart_rx_event(uint16_t pos);
+void bldc_interface_uart_rx_error(void);
+void bldc_interface_uart_process(void);
 void bldc_interface_uart_run_timer(void);
 void send_packet(unsigned char *data, unsigned int len);
+void bldc_interface_uart_tx_complete(void);
+void bldc_interface_uart_tx_error(void);
+void bldc_interface_uart_tx_hold(int hold);
+int bldc_interface_uart_tx_idle(void);
+uint32_t bldc_interface_uart_tx_dropped(void);
+HAL_StatusTypeDef bldc_interface_uart_set_baud(uint32_t baud);
+uint32_t bldc_interface_uart_get_baud(void);
 
 #endif /* BLDC_INTERFACE_UART_H_ */
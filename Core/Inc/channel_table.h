@@ -0,0 +1,51 @@
+/**
+ * @file channel_table.h
+ * @brief Compile-time table of every acquisition channel
+ *
+ * The ADC table lists the regular scan sequence in rank order. It drives
+ * the ADC1 rank configuration, the analog pin setup, the channel IDs and
+ * the names sent to the host in the stream descriptor. Channels that are
+ * computed rather than converted follow in the derived table, with the
+ * DataAcq_Kind_t that tells how their values are scaled and encoded.
+ *
+ * The VESC channels repeat the latest polled motor values, see
+ * vesc_telemetry.h. The PID channels hold the terms of the last closed
+ * loop step in A, see controller.h. The compact record mask limits the
+ * table to 24 channels.
+ *
+ * Wiring matches the README: Panasonic on PA0, load cells 1-8 on
+ * IN3-IN6, IN9, IN10, IN12 and IN13.
+ */
+
+#ifndef CHANNEL_TABLE_H
+#define CHANNEL_TABLE_H
+
+/*        ID              Host name        ADC channel      Port   Pin */
+#define DATAACQ_ADC_CHANNELS(X) \
+    X(PANASONIC,    "panasonic",    ADC_CHANNEL_0,  GPIOA, GPIO_PIN_0) \
+    X(LOAD_CELL_1,  "load_cell_1",  ADC_CHANNEL_3,  GPIOA, GPIO_PIN_3) \
+    X(LOAD_CELL_2,  "load_cell_2",  ADC_CHANNEL_4,  GPIOA, GPIO_PIN_4) \
+    X(LOAD_CELL_3,  "load_cell_3",  ADC_CHANNEL_5,  GPIOA, GPIO_PIN_5) \
+    X(LOAD_CELL_4,  "load_cell_4",  ADC_CHANNEL_6,  GPIOA, GPIO_PIN_6) \
+    X(LOAD_CELL_5,  "load_cell_5",  ADC_CHANNEL_9,  GPIOB, GPIO_PIN_1) \
+    X(LOAD_CELL_6,  "load_cell_6",  ADC_CHANNEL_10, GPIOC, GPIO_PIN_0) \
+    X(LOAD_CELL_7,  "load_cell_7",  ADC_CHANNEL_12, GPIOC, GPIO_PIN_2) \
+    X(LOAD_CELL_8,  "load_cell_8",  ADC_CHANNEL_13, GPIOC, GPIO_PIN_3)
+
+/*        ID              Host name        Kind */
+#define DATAACQ_DERIVED_CHANNELS(X) \
+    X(SET_RPM,      "set_rpm",      FIXED) \
+    X(RPM,          "rpm",          FIXED) \
+    X(HALL_TIME,    "hall_us",      TIME) \
+    X(VESC_V_IN,    "v_in",         MILLI) \
+    X(VESC_I_MOTOR, "i_motor",      MILLI) \
+    X(VESC_DUTY,    "duty",         MILLI) \
+    X(VESC_T_MOS,   "temp_mos",     MILLI) \
+    X(PID_P,        "pid_p",        MILLI) \
+    X(PID_I,        "pid_i",        MILLI) \
+    X(PID_D,        "pid_d",        MILLI) \
+    X(PID_OUT,      "pid_out",      MILLI)
+
+#define DATAACQ_CHANNEL_NAME_LEN    12  // Name field in the stream descriptor, NUL padded
+
+#endif /* CHANNEL_TABLE_H */
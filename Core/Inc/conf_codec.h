@@ -0,0 +1,118 @@
+/**
+ * @file conf_codec.h
+ * @brief Table-driven encoding of VESC configuration structs
+ *
+ * A configuration is described by an array of ConfCodec_Field_t, one per
+ * field in wire order, with the offset and size of the struct member and
+ * its wire encoding. One loop encodes and one loop decodes any described
+ * struct, replacing a hand-written buffer_append_* / buffer_get_* call per
+ * field. The mc_configuration table is generated from mcconf_table.h.
+ *
+ * Wire values are big-endian as in buffer.h. U8 fields may be held in
+ * wider members such as enums, BOOL fields decode any nonzero byte to true
+ * as assigning it to a bool does, floats use the float32_auto encoding.
+ */
+
+#ifndef CONF_CODEC_H
+#define CONF_CODEC_H
+
+#include <stdint.h>
+#include "datatypes.h"
+
+#define CONF_CODEC_MCCONF_MAX_SIZE  384     // Bytes of an encoded mc_configuration, checked at compile time
+
+/* Wire encodings */
+typedef enum {
+    CONF_WIRE_U8 = 0,       // One byte, member of 1, 2 or 4 bytes
+    CONF_WIRE_BOOL,         // One byte, bool member, decoded as nonzero
+    CONF_WIRE_I32,          // buffer_append_int32
+    CONF_WIRE_U32,          // buffer_append_uint32
+    CONF_WIRE_F32,          // buffer_append_float32_auto
+    CONF_WIRE_BYTES         // Raw bytes, size gives the count
+} ConfCodec_Wire_t;
+
+/* Field descriptor, kept in flash */
+typedef struct {
+    uint16_t offset;        // offsetof the member
+    uint8_t size;           // sizeof the member, byte count for CONF_WIRE_BYTES
+    uint8_t wire;           // ConfCodec_Wire_t
+} ConfCodec_Field_t;
+
+/**
+ * @brief Encode a struct
+ * @param fields Field table in wire order
+ * @param count Number of fields
+ * @param conf Struct to encode
+ * @param buffer Destination, at least ConfCodec_WireSize bytes
+ * @return Bytes written
+ */
+int32_t ConfCodec_Encode(const ConfCodec_Field_t* fields, uint32_t count,
+                         const void* conf, uint8_t* buffer);
+
+/**
+ * @brief Decode a struct
+ * @param fields Field table in wire order
+ * @param count Number of fields
+ * @param buffer Encoded bytes
+ * @param length Bytes available
+ * @param conf Destination, fields not in the table are left untouched
+ * @return Bytes read, -1 if the buffer is too short
+ */
+int32_t ConfCodec_Decode(const ConfCodec_Field_t* fields, uint32_t count,
+                         const uint8_t* buffer, int32_t length, void* conf);
+
+/**
+ * @brief Get the encoded size of a table
+ * @param fields Field table
+ * @param count Number of fields
+ * @return Bytes on the wire
+ */
+int32_t ConfCodec_WireSize(const ConfCodec_Field_t* fields, uint32_t count);
+
+/**
+ * @brief Count the fields that differ between two structs
+ * @param fields Field table
+ * @param count Number of fields
+ * @param a First struct
+ * @param b Second struct
+ * @return Fields whose members differ
+ */
+uint32_t ConfCodec_Diff(const ConfCodec_Field_t* fields, uint32_t count, const void* a, const void* b);
+
+/**
+ * @brief Encode an mc_configuration as COMM_SET_MCCONF carries it
+ * @param conf Configuration
+ * @param buffer Destination, at least CONF_CODEC_MCCONF_MAX_SIZE bytes
+ * @return Bytes written
+ */
+int32_t ConfCodec_EncodeMcconf(const mc_configuration* conf, uint8_t* buffer);
+
+/**
+ * @brief Decode a COMM_GET_MCCONF payload
+ * @param buffer Payload after the command byte
+ * @param length Payload length
+ * @param conf Destination
+ * @return Bytes read, -1 if the payload is too short
+ */
+int32_t ConfCodec_DecodeMcconf(const uint8_t* buffer, int32_t length, mc_configuration* conf);
+
+/**
+ * @brief Decode one mc_configuration field
+ * @param index Field position in mcconf_table.h, counted from 0
+ * @param buffer Value in the wire encoding of the field
+ * @param length Bytes available
+ * @param conf Configuration to update
+ * @return Bytes read, -1 for an unknown field or a short buffer
+ */
+int32_t ConfCodec_DecodeMcconfField(uint32_t index, const uint8_t* buffer, int32_t length,
+                                    mc_configuration* conf);
+
+/**
+ * @brief Count the mc_configuration fields that differ
+ * @param a First configuration
+ * @param b Second configuration
+ * @return Fields on the wire whose members differ
+ */
+uint32_t ConfCodec_DiffMcconf(const mc_configuration* a, const mc_configuration* b);
+
+#endif /* CONF_CODEC_H */
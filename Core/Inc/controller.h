@@ -1,9 +1,32 @@
+/**
+ * @file controller.h
+ * @brief Motor setpoint generation and on-board speed control
+ *
+ * In open loop the setpoint from Motor_Input() is sent to the VESC as an
+ * rpm command. In closed loop a PID runs on every TIM3 tick against
+ * MotorSpeed_GetRPM() and sends its output as a motor current, so the
+ * loop is closed on the STM32 without a host round trip. The setpoint is
+ * then in the mechanical rpm the hall decoder measures.
+ *
+ * Gains can be changed at runtime. The terms of the last step are logged
+ * as the pid_* channels, and the core cycles of every PID_Compute are
+ * measured with the DWT counter.
+ */
+
 #ifndef CONTROLLER_H
 #define CONTROLLER_H
 
+#include "stm32f7xx_hal.h"
 #include <stdint.h>
 #include <math.h> // For M_PI
 
+/* Configuration Constants, the gains are starting values, not a tuning */
+#define CONTROLLER_DEFAULT_KP               0.005f  // A per rpm
+#define CONTROLLER_DEFAULT_KI               0.05f   // A per rpm s
+#define CONTROLLER_DEFAULT_KD               0.0f    // A s per rpm
+#define CONTROLLER_DEFAULT_CURRENT_LIMIT    10.0f   // A, output and integral clamp
+#define CONTROLLER_DERIVATIVE_CUTOFF_HZ     100.0f
+
 // PID Controller Structure
 typedef struct {
     float Kp;      // Proportional gain
@@ -14,13 +37,107 @@ typedef struct {
     float prev_error; // Previous error
     float prev_derivative; // Previous derivative
     float derivative_filter_coeff; // Derivative filter coefficient
+    float derivative_filter_cutoff; // Cutoff frequency in Hz, kept to recompute the coefficient
     float integral_limit; //Integral limit for anti-windup
+    float output_limit; // Output is clamped to +-output_limit
+    float proportional; // Terms of the last PID_Compute
+    float derivative;
+    float output;
 } PID_Controller;
 
+typedef enum {
+    CONTROLLER_OPEN_LOOP = 0,   // Setpoint sent to the VESC as an rpm command
+    CONTROLLER_CLOSED_LOOP      // PID output sent as a motor current
+} Controller_Mode_t;
+
+/* Controller statistics */
+typedef struct {
+    uint32_t mode;          // Controller_Mode_t
+    uint32_t computes;      // PID steps since the mode was entered
+    uint32_t saturations;   // Steps whose output hit the current limit
+    uint32_t cycles_last;   // Core cycles of the last PID_Compute
+    uint32_t cycles_max;    // Worst case since the mode was entered
+} Controller_Stats_t;
+
 // Initialize PID controller parameters
 void PID_Init(PID_Controller *pid, float Kp, float Ki, float Kd, float Ts, float derivative_filter_cutoff_freq, float integral_limit);
 
 // PID controller calculation function
 float PID_Compute(PID_Controller *pid, float setpoint, float process_variable);
+
+// Clear the integrator and the derivative history
+void PID_Reset(PID_Controller *pid);
+
+// Change the sampling time, the integrator and the derivative history are kept
+void PID_SetSampleTime(PID_Controller *pid, float Ts);
+
+/**
+ * @brief Reset the controller to open loop with the default gains
+ * @param Ts Tick period in seconds
+ */
+void Controller_Init(float Ts);
+
+/**
+ * @brief Set the tick period the PID is discretized with
+ * @param Ts Tick period in seconds
+ * @note The integrator is kept, so a rate change does not bump the output
+ */
+void Controller_SetSampleTime(float Ts);
+
+/**
+ * @brief Switch between open and closed loop
+ * @param mode Controller_Mode_t
+ * @return HAL_ERROR for an unknown mode
+ * @note The PID starts from a cleared integrator
+ */
+HAL_StatusTypeDef Controller_SetMode(Controller_Mode_t mode);
+
+/**
+ * @brief Get the control mode
+ * @return Controller_Mode_t
+ */
+Controller_Mode_t Controller_GetMode(void);
+
+/**
+ * @brief Set the PID gains and the current limit
+ * @param Kp Proportional gain in A per rpm
+ * @param Ki Integral gain in A per rpm s
+ * @param Kd Derivative gain in A s per rpm
+ * @param current_limit Output and integral clamp in A
+ * @return HAL_ERROR if a gain is negative or not finite or the limit is not positive
+ * @note Safe from the main loop while the tick runs
+ */
+HAL_StatusTypeDef Controller_SetGains(float Kp, float Ki, float Kd, float current_limit);
+
+/**
+ * @brief Take a new setpoint, sent to the VESC right away in open loop
+ * @param setpoint rpm
+ * @note Call from the TIM3 tick
+ */
+void Controller_SetSetpoint(float setpoint);
+
+/**
+ * @brief Run one PID step in closed loop, nothing in open loop
+ * @note Call from the TIM3 tick, every tick
+ */
+void Controller_Tick(void);
+
+/**
+ * @brief Get the terms of the last PID step
+ * @param proportional Destination, may be NULL
+ * @param integral Destination, may be NULL
+ * @param derivative Destination, may be NULL
+ * @param output Destination, may be NULL
+ * @note All 0 in open loop
+ */
+void Controller_GetTerms(float* proportional, float* integral, float* derivative, float* output);
+
+/**
+ * @brief Copy the controller statistics
+ * @param stats Destination
+ */
+void Controller_GetStats(Controller_Stats_t* stats);
+
+// Setpoint of the current tick, see trajectory.h and setpoint.h
 float Motor_Input(void);
 #endif // CONTROLLER_H
@@ -28,6 +28,6 @@
 /*
  * Functions
  */
-unsigned short crc16(unsigned char *buf, unsigned int len);
+unsigned short crc16(const unsigned char *buf, unsigned int len);
 
 #endif /* CRC_H_ */
@@ -4,31 +4,58 @@
  *
  * This module handles data collection from various sources including:
  * - Motor speed and setpoint
+ * - VESC motor telemetry
  * - ADC readings
  * - Timing information
- * It manages double buffering for USB transmission and data scaling.
+ * TIM3 provides a base tick and every channel is sampled once every
+ * divider ticks. Each tick with at least one due channel is pushed as one
+ * record into the sample ring for USB transmission. Records and hall edges
+ * are stamped from the TIM5 microsecond time base, relative to the start
+ * of the acquisition.
+ * ADC1 scans are triggered by TIM2 at oversample times the base rate into a
+ * circular DMA buffer. Each completed half block is averaged per channel
+ * into one coherent snapshot, which the next tick reads.
  */
 
 #ifndef DATA_ACQUISITION_H
 #define DATA_ACQUISITION_H
 
 #include "stm32f7xx_hal.h"
+#include "channel_table.h"
 
 /* Configuration Constants */
-#define USB_BUFFER_SIZE 8000    // Size of each buffer
-#define NUM_CHANNELS    5       // Number of data channels
-#define SCALING_FACTOR  1000.0f // Scaling factor for float to uint32_t conversion
-
-
-extern volatile uint8_t buffer_ready_flag;
+#define DATAACQ_FIXED_FRAC_BITS         4       // Fixed-point channels carry round(value * 2^4)
+#define DATAACQ_MILLI_SCALE             1000    // Milli channels carry round(value * 1000)
+#define DATAACQ_DEFAULT_BASE_RATE_HZ    1000    // TIM3 base tick after reset
+#define DATAACQ_MIN_BASE_RATE_HZ        20      // Limited by the 16-bit TIM3 reload at 1 MHz
+#define DATAACQ_MAX_BASE_RATE_HZ        20000
+#define DATAACQ_ADC_MAX_OVERSAMPLE      16      // Scans averaged per sample, power of two
+#define DATAACQ_ADC_MAX_SCAN_RATE_HZ    12000   // 9 ranks at 84 + 12 cycles of 13.5 MHz, with margin
+
+/* Channel IDs, also the bit position in the record mask. ADC channels come
+ * first so an ADC channel ID equals its scan rank index. */
+#define DATAACQ_ADC_ENUM(id, name, channel, port, pin)  DATAACQ_CH_##id,
+#define DATAACQ_DERIVED_ENUM(id, name, kind)            DATAACQ_CH_##id,
+typedef enum {
+    DATAACQ_ADC_CHANNELS(DATAACQ_ADC_ENUM)
+    DATAACQ_DERIVED_CHANNELS(DATAACQ_DERIVED_ENUM)
+    DATAACQ_NUM_CHANNELS
+} DataAcq_Channel_t;
+#undef DATAACQ_ADC_ENUM
+#undef DATAACQ_DERIVED_ENUM
 
+#define DATAACQ_NUM_ADC_CHANNELS    (DATAACQ_CH_LOAD_CELL_8 + 1)
+#define DATAACQ_NUM_DERIVED_CHANNELS (DATAACQ_NUM_CHANNELS - DATAACQ_NUM_ADC_CHANNELS)
 
-/* Buffer Status Flags */
+/* How a channel value is scaled, sent to the host in the stream descriptor */
 typedef enum {
-    BUFFER_STATUS_OK = 0,
-    BUFFER_STATUS_ERROR,
-    BUFFER_STATUS_FULL
-} BufferStatus_t;
+    DATAACQ_KIND_ADC12 = 0,     // Raw 12-bit ADC counts
+    DATAACQ_KIND_FIXED = 1,     // Signed, int32 value / 2^DATAACQ_FIXED_FRAC_BITS
+    DATAACQ_KIND_TIME  = 2,     // Microseconds since the acquisition start
+    DATAACQ_KIND_MILLI = 3      // Signed, int32 value / DATAACQ_MILLI_SCALE
+} DataAcq_Kind_t;
+#define DATAACQ_ADC_DMA_BUFFER_SIZE (2 * DATAACQ_ADC_MAX_OVERSAMPLE * DATAACQ_NUM_ADC_CHANNELS)
+
 
 /* Public Function Declarations */
 
@@ -39,24 +66,86 @@ typedef enum {
 HAL_StatusTypeDef DataAcq_Init(void);
 
 /**
- * @brief Process new data samples in timer interrupt
- * @param htim Timer handle
+ * @brief Configure the ADC1 scan sequence and analog pins from the channel table
+ * @param hadc ADC1 handle, already initialized by MX_ADC1_Init
+ * @return HAL status
  */
-void DataAcq_ProcessSamples(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef DataAcq_ConfigAdcScan(ADC_HandleTypeDef* hadc);
+
+/**
+ * @brief Start the circular ADC1 DMA into the half block buffer
+ * @param hadc ADC1 handle, configured by DataAcq_ConfigAdcScan
+ * @return HAL status
+ */
+HAL_StatusTypeDef DataAcq_StartAdc(ADC_HandleTypeDef* hadc);
+
+/**
+ * @brief Average one completed half block into the next ADC snapshot
+ * @param half 0 from the half transfer callback, 1 from the transfer complete callback
+ */
+void DataAcq_AdcBlockCallback(uint8_t half);
+
+/**
+ * @brief Get the host name of a channel
+ * @param channel Channel ID
+ * @return Name string, NULL for an unknown channel
+ */
+const char* DataAcq_GetChannelName(uint8_t channel);
+
+/**
+ * @brief Get the value kind of a channel
+ * @param channel Channel ID
+ * @return Kind, DATAACQ_KIND_ADC12 for an unknown channel
+ */
+DataAcq_Kind_t DataAcq_GetChannelKind(uint8_t channel);
+
+/**
+ * @brief Set the base tick rate of TIM3 and the ADC scan rate of TIM2
+ * @param rate_hz Tick rate, rounded to a whole number of microseconds per tick
+ * @return HAL_ERROR if the rate is out of range
+ * @note Above DATAACQ_ADC_MAX_SCAN_RATE_HZ the ADC cannot finish a scan per
+ *       tick and ADC channels repeat their last snapshot
+ */
+HAL_StatusTypeDef DataAcq_SetBaseRate(uint32_t rate_hz);
 
 /**
- * @brief Get the current buffer status
- * @return 1 if buffer is ready for transmission, 0 otherwise
+ * @brief Get the number of ADC scans averaged into each sample
+ * @return Oversampling ratio, 1 to DATAACQ_ADC_MAX_OVERSAMPLE
  */
+uint32_t DataAcq_GetOversample(void);
 
-uint8_t DataAcq_IsBufferReady(void);
+/**
+ * @brief Get the effective base tick rate
+ * @return Base rate in Hz
+ */
+uint32_t DataAcq_GetBaseRate(void);
+
+/**
+ * @brief Set the decimation factor of one channel
+ * @param channel Channel ID
+ * @param divider Channel is sampled every divider base ticks, 1 means every tick
+ * @return HAL_ERROR for an unknown channel or a zero divider
+ */
+HAL_StatusTypeDef DataAcq_SetChannelDivider(uint8_t channel, uint16_t divider);
+
+/**
+ * @brief Get the decimation factor of one channel
+ * @param channel Channel ID
+ * @return Divider, 0 for an unknown channel
+ */
+uint16_t DataAcq_GetChannelDivider(uint8_t channel);
+
+/**
+ * @brief Process new data samples in timer interrupt
+ * @param htim Timer handle
+ */
+void DataAcq_ProcessSamples(TIM_HandleTypeDef* htim);
 
 /**
- * @brief Get pointer to the ready buffer for transmission
- * @param buffer_size Pointer to store the buffer size
- * @return Pointer to the ready buffer, NULL if no buffer ready
+ * @brief Get the number of samples dropped because the host fell behind
+ * @return Overrun count since the last DataAcq_Init
  */
-uint32_t* DataAcq_GetReadyBuffer(uint32_t* buffer_size);
+uint32_t DataAcq_GetOverrunCount(void);
 
 
 uint32_t Get_MilliSecond(void);
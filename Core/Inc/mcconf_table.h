@@ -0,0 +1,113 @@
+/**
+ * @file mcconf_table.h
+ * @brief Compile-time table of the mc_configuration wire format
+ *
+ * One entry per field in the order COMM_GET_MCCONF and COMM_SET_MCCONF put
+ * them on the wire, for VESC firmware 3.39 and 3.40. The type gives the
+ * wire encoding, the last column the byte count of BYTES fields. The table
+ * expands into the ConfCodec_Field_t descriptors that mcconf_encode and
+ * mcconf_decode walk, so a firmware change is an edit here only.
+ */
+
+#ifndef MCCONF_TABLE_H
+#define MCCONF_TABLE_H
+
+/*    Wire    Field                               Bytes */
+#define MCCONF_FIELDS(X) \
+    X(U8,    pwm_mode,                            0) \
+    X(U8,    comm_mode,                           0) \
+    X(U8,    motor_type,                          0) \
+    X(U8,    sensor_mode,                         0) \
+    X(F32,   l_current_max,                       0) \
+    X(F32,   l_current_min,                       0) \
+    X(F32,   l_in_current_max,                    0) \
+    X(F32,   l_in_current_min,                    0) \
+    X(F32,   l_abs_current_max,                   0) \
+    X(F32,   l_min_erpm,                          0) \
+    X(F32,   l_max_erpm,                          0) \
+    X(F32,   l_erpm_start,                        0) \
+    X(F32,   l_max_erpm_fbrake,                   0) \
+    X(F32,   l_max_erpm_fbrake_cc,                0) \
+    X(F32,   l_min_vin,                           0) \
+    X(F32,   l_max_vin,                           0) \
+    X(F32,   l_battery_cut_start,                 0) \
+    X(F32,   l_battery_cut_end,                   0) \
+    X(BOOL,  l_slow_abs_current,                  0) \
+    X(F32,   l_temp_fet_start,                    0) \
+    X(F32,   l_temp_fet_end,                      0) \
+    X(F32,   l_temp_motor_start,                  0) \
+    X(F32,   l_temp_motor_end,                    0) \
+    X(F32,   l_temp_accel_dec,                    0) \
+    X(F32,   l_min_duty,                          0) \
+    X(F32,   l_max_duty,                          0) \
+    X(F32,   l_watt_max,                          0) \
+    X(F32,   l_watt_min,                          0) \
+    X(F32,   sl_min_erpm,                         0) \
+    X(F32,   sl_min_erpm_cycle_int_limit,         0) \
+    X(F32,   sl_max_fullbreak_current_dir_change, 0) \
+    X(F32,   sl_cycle_int_limit,                  0) \
+    X(F32,   sl_phase_advance_at_br,              0) \
+    X(F32,   sl_cycle_int_rpm_br,                 0) \
+    X(F32,   sl_bemf_coupling_k,                  0) \
+    X(BYTES, hall_table,                          8) \
+    X(F32,   hall_sl_erpm,                        0) \
+    X(F32,   foc_current_kp,                      0) \
+    X(F32,   foc_current_ki,                      0) \
+    X(F32,   foc_f_sw,                            0) \
+    X(F32,   foc_dt_us,                           0) \
+    X(BOOL,  foc_encoder_inverted,                0) \
+    X(F32,   foc_encoder_offset,                  0) \
+    X(F32,   foc_encoder_ratio,                   0) \
+    X(U8,    foc_sensor_mode,                     0) \
+    X(F32,   foc_pll_kp,                          0) \
+    X(F32,   foc_pll_ki,                          0) \
+    X(F32,   foc_motor_l,                         0) \
+    X(F32,   foc_motor_r,                         0) \
+    X(F32,   foc_motor_flux_linkage,              0) \
+    X(F32,   foc_observer_gain,                   0) \
+    X(F32,   foc_observer_gain_slow,              0) \
+    X(F32,   foc_duty_dowmramp_kp,                0) \
+    X(F32,   foc_duty_dowmramp_ki,                0) \
+    X(F32,   foc_openloop_rpm,                    0) \
+    X(F32,   foc_sl_openloop_hyst,                0) \
+    X(F32,   foc_sl_openloop_time,                0) \
+    X(F32,   foc_sl_d_current_duty,               0) \
+    X(F32,   foc_sl_d_current_factor,             0) \
+    X(BYTES, foc_hall_table,                      8) \
+    X(F32,   foc_sl_erpm,                         0) \
+    X(BOOL,  foc_sample_v0_v7,                    0) \
+    X(BOOL,  foc_sample_high_current,             0) \
+    X(F32,   foc_sat_comp,                        0) \
+    X(BOOL,  foc_temp_comp,                       0) \
+    X(F32,   foc_temp_comp_base_temp,             0) \
+    X(F32,   foc_current_filter_const,            0) \
+    X(F32,   s_pid_kp,                            0) \
+    X(F32,   s_pid_ki,                            0) \
+    X(F32,   s_pid_kd,                            0) \
+    X(F32,   s_pid_kd_filter,                     0) \
+    X(F32,   s_pid_min_erpm,                      0) \
+    X(BOOL,  s_pid_allow_braking,                 0) \
+    X(F32,   p_pid_kp,                            0) \
+    X(F32,   p_pid_ki,                            0) \
+    X(F32,   p_pid_kd,                            0) \
+    X(F32,   p_pid_kd_filter,                     0) \
+    X(F32,   p_pid_ang_div,                       0) \
+    X(F32,   cc_startup_boost_duty,               0) \
+    X(F32,   cc_min_current,                      0) \
+    X(F32,   cc_gain,                             0) \
+    X(F32,   cc_ramp_step_max,                    0) \
+    X(I32,   m_fault_stop_time_ms,                0) \
+    X(F32,   m_duty_ramp_step,                    0) \
+    X(F32,   m_current_backoff_gain,              0) \
+    X(U32,   m_encoder_counts,                    0) \
+    X(U8,    m_sensor_port_mode,                  0) \
+    X(BOOL,  m_invert_direction,                  0) \
+    X(U8,    m_drv8301_oc_mode,                   0) \
+    X(U8,    m_drv8301_oc_adj,                    0) \
+    X(F32,   m_bldc_f_sw_min,                     0) \
+    X(F32,   m_bldc_f_sw_max,                     0) \
+    X(F32,   m_dc_f_sw,                           0) \
+    X(F32,   m_ntc_motor_beta,                    0) \
+    X(U8,    m_out_aux_mode,                      0)
+
+#endif /* MCCONF_TABLE_H */
@@ -0,0 +1,80 @@
+/**
+ * @file memory_map.h
+ * @brief Placement of the interrupt path in tightly coupled memory
+ *
+ * The F767 fetches code from flash with wait states and shares SRAM1 and
+ * the L1 caches with the main loop, so the TIM3 tick jitters with whatever
+ * the main loop last touched. The linker script sets up three extra regions:
+ *   ITCM   code tagged ITCM_CODE, copied from flash by the startup
+ *   DTCM   zero-initialized data tagged DTCM_BSS, the heap and the stack
+ *   SRAM2  buffers tagged DMA_BUFFER, non-cacheable through the MPU
+ * TCM accesses take one cycle and never go through the cache. Initialized
+ * data stays in SRAM1, so only tag objects that start out as zero.
+ *
+ * Both L1 caches are on. DMA buffers in SRAM2 need no cache maintenance,
+ * but the DMA paths still call MemoryMap_CleanDCache before a transfer
+ * reads memory and MemoryMap_InvalidateDCache before the core reads what a
+ * transfer wrote. Both return at once for SRAM2 and DTCM, and keep the
+ * buffers correct wherever else they are placed. DMA_BUFFER aligns to a
+ * cache line. Buffers DMA writes must also span whole lines, so an
+ * invalidate never drops a neighbour's data. USB OTG FS runs without DMA,
+ * the core moves its data through the FIFOs, so its buffers stay cached.
+ *
+ * Build with MEMORY_MAP_TCM set to 0 to compare the interrupt cycle
+ * counts. Everything tagged above, the TIM3 and TIM4 handlers and the HAL
+ * timer callbacks then stay in flash and SRAM1, and the DMA buffers are
+ * cacheable, so the maintenance calls do the work. The linker script does
+ * not see the macro: HAL_TIM_IRQHandler and HAL_TIM_ReadCapturedValue,
+ * picked by section name, and the stack stay in TCM in both builds, so the
+ * comparison leaves out the HAL dispatch and stack accesses. Flash both
+ * builds, run the same rate and channel set and compare the tick and hall
+ * cycles of the 'Q' stats frame (UsbIsrStats_t).
+ */
+
+#ifndef MEMORY_MAP_H
+#define MEMORY_MAP_H
+
+#include "stm32f7xx_hal.h"
+
+/* Configuration Constants */
+#ifndef MEMORY_MAP_TCM
+#define MEMORY_MAP_TCM  1
+#endif
+
+#define MEMORY_MAP_CACHE_LINE   32      // Cortex-M7 L1 data cache line in bytes
+
+#if MEMORY_MAP_TCM
+#define ITCM_CODE   __attribute__((section(".itcm_text"), noinline))
+#define DTCM_BSS    __attribute__((section(".dtcm_bss")))
+#define DMA_BUFFER  __attribute__((section(".dma_buffer"), aligned(32)))
+#else
+#define ITCM_CODE
+#define DTCM_BSS
+#define DMA_BUFFER  __attribute__((aligned(32)))
+#endif
+
+/* Public Function Declarations */
+
+/**
+ * @brief Make SRAM2 non-cacheable and enable the MPU
+ * @note Call before the caches are enabled and before any DMA is started
+ */
+void MemoryMap_ConfigureMpu(void);
+
+/**
+ * @brief Write cached data of a buffer back before a DMA transfer reads it
+ * @param addr Start of the range
+ * @param size Length in bytes
+ * @note Lines partly in the range are written back whole
+ */
+void MemoryMap_CleanDCache(const volatile void* addr, uint32_t size);
+
+/**
+ * @brief Drop cached data of a buffer before the core reads what DMA wrote
+ * @param addr Start of the range
+ * @param size Length in bytes
+ * @note Lines partly in the range are dropped whole, see DMA_BUFFER
+ */
+void MemoryMap_InvalidateDCache(const volatile void* addr, uint32_t size);
+
+#endif /* MEMORY_MAP_H */
@@ -0,0 +1,89 @@
+/**
+ * @file motor_command.h
+ * @brief Rate-limited motor command scheduler for the VESC
+ *
+ * The TIM3 tick only stores the latest setpoint. The main loop sends it when
+ * its value on the wire changes, at most at the maximum rate, and repeats it
+ * at the keep-alive rate so the VESC timeout does not release the motor
+ * while the setpoint is constant. Setpoints stored between two sends
+ * collapse into the last one, and the command leaves in the same USART2
+ * burst as the telemetry poll.
+ */
+
+#ifndef MOTOR_COMMAND_H
+#define MOTOR_COMMAND_H
+
+#include "stm32f7xx_hal.h"
+#include <stdint.h>
+
+/* Configuration Constants */
+#define MOTOR_COMMAND_DEFAULT_MAX_RATE_HZ   1000    // Changed setpoints go out at most this often
+#define MOTOR_COMMAND_DEFAULT_KEEPALIVE_HZ  20      // Well inside the 1 s VESC default timeout
+#define MOTOR_COMMAND_LIMIT_RATE_HZ         10000
+
+typedef enum {
+    MOTOR_COMMAND_NONE = 0,     // Nothing is sent, the VESC timeout releases the motor
+    MOTOR_COMMAND_RPM,          // COMM_SET_RPM, electrical rpm
+    MOTOR_COMMAND_CURRENT,      // COMM_SET_CURRENT, A
+    MOTOR_COMMAND_BRAKE,        // COMM_SET_CURRENT_BRAKE, A
+    MOTOR_COMMAND_DUTY          // COMM_SET_DUTY, -1 to 1
+} MotorCommand_Mode_t;
+
+/* Scheduler statistics */
+typedef struct {
+    uint32_t updates;       // Setpoints stored
+    uint32_t sent;          // Commands sent
+    uint32_t keepalives;    // Sends that repeated an unchanged setpoint
+    uint32_t coalesced;     // Setpoints replaced by a later one or equal to the last sent
+} MotorCommand_Stats_t;
+
+/* Public Function Declarations */
+
+/**
+ * @brief Reset the setpoint, rates and statistics
+ */
+void MotorCommand_Init(void);
+
+/**
+ * @brief Store a setpoint
+ * @param mode Control mode, MOTOR_COMMAND_NONE stops sending
+ * @param value Setpoint in the unit of the mode
+ * @note Safe from interrupts, sending is left to MotorCommand_Task.
+ *       Ignored while stopped.
+ */
+void MotorCommand_Set(MotorCommand_Mode_t mode, float value);
+
+/**
+ * @brief Stop sending and ignore setpoints until MotorCommand_Release
+ * @note Safe from interrupts. A tick preempted by the stop cannot restart
+ *       the motor with the setpoint it stores afterwards.
+ */
+void MotorCommand_Stop(void);
+
+/**
+ * @brief Accept setpoints again
+ * @note MotorCommand_Init leaves the scheduler stopped
+ */
+void MotorCommand_Release(void);
+
+/**
+ * @brief Set the send rates
+ * @param max_rate_hz Highest rate for changed setpoints
+ * @param keepalive_hz Repeat rate for an unchanged setpoint, 0 sends changes only
+ * @return HAL_ERROR if a rate is out of range
+ */
+HAL_StatusTypeDef MotorCommand_SetRates(uint32_t max_rate_hz, uint32_t keepalive_hz);
+
+/**
+ * @brief Send the setpoint when it changed or the keep-alive is due
+ * @note Call from the main loop
+ */
+void MotorCommand_Task(void);
+
+/**
+ * @brief Copy the scheduler statistics
+ * @param stats Destination
+ */
+void MotorCommand_GetStats(MotorCommand_Stats_t* stats);
+
+#endif /* MOTOR_COMMAND_H */
@@ -3,7 +3,16 @@
  * @brief Header file for motor speed measurement using hall sensor input capture
  *
  * This module handles speed measurement using timer input capture on STM32.
- * It processes hall sensor pulses to calculate motor RPM using TIM4.
+ * TIM4 captures both edges of all three hall inputs, so every commutation
+ * (six per electrical cycle) is timed. The hall state read on each edge
+ * gives the sector and, from the step to the previous sector, the
+ * direction. The speed is updated from the period of the sector that just
+ * ended, and also averaged over the last full electrical cycle, which
+ * cancels the spacing error of the hall sensors.
+ *
+ * Edges are dated on the 32-bit TIM5 time base, so periods of any length
+ * are measured without counting TIM4 overflows. Between edges the reported
+ * speed falls as the wait grows and drops to 0 after the stall timeout.
  */
 
 #ifndef MOTOR_SPEED_H
@@ -13,7 +22,20 @@
 #include <stdint.h>
 
 /* Configuration Constants */
-#define MOTOR_SPEED_HALL_PULSES_PER_REV 21   // Number of hall sensor pulses per revolution
+#define MOTOR_SPEED_POLE_PAIRS          7       // Electrical cycles per revolution
+#define MOTOR_SPEED_HALL_SECTORS        6       // Hall edges per electrical cycle
+#define MOTOR_SPEED_HALL_EDGES_PER_REV  (MOTOR_SPEED_POLE_PAIRS * MOTOR_SPEED_HALL_SECTORS)
+#define MOTOR_SPEED_FORWARD_SIGN        1       // Flip to -1 if the measured rpm opposes the VESC rpm
+#define MOTOR_SPEED_DEFAULT_STALL_US    200000  // No edge for this long reads as 0 rpm, about 7 rpm and below
+
+/* Decoder statistics */
+typedef struct {
+    uint32_t edges;         // Hall edges that moved to a neighbouring sector
+    uint32_t glitches;      // Edges that left the hall state unchanged
+    uint32_t skips;         // Edges that jumped over a sector
+    uint32_t invalid;       // Edges that read hall state 0 or 7
+} MotorSpeed_Stats_t;
+
 /* Public Function Declarations */
 
 /**
@@ -25,10 +47,54 @@ HAL_StatusTypeDef MotorSpeed_Init(TIM_HandleTypeDef* htim);
 
 /**
  * @brief Get the current motor speed in RPM
- * @return Current speed in RPM (0 if motor is stopped)
+ * @return Speed from the last sector period, negative in reverse (0 if motor is stopped)
+ * @note Safe from interrupts, limited by the time since the last edge
  */
 float MotorSpeed_GetRPM(void);
 
+/**
+ * @brief Get the motor speed averaged over the last electrical cycle
+ * @return Speed in RPM, negative in reverse, 0 until six sectors ran in one direction
+ */
+float MotorSpeed_GetCycleRPM(void);
+
+/**
+ * @brief Set the stall timeout
+ * @param timeout_us Time without a hall edge after which the speed reads 0
+ * @return HAL_ERROR if the timeout is 0
+ */
+HAL_StatusTypeDef MotorSpeed_SetStallTimeout(uint32_t timeout_us);
+
+/**
+ * @brief Get the hall state
+ * @return H3 H2 H1 as bits 2..0, 1 to 6 when valid
+ */
+uint8_t MotorSpeed_GetHallState(void);
+
+/**
+ * @brief Get the direction of rotation
+ * @return 1 forward, -1 reverse, 0 before the first step
+ */
+int8_t MotorSpeed_GetDirection(void);
+
+/**
+ * @brief Get the period of the last sector
+ * @return Microseconds between the last two hall edges, 0 before the second edge
+ */
+uint32_t MotorSpeed_GetSectorPeriod(void);
+
+/**
+ * @brief Get the time of the last hall edge
+ * @return Capture time on the Timestamp_Now() time base, the init time before the first edge
+ */
+uint32_t MotorSpeed_GetLastEdgeTime(void);
+
+/**
+ * @brief Copy the decoder statistics
+ * @param stats Destination
+ */
+void MotorSpeed_GetStats(MotorSpeed_Stats_t* stats);
+
 /**
  * @brief Timer input capture callback handler
  * @param htim Pointer to TIM_HandleTypeDef structure
@@ -0,0 +1,68 @@
+/**
+ * @file sample_codec.h
+ * @brief Compact binary encoding of sample records
+ *
+ * Each record is encoded as
+ *   uint8 counter delta | uint16 time delta | uint24 mask | ADC values | derived values
+ * When the deltas do not fit, or for the first record of a frame, the counter
+ * delta byte is SAMPLE_CODEC_ESCAPE and is followed by the absolute uint32
+ * counter and uint32 time_us instead of the time delta. Frames therefore
+ * decode on their own, whatever was lost before them.
+ *
+ * ADC values flagged in the mask are packed two per 3 bytes, low 12 bits
+ * first, and an odd last one takes 2 bytes. Derived values take 3 bytes:
+ * DATAACQ_KIND_FIXED and DATAACQ_KIND_MILLI as their int32 value in signed
+ * 24-bit, saturated, so milli channels are limited to +-8388.607, and
+ * DATAACQ_KIND_TIME as the unsigned 24-bit age before the record time,
+ * saturated at about 16 s. All fields are little-endian.
+ *
+ * The decoder is the reference for host implementations and is not used by
+ * the firmware itself.
+ */
+
+#ifndef SAMPLE_CODEC_H
+#define SAMPLE_CODEC_H
+
+#include <stdint.h>
+#include "data_acquisition.h"
+#include "sample_ring.h"
+
+/* Configuration Constants */
+#define SAMPLE_CODEC_ESCAPE     0xFF        // Counter delta byte of an absolute record
+#define SAMPLE_CODEC_MAX_SIZE   (12 + ((DATAACQ_NUM_ADC_CHANNELS + 1) / 2) * 3 + 3 * DATAACQ_NUM_DERIVED_CHANNELS)
+
+/* Previous record of a stream, the base of the next deltas */
+typedef struct {
+    uint32_t counter;
+    uint32_t time_us;
+    uint8_t started;        // 0 until the first record, which is always absolute
+} SampleCodec_State_t;
+
+/* Public Function Declarations */
+
+/**
+ * @brief Start a new self-contained block, the next record is sent absolute
+ * @param state Encoder or decoder state
+ */
+void SampleCodec_Reset(SampleCodec_State_t* state);
+
+/**
+ * @brief Encode one record
+ * @param state Encoder state
+ * @param record Record to encode, only channels flagged in its mask are read
+ * @param out Destination with room for SAMPLE_CODEC_MAX_SIZE bytes
+ * @return Number of bytes written
+ */
+uint32_t SampleCodec_Encode(SampleCodec_State_t* state, const SampleRecord_t* record, uint8_t* out);
+
+/**
+ * @brief Decode one record
+ * @param state Decoder state
+ * @param in Encoded bytes
+ * @param length Bytes available at in
+ * @param record Destination, values of channels not in the mask are left untouched
+ * @return Number of bytes consumed, 0 if the input is truncated
+ */
+uint32_t SampleCodec_Decode(SampleCodec_State_t* state, const uint8_t* in, uint32_t length, SampleRecord_t* record);
+
+#endif /* SAMPLE_CODEC_H */
@@ -0,0 +1,97 @@
+/**
+ * @file sample_pack.h
+ * @brief Column-wise delta and bit-packing compression of sample records
+ *
+ * A block of records is split into columns: counter, time_us, mask and
+ * then one column per channel holding only the values flagged in the
+ * masks. Each column is written as
+ *   uint32 first value | per run of up to SAMPLE_PACK_BLOCK residuals:
+ *   uint8 width | residuals, width bits each, LSB first, padded to a byte
+ * A residual is the zigzag coded difference of order 0 (the value itself),
+ * 1 (delta) or 2 (delta of delta) in wrapping 32-bit arithmetic, with the
+ * delta before the first value taken as 0. Counter and time use order 2 and
+ * mask order 1. Every non-empty channel column starts with a uint8 order
+ * byte, so the order can be chosen per channel by the sender.
+ *
+ * Slowly varying channels drop to a few bits per value, constant ones to
+ * one byte per SAMPLE_PACK_BLOCK values. Columns never grow past their raw
+ * 32-bit size by more than the width and order bytes.
+ *
+ * The sender sizes each block to its frame: SamplePack_AddRecord() tracks
+ * the exact encoded size while records are collected, and the block ends
+ * before the record that would not fit, or at SAMPLE_PACK_MAX_RECORDS.
+ */
+
+#ifndef SAMPLE_PACK_H
+#define SAMPLE_PACK_H
+
+#include <stdint.h>
+#include "data_acquisition.h"
+#include "sample_ring.h"
+
+/* Configuration Constants */
+#define SAMPLE_PACK_BLOCK           32      // Residuals sharing one bit width
+#define SAMPLE_PACK_MAX_RECORDS     128     // Records per packed block, bounds the sender's block buffer
+#define SAMPLE_PACK_MAX_ORDER       2
+#define SAMPLE_PACK_NUM_COLUMNS     (3 + DATAACQ_NUM_CHANNELS)
+#define SAMPLE_PACK_RECORD_MAX_SIZE (3 * 4 + DATAACQ_NUM_CHANNELS * 5)  // Block of one record
+#define SAMPLE_PACK_MAX_SIZE        (SAMPLE_PACK_NUM_COLUMNS * \
+                                     (4 * SAMPLE_PACK_MAX_RECORDS + (SAMPLE_PACK_MAX_RECORDS + 30) / SAMPLE_PACK_BLOCK + 1))
+
+/* Encoded size of one column while its block is collected */
+typedef struct {
+    uint32_t count;         // Values in the column
+    uint32_t prev;          // Last value
+    uint32_t prev_delta;    // Last first difference
+    uint32_t run_count;     // Residuals in the open run
+    uint32_t run_any;       // OR of the zigzag residuals of the open run
+    uint32_t closed;        // Bytes before the open run
+} SamplePack_ColumnSize_t;
+
+/* Encoded size of a block while it is collected */
+typedef struct {
+    SamplePack_ColumnSize_t column[SAMPLE_PACK_NUM_COLUMNS];
+    uint8_t orders[DATAACQ_NUM_CHANNELS];   // Orders the block is sized for, pass them to SamplePack_Encode
+    uint32_t size;          // Encoded bytes of the records added so far
+} SamplePack_Sizer_t;
+
+/* Public Function Declarations */
+
+/**
+ * @brief Start sizing a new block
+ * @param sizer Block size state
+ * @param orders Delta order per channel, copied so later changes cannot resize the block
+ */
+void SamplePack_BeginBlock(SamplePack_Sizer_t* sizer, const uint8_t* orders);
+
+/**
+ * @brief Add the next record of the block to its size
+ * @param sizer Block size state
+ * @param record Record in stream order
+ * @return Encoded size of the block with this record. When it exceeds the
+ *         room, end the block before this record and start a new one.
+ */
+uint32_t SamplePack_AddRecord(SamplePack_Sizer_t* sizer, const SampleRecord_t* record);
+
+/**
+ * @brief Compress a block of records
+ * @param records Records in stream order
+ * @param count Number of records, at most SAMPLE_PACK_MAX_RECORDS
+ * @param orders Delta order per channel, 0 to SAMPLE_PACK_MAX_ORDER
+ * @param out Destination with room for SAMPLE_PACK_MAX_SIZE bytes, or the size
+ *            SamplePack_AddRecord() returned for the last record
+ * @return Number of bytes written
+ */
+uint32_t SamplePack_Encode(const SampleRecord_t* records, uint32_t count, const uint8_t* orders, uint8_t* out);
+
+/**
+ * @brief Decompress a block of records
+ * @param in Packed bytes
+ * @param length Bytes available at in
+ * @param count Number of records in the block, at most SAMPLE_PACK_MAX_RECORDS
+ * @param records Destination for count records
+ * @return Number of bytes consumed, 0 if the input is truncated or invalid
+ */
+uint32_t SamplePack_Decode(const uint8_t* in, uint32_t length, uint32_t count, SampleRecord_t* records);
+
+#endif /* SAMPLE_PACK_H */
@@ -0,0 +1,73 @@
+/**
+ * @file sample_ring.h
+ * @brief Lock-free single-producer/single-consumer ring of sample records
+ *
+ * The TIM3 sampling interrupt is the only producer and usb_transmit_task()
+ * in the main loop is the only consumer. Each side owns one index, so no
+ * locking is required. When the ring is full, new records are dropped and
+ * counted as overruns, never silently overwritten.
+ */
+
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include "stm32f7xx_hal.h"
+#include <stdint.h>
+#include "data_acquisition.h"
+
+/* Configuration Constants */
+#define SAMPLE_RING_SIZE 1024   // Number of records, must be a power of two
+
+/* One acquisition tick */
+typedef struct {
+    uint32_t counter;       // Record sequence number, gaps mean dropped records
+    uint32_t time_us;       // TIM5 time since the acquisition start
+    uint32_t mask;          // Bit n set when channel n was sampled on this tick
+    uint32_t value[DATAACQ_NUM_CHANNELS];  // Only entries flagged in mask are valid
+} SampleRecord_t;
+
+/* Public Function Declarations */
+
+/**
+ * @brief Empty the ring and clear its statistics
+ * @note Only call from the consumer while the producer is stopped
+ */
+void SampleRing_Init(void);
+
+/**
+ * @brief Append a record (producer side)
+ * @param record Record to copy into the ring
+ * @return 1 if stored, 0 if the ring was full and the record was dropped
+ */
+uint8_t SampleRing_Push(const SampleRecord_t* record);
+
+/**
+ * @brief Remove the oldest record (consumer side)
+ * @param record Destination for the record
+ * @return 1 if a record was read, 0 if the ring was empty
+ */
+uint8_t SampleRing_Pop(SampleRecord_t* record);
+
+/**
+ * @brief Read the oldest record without removing it (consumer side)
+ * @param record Destination for the record
+ * @return 1 if a record was read, 0 if the ring was empty
+ */
+uint8_t SampleRing_Peek(SampleRecord_t* record);
+
+/**
+ * @brief Get the number of records waiting to be consumed
+ */
+uint32_t SampleRing_Count(void);
+
+/**
+ * @brief Get the number of records dropped because the ring was full
+ */
+uint32_t SampleRing_GetOverruns(void);
+
+/**
+ * @brief Get the highest fill level seen since the last init
+ */
+uint32_t SampleRing_GetHighWater(void);
+
+#endif /* SAMPLE_RING_H */
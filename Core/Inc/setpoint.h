@@ -0,0 +1,110 @@
+/**
+ * @file setpoint.h
+ * @brief Table-driven setpoint waveform generator
+ *
+ * Waveforms run from 32-bit DDS phase accumulators advanced once per TIM3
+ * tick, so frequencies are exact to 2^-32 of the tick rate and a chirp
+ * sweeps without phase jumps. Sines are read from a 1024 entry lookup
+ * table with linear interpolation, the tick never calls a transcendental
+ * function. All waveforms are bias + amplitude * shape:
+ *   SETPOINT_CONSTANT   bias
+ *   SETPOINT_SINE       sine at f0
+ *   SETPOINT_MULTISINE  harmonics of f0 up to f1 with Schroeder phases,
+ *                       amplitude / tones each so the sum never exceeds it
+ *   SETPOINT_CHIRP      linear sweep f0 to f1 over duration s, then again
+ *   SETPOINT_STEP       0 then 1 for half a period of f0 each
+ *   SETPOINT_PRBS       -1 or 1 from a 15-bit LFSR clocked at f0
+ *   SETPOINT_TABLE      uploaded table played once per period of f0
+ * Table values are written with Setpoint_WriteTable, held between entries.
+ */
+
+#ifndef SETPOINT_H
+#define SETPOINT_H
+
+#include "stm32f7xx_hal.h"
+#include <stdint.h>
+
+/* Configuration Constants */
+#define SETPOINT_SINE_BITS          10      // log2 of the sine table length
+#define SETPOINT_MAX_TONES          8       // Multisine components
+#define SETPOINT_TABLE_SIZE         1024    // Entries of the uploaded table
+#define SETPOINT_DEFAULT_BIAS       1500.0f // Constant rpm after reset
+
+typedef enum {
+    SETPOINT_CONSTANT = 0,
+    SETPOINT_SINE,
+    SETPOINT_MULTISINE,
+    SETPOINT_CHIRP,
+    SETPOINT_STEP,
+    SETPOINT_PRBS,
+    SETPOINT_TABLE,
+    SETPOINT_NUM_WAVEFORMS
+} Setpoint_Waveform_t;
+
+/* Waveform parameters, unused ones are ignored */
+typedef struct {
+    uint32_t waveform;      // Setpoint_Waveform_t
+    float bias;             // rpm
+    float amplitude;        // rpm
+    float f0;               // Hz, start or fundamental frequency, PRBS bit rate
+    float f1;               // Hz, chirp end frequency, highest multisine harmonic
+    float duration;         // s, chirp sweep time
+} Setpoint_Params_t;
+
+/* Public Function Declarations */
+
+/**
+ * @brief Fill the sine table and load the constant default
+ * @param tick_rate_hz TIM3 base rate
+ */
+void Setpoint_Init(uint32_t tick_rate_hz);
+
+/**
+ * @brief Load a waveform, it starts from phase 0 on the next tick
+ * @param params Waveform parameters
+ * @return HAL_ERROR for an unknown waveform, frequencies at or above half
+ *         the tick rate, a chirp without duration or an empty table
+ */
+HAL_StatusTypeDef Setpoint_Load(const Setpoint_Params_t* params);
+
+/**
+ * @brief Get the loaded waveform parameters
+ * @param params Destination
+ */
+void Setpoint_GetParams(Setpoint_Params_t* params);
+
+/**
+ * @brief Recompute the phase increments for a new tick rate
+ * @param tick_rate_hz TIM3 base rate
+ */
+void Setpoint_SetTickRate(uint32_t tick_rate_hz);
+
+/**
+ * @brief Restart the loaded waveform from phase 0
+ */
+void Setpoint_Restart(void);
+
+/**
+ * @brief Write entries of the arbitrary table
+ * @param offset First entry
+ * @param values Shape values as floats, usually -1 to 1, any alignment
+ * @param count Number of values
+ * @return HAL_ERROR if the entries do not fit the table
+ * @note Writing at offset 0 sets the table length to count, later writes
+ *       extend it. A playing table uses new entries right away.
+ */
+HAL_StatusTypeDef Setpoint_WriteTable(uint16_t offset, const void* values, uint32_t count);
+
+/**
+ * @brief Advance the waveform by one tick
+ * @note Call from the TIM3 tick, every tick
+ */
+void Setpoint_Tick(void);
+
+/**
+ * @brief Get the setpoint at the current phase
+ * @return rpm
+ */
+float Setpoint_GetValue(void);
+
+#endif /* SETPOINT_H */
@@ -27,7 +27,7 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
-
+#include "timestamp.h"
 /* USER CODE END Includes */
 
 /* Exported types ------------------------------------------------------------*/
@@ -64,7 +64,8 @@ void USART2_IRQHandler(void);
 void DMA2_Stream0_IRQHandler(void);
 void OTG_FS_IRQHandler(void);
 /* USER CODE BEGIN EFP */
-
+void Irq_GetCycleStats(Timestamp_CycleStats_t* tick, Timestamp_CycleStats_t* hall);
+void Irq_ResetCycleStats(void);
 /* USER CODE END EFP */
 
 #ifdef __cplusplus
@@ -0,0 +1,72 @@
+/**
+ * @file timestamp.h
+ * @brief Free-running 32-bit microsecond time base on TIM5
+ *
+ * TIM5 counts at 1 MHz from the APB1 timer clock and wraps after about
+ * 71 minutes. It is never stopped or reloaded, so differences of two
+ * timestamps are exact across a wrap when taken as uint32_t. TIM4 runs
+ * from the same clock at the same rate, which lets hall captures be
+ * mapped onto this time base.
+ *
+ * The DWT cycle counter is enabled alongside for measuring code paths in
+ * core clock cycles.
+ */
+
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include "stm32f7xx_hal.h"
+#include <stdint.h>
+
+/* Core cycles of a measured code path */
+typedef struct {
+    uint32_t count;     // Measurements taken
+    uint32_t last;      // Cycles of the last one
+    uint32_t max;       // Worst case since the last reset
+} Timestamp_CycleStats_t;
+
+/* Public Function Declarations */
+
+/**
+ * @brief Start the free-running time base and the DWT cycle counter
+ * @param htim Pointer to TIM_HandleTypeDef structure for TIM5
+ * @return HAL status
+ */
+HAL_StatusTypeDef Timestamp_Init(TIM_HandleTypeDef* htim);
+
+/**
+ * @brief Get the current time
+ * @return Microseconds since Timestamp_Init, modulo 2^32
+ */
+static inline uint32_t Timestamp_Now(void)
+{
+    return TIM5->CNT;
+}
+
+/**
+ * @brief Get the DWT cycle counter
+ * @return Core clock cycles, modulo 2^32
+ */
+static inline uint32_t Timestamp_Cycles(void)
+{
+    return DWT->CYCCNT;
+}
+
+/**
+ * @brief Record the cycles since a Timestamp_Cycles() reading
+ * @param stats Statistics to update
+ * @param start Timestamp_Cycles() at the start of the measured path
+ * @note Only call from the context that owns stats
+ */
+static inline void Timestamp_RecordCycles(volatile Timestamp_CycleStats_t* stats, uint32_t start)
+{
+    uint32_t cycles = DWT->CYCCNT - start;
+
+    stats->last = cycles;
+    if (cycles > stats->max) {
+        stats->max = cycles;
+    }
+    stats->count++;
+}
+
+#endif /* TIMESTAMP_H */
@@ -0,0 +1,89 @@
+/**
+ * @file trajectory.h
+ * @brief Host-uploaded setpoint trajectory with double-buffered streaming
+ *
+ * A trajectory is a list of rpm setpoints, one per set_rpm channel sample,
+ * so point n is applied and logged in the same record. It is held in two
+ * banks. The host fills the free bank in chunks and commits it, while the
+ * other one plays, so profiles of any length can be streamed. Only two
+ * banks can be committed at a time, and a write to a bank that is still
+ * committed is refused.
+ *
+ * When playback reaches the end of a bank whose successor is not
+ * committed yet, the last point is held and an underrun is counted. The
+ * last point of a bank committed as final is held until playback stops.
+ */
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include "stm32f7xx_hal.h"
+#include <stdint.h>
+
+/* Configuration Constants */
+#define TRAJECTORY_BANK_SIZE    2048    // Points per bank, 2 s at 1 kHz
+
+typedef enum {
+    TRAJECTORY_IDLE = 0,        // Not playing, Motor_Input uses the waveform generator
+    TRAJECTORY_PLAYING,
+    TRAJECTORY_DONE             // Final bank played, its last point is held
+} Trajectory_State_t;
+
+/* Playback statistics */
+typedef struct {
+    uint32_t state;         // Trajectory_State_t
+    uint32_t played;        // Points applied since playback started
+    uint32_t underruns;     // Samples that held a point because the next bank was late
+    uint32_t banks_free;    // Banks the host may fill, 0 to 2
+} Trajectory_Stats_t;
+
+/* Public Function Declarations */
+
+/**
+ * @brief Stop playback and free both banks
+ */
+void Trajectory_Reset(void);
+
+/**
+ * @brief Write points into the bank being filled
+ * @param offset First point in the bank
+ * @param values rpm values as floats, any alignment
+ * @param count Number of points
+ * @return HAL_BUSY if no bank is free, HAL_ERROR if the points do not fit the bank
+ */
+HAL_StatusTypeDef Trajectory_Write(uint16_t offset, const void* values, uint32_t count);
+
+/**
+ * @brief Queue the bank being filled for playback and start filling the other one
+ * @param last 1 if the trajectory ends with this bank
+ * @return HAL_ERROR if the bank holds no points or no bank is free
+ * @note The bank length is the highest point written since the last commit
+ */
+HAL_StatusTypeDef Trajectory_Commit(uint8_t last);
+
+/**
+ * @brief Start playback on the next set_rpm sample
+ * @return HAL_ERROR if the first bank is not committed
+ */
+HAL_StatusTypeDef Trajectory_Start(void);
+
+/**
+ * @brief Check whether the trajectory provides the setpoint
+ * @return 1 while playing or holding the final point
+ */
+uint8_t Trajectory_IsActive(void);
+
+/**
+ * @brief Take the next point
+ * @return rpm
+ * @note Call from the TIM3 tick, once per set_rpm sample
+ */
+float Trajectory_Next(void);
+
+/**
+ * @brief Copy the playback statistics
+ * @param stats Destination
+ */
+void Trajectory_GetStats(Trajectory_Stats_t* stats);
+
+#endif /* TRAJECTORY_H */
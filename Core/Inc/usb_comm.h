@@ -1,8 +1,170 @@
+/**
+ * @file usb_comm.h
+ * @brief USB CDC streaming of acquired samples to the host
+ *
+ * Samples are sent in frames. Each frame is one CDC transfer holding a
+ * UsbFrameHeader_t followed by payload_size bytes, all little-endian. A gap
+ * in the frame sequence means a lost frame and a gap in the sample counters
+ * means samples dropped on the device.
+ *
+ * A data frame carries count samples in the encoding selected with 'E'.
+ * USB_FRAME_TYPE_DATA packs each one as
+ *   uint32 counter | uint32 time_us | uint32 mask | uint32 value per set mask bit
+ * with values in increasing channel order. USB_FRAME_TYPE_DATA_COMPACT uses
+ * the variable length encoding of sample_codec.h, about half the size, and
+ * is the default. USB_FRAME_TYPE_DATA_PACKED holds one column-wise block of
+ * sample_pack.h, as many records as fit the frame, with the delta order of
+ * each channel set by 'P'; it pays off on slowly varying channels.
+ *
+ * A descriptor frame is sent on start and after every rate change. It holds
+ * the uint32 base rate in Hz followed by one UsbChannelDescriptor_t per
+ * channel, so channel n runs at base_rate / divider and can be labelled with
+ * its name from channel_table.h. The kind tells how to scale its values.
+ *
+ * A stats frame answers 'Q' with the UsbTxStats_t fields followed by the
+ * UsbVescStats_t, UsbControlStats_t and UsbIsrStats_t fields, all uint32
+ * values.
+ *
+ * Commands from the host are one letter followed by little-endian arguments:
+ *   'S' start, 'T' stop, 'D' resend descriptor,
+ *   'F' u32 base rate in Hz, 'R' u8 channel u16 divider,
+ *   'E' u8 encoding (USB_ENCODING_*), 'P' u8 channel u8 delta order,
+ *   'Q' send a stats frame, 'V' u16 VESC telemetry poll rate in Hz (0 stops),
+ *   'B' u32 VESC link baud rate, negotiated with the VESC by vesc_link.h,
+ *   'M' u16 motor command max rate u16 keep-alive rate in Hz (0 sends changes only),
+ *   'C' read the VESC motor configuration into the cache again,
+ *   'X' u8 field value... changes VESC motor configuration fields, field is the
+ *       index in mcconf_table.h, value its big-endian wire encoding, see vesc_config.h,
+ *   'H' u32 hall stall timeout in microseconds,
+ *   'O' u8 control mode (Controller_Mode_t), 'G' f32 Kp f32 Ki f32 Kd f32 current limit,
+ *   'W' u8 waveform (Setpoint_Waveform_t) f32 bias f32 amplitude f32 f0 f32 f1 f32 duration,
+ *   'A' u16 offset f32 values... setpoint table entries, see setpoint.h,
+ *   'J' u16 offset f32 values... trajectory points, 'K' u8 last commits the bank,
+ *   'Y' u8 1 plays the trajectory from the next set_rpm sample, 0 stops and clears it
+ *
+ * Frames are queued by usb_transmit_task() and sent back to back from the
+ * CDC transmit complete callback, so the main loop never waits on USB.
+ */
+
 #ifndef USBCOMM_H_
 #define USBCOMM_H_
 
-uint8_t transmit_usb_packet(uint32_t* data, uint16_t data_len);
-void process_and_transmit_buffer(uint8_t buffer_index, uint32_t* packet_counter);
-void usb_transmit_task();
+#include <stdint.h>
+#include "usbd_cdc_if.h"
+#include "sample_ring.h"
+#include "sample_codec.h"
+#include "sample_pack.h"
+
+/* Frame Format */
+#define USB_FRAME_MAGIC         0xddccbbaa  // Start of every frame
+#define USB_FRAME_VERSION       9
+#define USB_FRAME_TYPE_DATA         0
+#define USB_FRAME_TYPE_DESCRIPTOR   1
+#define USB_FRAME_TYPE_DATA_COMPACT 2
+#define USB_FRAME_TYPE_DATA_PACKED  3
+#define USB_FRAME_TYPE_STATS        4
+#define USB_FRAME_MAX_SIZE      APP_TX_DATA_SIZE
+#define USB_SAMPLE_MAX_SIZE     ((3 + DATAACQ_NUM_CHANNELS) * sizeof(uint32_t))
+#define USB_FRAME_MAX_SAMPLES   ((USB_FRAME_MAX_SIZE - sizeof(UsbFrameHeader_t)) / USB_SAMPLE_MAX_SIZE)
+#define USB_FRAME_MAX_SAMPLES_COMPACT ((USB_FRAME_MAX_SIZE - sizeof(UsbFrameHeader_t)) / SAMPLE_CODEC_MAX_SIZE)
+#define USB_FRAME_FLUSH_MS      10          // Longest time a partial frame is held back
+#define USB_TX_QUEUE_DEPTH      4           // Frames waiting for or in CDC transfer
+
+/* Sample Encodings */
+#define USB_ENCODING_RAW        0           // USB_FRAME_TYPE_DATA
+#define USB_ENCODING_COMPACT    1           // USB_FRAME_TYPE_DATA_COMPACT
+#define USB_ENCODING_PACKED     2           // USB_FRAME_TYPE_DATA_PACKED
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;         // USB_FRAME_MAGIC
+    uint32_t sequence;      // Frame counter, reset on start
+    uint8_t type;           // USB_FRAME_TYPE_*
+    uint8_t version;        // USB_FRAME_VERSION
+    uint16_t count;         // Samples in a data frame, channels in a descriptor
+    uint16_t payload_size;  // Bytes that follow the header
+    uint16_t reserved;
+} UsbFrameHeader_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t id;             // DataAcq_Channel_t
+    uint8_t kind;           // DataAcq_Kind_t
+    uint16_t divider;       // Base ticks per sample
+    char name[DATAACQ_CHANNEL_NAME_LEN];  // From channel_table.h, NUL padded
+} UsbChannelDescriptor_t;
+
+/* Transmit Statistics */
+typedef struct {
+    uint32_t queue_depth;       // Frames queued or in flight right now
+    uint32_t max_queue_depth;   // Highest queue depth seen
+    uint32_t stall_count;       // Times the queue was full with samples waiting
+    uint32_t busy_count;        // Times CDC refused a transfer
+    uint32_t frames_queued;     // Frames built
+    uint32_t frames_sent;       // Frames completed by CDC
+    uint32_t bytes_sent;        // Bytes completed by CDC
+    uint32_t bytes_per_sec;     // Throughput over the last second
+    uint32_t encode_cycles;     // Core cycles spent building data frames
+    uint32_t encoded_samples;   // Samples put into data frames
+    uint32_t encoded_bytes;     // Data frame payload bytes
+    uint32_t raw_bytes;         // Payload the same samples take as USB_FRAME_TYPE_DATA
+} UsbTxStats_t;
+
+/* VESC Link Statistics */
+typedef struct {
+    uint32_t link_state;            // VescLink_State_t
+    uint32_t link_baud;             // USART2 baud rate
+    uint32_t tx_dropped;            // Frames that did not fit the USART2 queue
+    uint32_t telemetry_requests;    // COMM_GET_VALUES sent
+    uint32_t telemetry_replies;     // Replies decoded
+    uint32_t telemetry_timeouts;    // Requests unanswered when the next was due
+    uint32_t telemetry_max_latency_us;
+    uint32_t motor_sent;            // Motor commands sent
+    uint32_t motor_keepalives;      // Of those, repeats of an unchanged setpoint
+    uint32_t motor_coalesced;       // Setpoints folded into a later one
+    uint32_t config_valid;          // The motor configuration cache is filled
+    uint32_t config_hash;           // FNV-1a of the cached configuration
+    uint32_t config_writes;         // COMM_SET_MCCONF sent
+    uint32_t config_writes_skipped; // Writes equal to the cache
+    uint32_t config_changed_fields; // Fields that differed in the last write
+} UsbVescStats_t;
+
+/* Speed Controller Statistics */
+typedef struct {
+    uint32_t mode;              // Controller_Mode_t
+    uint32_t computes;          // PID steps since the mode was entered
+    uint32_t saturations;       // Steps at the current limit
+    uint32_t cycles_last;       // Core cycles of the last PID_Compute
+    uint32_t cycles_max;        // Worst case since the mode was entered
+    uint32_t trajectory_state;  // Trajectory_State_t
+    uint32_t trajectory_played; // Points applied
+    uint32_t trajectory_underruns;  // Samples that held a point, the next bank was late
+    uint32_t trajectory_banks_free; // Banks the host may fill
+} UsbControlStats_t;
+
+/* Interrupt Handler Timing, core cycles since the last start */
+typedef struct {
+    uint32_t tick_count;        // TIM3 sampling tick handler runs
+    uint32_t tick_cycles_last;
+    uint32_t tick_cycles_max;
+    uint32_t hall_count;        // TIM4 hall capture handler runs
+    uint32_t hall_cycles_last;
+    uint32_t hall_cycles_max;
+} UsbIsrStats_t;
+
+/**
+ * @brief Move samples from the ring into the transmit queue, call from the main loop
+ */
+void usb_transmit_task(void);
+
+/**
+ * @brief Release the finished frame and start the next one
+ * @note Called from CDC_TransmitCplt_FS in USB interrupt context
+ */
+void usb_tx_complete_callback(void);
+
+/**
+ * @brief Get a snapshot of the transmit statistics
+ * @param stats Destination for the snapshot
+ */
+void usb_get_tx_stats(UsbTxStats_t* stats);
 
-#endif /* BUFFER_H_ */
+#endif /* USBCOMM_H_ */
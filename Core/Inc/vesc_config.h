@@ -0,0 +1,97 @@
+/**
+ * @file vesc_config.h
+ * @brief Cached copy of the VESC motor configuration
+ *
+ * The cache is filled from COMM_GET_MCCONF once the link is up and then
+ * follows every acknowledged write, so reading the configuration costs no
+ * round trip. COMM_SET_MCCONF always carries the whole configuration, the
+ * VESC has no per-field write. A write whose encoding matches the cache is
+ * therefore skipped outright, otherwise the changed fields are counted and
+ * the full configuration goes out once. The cache takes it when the VESC
+ * confirms the write. A write left unconfirmed drops the cache, which is
+ * then read again. The hash is FNV-1a over the wire encoding, the host
+ * compares it between runs to see whether anything changed.
+ *
+ * The host changes fields with VescConfig_RequestFields: a list of field
+ * indexes into mcconf_table.h, each followed by its value in the wire
+ * encoding of that field. The fields are applied to the cache and written
+ * by VescConfig_Task.
+ */
+
+#ifndef VESC_CONFIG_H
+#define VESC_CONFIG_H
+
+#include "stm32f7xx_hal.h"
+#include "datatypes.h"
+#include <stdint.h>
+
+/* Configuration Constants */
+#define VESC_CONFIG_REPLY_TIMEOUT_MS    200     // COMM_GET_MCCONF is about 350 bytes each way
+#define VESC_CONFIG_WRITE_TIMEOUT_MS    500     // The VESC stores the configuration in flash before it confirms
+#define VESC_CONFIG_MAX_REQUEST         64      // Bytes of field changes held for VescConfig_Task
+
+/* Cache statistics */
+typedef struct {
+    uint32_t valid;             // 1 once the cache holds the VESC configuration
+    uint32_t hash;              // FNV-1a of the cached wire encoding, 0 until valid
+    uint32_t reads;             // COMM_GET_MCCONF requests sent
+    uint32_t writes;            // COMM_SET_MCCONF sent
+    uint32_t writes_skipped;    // Writes equal to the cache, nothing sent
+    uint32_t writes_acked;      // COMM_SET_MCCONF confirmations
+    uint32_t write_timeouts;    // Writes left unconfirmed, the cache was read again
+    uint32_t requests_rejected; // Field changes with an unknown field or a short value
+    uint32_t changed_fields;    // Fields that differed in the last write
+} VescConfig_Stats_t;
+
+/* Public Function Declarations */
+
+/**
+ * @brief Register the configuration callbacks with bldc_interface, the cache fills on the first VescConfig_Task
+ */
+void VescConfig_Init(void);
+
+/**
+ * @brief Drop the cache and read the configuration again
+ * @note Safe from interrupts, the read is sent by VescConfig_Task
+ */
+void VescConfig_Refresh(void);
+
+/**
+ * @brief Request the configuration while the cache is empty
+ * @note Call from the main loop once the link is ready
+ */
+void VescConfig_Task(void);
+
+/**
+ * @brief Copy the cached configuration
+ * @param conf Destination
+ * @return HAL_ERROR while the cache is empty
+ */
+HAL_StatusTypeDef VescConfig_Get(mc_configuration* conf);
+
+/**
+ * @brief Write a configuration unless the VESC already holds it
+ * @param conf New configuration
+ * @return HAL_ERROR while the cache is empty, the VESC state is unknown then,
+ *         HAL_BUSY while an earlier write is unconfirmed
+ * @note Call from the main loop
+ */
+HAL_StatusTypeDef VescConfig_Write(const mc_configuration* conf);
+
+/**
+ * @brief Queue field changes for VescConfig_Task to write
+ * @param fields u8 field index then the value, repeated
+ * @param length Bytes of fields
+ * @return HAL_BUSY while an earlier request is queued, HAL_ERROR if it is
+ *         empty or longer than VESC_CONFIG_MAX_REQUEST
+ * @note Safe from interrupts, the fields are checked when applied
+ */
+HAL_StatusTypeDef VescConfig_RequestFields(const uint8_t* fields, uint32_t length);
+
+/**
+ * @brief Copy the cache statistics
+ * @param stats Destination
+ */
+void VescConfig_GetStats(VescConfig_Stats_t* stats);
+
+#endif /* VESC_CONFIG_H */
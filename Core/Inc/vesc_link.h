@@ -0,0 +1,80 @@
+/**
+ * @file vesc_link.h
+ * @brief USART2 baud rate negotiation with the VESC
+ *
+ * The VESC keeps its UART baud rate in the app configuration, which it
+ * stores in flash, so after a reset of this board it may run at the boot
+ * rate or at the rate set before. The link first finds the VESC by asking
+ * for its firmware version at the target rate and then at the boot rate.
+ * Found at the boot rate, it reads the app configuration, writes it back
+ * with the target rate, switches USART2 and checks the reply at the new
+ * rate. Everything runs from VescLink_Task in the main loop.
+ *
+ * The configuration is only written back to firmware whose app
+ * configuration layout bldc_interface decodes, 3.39 and 3.40. Any other
+ * firmware is used at the boot rate and its configuration is left alone.
+ */
+
+#ifndef VESC_LINK_H
+#define VESC_LINK_H
+
+#include "stm32f7xx_hal.h"
+#include <stdint.h>
+
+/* Configuration Constants */
+#define VESC_LINK_BOOT_BAUD         115200  // VESC default, MX_USART2_UART_Init starts here
+#define VESC_LINK_DEFAULT_BAUD      921600  // A GET_VALUES round trip takes about 1 ms
+#define VESC_LINK_MIN_BAUD          9600
+#define VESC_LINK_MAX_BAUD          3000000 // 54 MHz PCLK1 with 16x oversampling gives 3.375 Mbaud
+#define VESC_LINK_REPLY_TIMEOUT_MS  50      // Wait for a firmware version or configuration reply
+#define VESC_LINK_SETTLE_MS         100     // VESC writes its configuration to flash and restarts its UART
+#define VESC_LINK_MAX_ATTEMPTS      6       // Probes before giving up, 'B' starts over
+#define VESC_LINK_CONF_FW_MAJOR     3       // Firmware the app configuration layout matches
+#define VESC_LINK_CONF_FW_MINOR_MIN 39
+#define VESC_LINK_CONF_FW_MINOR_MAX 40
+
+typedef enum {
+    VESC_LINK_PROBE = 0,    // Looking for the VESC at the target or boot rate
+    VESC_LINK_GET_CONF,     // Reading the app configuration
+    VESC_LINK_SWITCH,       // New rate sent, waiting for the VESC to apply it
+    VESC_LINK_VERIFY,       // Checking the reply at the new rate
+    VESC_LINK_READY,        // Running at the target rate, or at the boot rate for other firmware
+    VESC_LINK_FAILED        // No reply, left at the boot rate
+} VescLink_State_t;
+
+/* Public Function Declarations */
+
+/**
+ * @brief Register the reply callbacks with bldc_interface and start the negotiation
+ * @param baud Target baud rate
+ * @return HAL_ERROR if the rate is out of range
+ */
+HAL_StatusTypeDef VescLink_Init(uint32_t baud);
+
+/**
+ * @brief Request a new target baud rate, the negotiation starts over
+ * @param baud Target baud rate
+ * @return HAL_ERROR if the rate is out of range
+ * @note Safe from interrupts, the work is done by VescLink_Task
+ */
+HAL_StatusTypeDef VescLink_SetBaud(uint32_t baud);
+
+/**
+ * @brief Advance the negotiation
+ * @note Call from the main loop after bldc_interface_uart_process
+ */
+void VescLink_Task(void);
+
+/**
+ * @brief Get the negotiation state
+ * @return Current state
+ */
+VescLink_State_t VescLink_GetState(void);
+
+/**
+ * @brief Check whether requests can be sent
+ * @return 1 when the VESC answers at the current USART2 rate
+ */
+uint8_t VescLink_IsReady(void);
+
+#endif /* VESC_LINK_H */
@@ -0,0 +1,83 @@
+/**
+ * @file vesc_telemetry.h
+ * @brief Periodic polling of the VESC motor values
+ *
+ * The main loop sends COMM_GET_VALUES at a configurable rate. Replies are
+ * decoded by bldc_interface in the main loop and published into a double
+ * buffered latest-value slot. The TIM3 tick copies the slot into the
+ * telemetry channels of its record without locking: it always preempts the
+ * main loop, so the slot it reads is never written while it copies.
+ */
+
+#ifndef VESC_TELEMETRY_H
+#define VESC_TELEMETRY_H
+
+#include "stm32f7xx_hal.h"
+#include <stdint.h>
+
+/* Configuration Constants */
+#define VESC_TELEMETRY_DEFAULT_RATE_HZ  100     // Requests go out once vesc_link.h has raised the baud rate
+#define VESC_TELEMETRY_MAX_RATE_HZ      1000
+
+/* Latest decoded motor values */
+typedef struct {
+    float v_in;             // Input voltage in V
+    float current_motor;    // Motor current in A
+    float current_in;       // Battery current in A
+    float duty_now;         // Duty cycle, -1 to 1
+    float temp_mos;         // MOSFET temperature in degC
+    float temp_motor;       // Motor temperature in degC
+    uint32_t time_us;       // Timestamp_Now() when the reply arrived
+    uint32_t count;         // Replies received, 0 until the first one
+} VescTelemetry_Values_t;
+
+/* Polling statistics */
+typedef struct {
+    uint32_t requests;          // COMM_GET_VALUES sent
+    uint32_t replies;           // Replies decoded
+    uint32_t timeouts;          // Requests still unanswered when the next one was due
+    uint32_t last_latency_us;   // Request to reply time of the last reply
+    uint32_t max_latency_us;    // Longest request to reply time
+} VescTelemetry_Stats_t;
+
+/* Public Function Declarations */
+
+/**
+ * @brief Register the value callback with bldc_interface and start polling at the default rate
+ * @return HAL status
+ */
+HAL_StatusTypeDef VescTelemetry_Init(void);
+
+/**
+ * @brief Set the polling rate
+ * @param rate_hz Requests per second, 0 stops polling
+ * @return HAL_ERROR if the rate is above VESC_TELEMETRY_MAX_RATE_HZ
+ */
+HAL_StatusTypeDef VescTelemetry_SetRate(uint32_t rate_hz);
+
+/**
+ * @brief Get the polling rate
+ * @return Requests per second, 0 when stopped
+ */
+uint32_t VescTelemetry_GetRate(void);
+
+/**
+ * @brief Send the next request when it is due
+ * @note Call from the main loop
+ */
+void VescTelemetry_Task(void);
+
+/**
+ * @brief Copy the latest values
+ * @param values Destination
+ * @note Safe from interrupts and from the main loop
+ */
+void VescTelemetry_GetLatest(VescTelemetry_Values_t* values);
+
+/**
+ * @brief Copy the polling statistics
+ * @param stats Destination
+ */
+void VescTelemetry_GetStats(VescTelemetry_Stats_t* stats);
+
+#endif /* VESC_TELEMETRY_H */
@@ -26,9 +26,13 @@
 
 #include "bldc_interface.h"
 #include "buffer.h"
+#include "conf_codec.h"
 #include <string.h>
 
 
+// Settings
+#define APPCONF_PAYLOAD_LEN		162	// COMM_GET_APPCONF payload of the compatible versions
+
 // Private variables
 static unsigned char send_buffer[1024];
 
@@ -131,6 +135,10 @@ void bldc_interface_process_packet(unsigned char *data, unsigned int len) {
 			fw_major = -1;
 			fw_minor = -1;
 		}
+
+		if (rx_fw_func) {
+			rx_fw_func(fw_major, fw_minor);
+		}
 		break;
 
 	case COMM_ERASE_NEW_APP:
@@ -200,119 +208,10 @@ void bldc_interface_process_packet(unsigned char *data, unsigned int len) {
 
 	case COMM_GET_MCCONF:
 	case COMM_GET_MCCONF_DEFAULT:
-		ind = 0;
-		mcconf.pwm_mode = data[ind++];
-		mcconf.comm_mode = data[ind++];
-		mcconf.motor_type = data[ind++];
-		mcconf.sensor_mode = data[ind++];
-
-		mcconf.l_current_max = buffer_get_float32_auto(data, &ind);
-		mcconf.l_current_min = buffer_get_float32_auto(data, &ind);
-		mcconf.l_in_current_max = buffer_get_float32_auto(data, &ind);
-		mcconf.l_in_current_min = buffer_get_float32_auto(data, &ind);
-		mcconf.l_abs_current_max = buffer_get_float32_auto(data, &ind);
-		mcconf.l_min_erpm = buffer_get_float32_auto(data, &ind);
-		mcconf.l_max_erpm = buffer_get_float32_auto(data, &ind);
-		mcconf.l_erpm_start = buffer_get_float32_auto(data, &ind);
-		mcconf.l_max_erpm_fbrake = buffer_get_float32_auto(data, &ind);
-		mcconf.l_max_erpm_fbrake_cc = buffer_get_float32_auto(data, &ind);
-		mcconf.l_min_vin = buffer_get_float32_auto(data, &ind);
-		mcconf.l_max_vin = buffer_get_float32_auto(data, &ind);
-		mcconf.l_battery_cut_start = buffer_get_float32_auto(data, &ind);
-		mcconf.l_battery_cut_end = buffer_get_float32_auto(data, &ind);
-		mcconf.l_slow_abs_current = data[ind++];
-		mcconf.l_temp_fet_start = buffer_get_float32_auto(data, &ind);
-		mcconf.l_temp_fet_end = buffer_get_float32_auto(data, &ind);
-		mcconf.l_temp_motor_start = buffer_get_float32_auto(data, &ind);
-		mcconf.l_temp_motor_end = buffer_get_float32_auto(data, &ind);
-		mcconf.l_temp_accel_dec = buffer_get_float32_auto(data, &ind);
-		mcconf.l_min_duty = buffer_get_float32_auto(data, &ind);
-		mcconf.l_max_duty = buffer_get_float32_auto(data, &ind);
-		mcconf.l_watt_max = buffer_get_float32_auto(data, &ind);
-		mcconf.l_watt_min = buffer_get_float32_auto(data, &ind);
-
-		mcconf.lo_current_max = mcconf.l_current_max;
-		mcconf.lo_current_min = mcconf.l_current_min;
-		mcconf.lo_in_current_max = mcconf.l_in_current_max;
-		mcconf.lo_in_current_min = mcconf.l_in_current_min;
-		mcconf.lo_current_motor_max_now = mcconf.l_current_max;
-		mcconf.lo_current_motor_min_now = mcconf.l_current_min;
-
-		mcconf.sl_min_erpm = buffer_get_float32_auto(data, &ind);
-		mcconf.sl_min_erpm_cycle_int_limit = buffer_get_float32_auto(data, &ind);
-		mcconf.sl_max_fullbreak_current_dir_change = buffer_get_float32_auto(data, &ind);
-		mcconf.sl_cycle_int_limit = buffer_get_float32_auto(data, &ind);
-		mcconf.sl_phase_advance_at_br = buffer_get_float32_auto(data, &ind);
-		mcconf.sl_cycle_int_rpm_br = buffer_get_float32_auto(data, &ind);
-		mcconf.sl_bemf_coupling_k = buffer_get_float32_auto(data, &ind);
-
-		memcpy(mcconf.hall_table, data + ind, 8);
-		ind += 8;
-		mcconf.hall_sl_erpm = buffer_get_float32_auto(data, &ind);
-
-		mcconf.foc_current_kp = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_current_ki = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_f_sw = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_dt_us = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_encoder_inverted = data[ind++];
-		mcconf.foc_encoder_offset = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_encoder_ratio = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_sensor_mode = data[ind++];
-		mcconf.foc_pll_kp = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_pll_ki = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_motor_l = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_motor_r = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_motor_flux_linkage = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_observer_gain = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_observer_gain_slow = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_duty_dowmramp_kp = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_duty_dowmramp_ki = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_openloop_rpm = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_sl_openloop_hyst = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_sl_openloop_time = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_sl_d_current_duty = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_sl_d_current_factor = buffer_get_float32_auto(data, &ind);
-		memcpy(mcconf.foc_hall_table, data + ind, 8);
-		ind += 8;
-		mcconf.foc_sl_erpm = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_sample_v0_v7 = data[ind++];
-		mcconf.foc_sample_high_current = data[ind++];
-		mcconf.foc_sat_comp = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_temp_comp = data[ind++];
-		mcconf.foc_temp_comp_base_temp = buffer_get_float32_auto(data, &ind);
-		mcconf.foc_current_filter_const = buffer_get_float32_auto(data, &ind);
-
-		mcconf.s_pid_kp = buffer_get_float32_auto(data, &ind);
-		mcconf.s_pid_ki = buffer_get_float32_auto(data, &ind);
-		mcconf.s_pid_kd = buffer_get_float32_auto(data, &ind);
-		mcconf.s_pid_kd_filter = buffer_get_float32_auto(data, &ind);
-		mcconf.s_pid_min_erpm = buffer_get_float32_auto(data, &ind);
-		mcconf.s_pid_allow_braking = data[ind++];
-
-		mcconf.p_pid_kp = buffer_get_float32_auto(data, &ind);
-		mcconf.p_pid_ki = buffer_get_float32_auto(data, &ind);
-		mcconf.p_pid_kd = buffer_get_float32_auto(data, &ind);
-		mcconf.p_pid_kd_filter = buffer_get_float32_auto(data, &ind);
-		mcconf.p_pid_ang_div = buffer_get_float32_auto(data, &ind);
-
-		mcconf.cc_startup_boost_duty = buffer_get_float32_auto(data, &ind);
-		mcconf.cc_min_current = buffer_get_float32_auto(data, &ind);
-		mcconf.cc_gain = buffer_get_float32_auto(data, &ind);
-		mcconf.cc_ramp_step_max = buffer_get_float32_auto(data, &ind);
-
-		mcconf.m_fault_stop_time_ms = buffer_get_int32(data, &ind);
-		mcconf.m_duty_ramp_step = buffer_get_float32_auto(data, &ind);
-		mcconf.m_current_backoff_gain = buffer_get_float32_auto(data, &ind);
-		mcconf.m_encoder_counts = buffer_get_uint32(data, &ind);
-		mcconf.m_sensor_port_mode = data[ind++];
-		mcconf.m_invert_direction = data[ind++];
-		mcconf.m_drv8301_oc_mode = data[ind++];
-		mcconf.m_drv8301_oc_adj = data[ind++];
-		mcconf.m_bldc_f_sw_min = buffer_get_float32_auto(data, &ind);
-		mcconf.m_bldc_f_sw_max = buffer_get_float32_auto(data, &ind);
-		mcconf.m_dc_f_sw = buffer_get_float32_auto(data, &ind);
-		mcconf.m_ntc_motor_beta = buffer_get_float32_auto(data, &ind);
-		mcconf.m_out_aux_mode = data[ind++];
+		// Field order and encodings come from mcconf_table.h
+		if (ConfCodec_DecodeMcconf(data, len, &mcconf) < 0) {
+			break;
+		}
 
 		if (rx_mcconf_func) {
 			rx_mcconf_func(&mcconf);
@@ -321,6 +220,11 @@ void bldc_interface_process_packet(unsigned char *data, unsigned int len) {
 
 	case COMM_GET_APPCONF:
 	case COMM_GET_APPCONF_DEFAULT:
+		// Any other layout would be decoded into the wrong fields
+		if (len != APPCONF_PAYLOAD_LEN) {
+			break;
+		}
+
 		ind = 0;
 		appconf.controller_id = data[ind++];
 		appconf.timeout_msec = buffer_get_uint32(data, &ind);
@@ -626,113 +530,7 @@ void bldc_interface_set_servo_pos(float pos) {
 void bldc_interface_set_mcconf(const mc_configuration *mcconf) {
 	int32_t ind = 0;
 	send_buffer[ind++] = COMM_SET_MCCONF;
-
-	send_buffer[ind++] = mcconf->pwm_mode;
-	send_buffer[ind++] = mcconf->comm_mode;
-	send_buffer[ind++] = mcconf->motor_type;
-	send_buffer[ind++] = mcconf->sensor_mode;
-
-	buffer_append_float32_auto(send_buffer, mcconf->l_current_max, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_current_min, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_in_current_max, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_in_current_min, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_abs_current_max, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_min_erpm, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_max_erpm, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_erpm_start, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_max_erpm_fbrake, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_max_erpm_fbrake_cc, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_min_vin, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_max_vin, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_battery_cut_start, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_battery_cut_end, &ind);
-	send_buffer[ind++] = mcconf->l_slow_abs_current;
-	buffer_append_float32_auto(send_buffer, mcconf->l_temp_fet_start, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_temp_fet_end, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_temp_motor_start, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_temp_motor_end, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_temp_accel_dec, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_min_duty, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_max_duty, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_watt_max, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->l_watt_min, &ind);
-
-	buffer_append_float32_auto(send_buffer, mcconf->sl_min_erpm, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->sl_min_erpm_cycle_int_limit, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->sl_max_fullbreak_current_dir_change, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->sl_cycle_int_limit, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->sl_phase_advance_at_br, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->sl_cycle_int_rpm_br, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->sl_bemf_coupling_k, &ind);
-
-	memcpy(send_buffer + ind, mcconf->hall_table, 8);
-	ind += 8;
-	buffer_append_float32_auto(send_buffer, mcconf->hall_sl_erpm, &ind);
-
-	buffer_append_float32_auto(send_buffer, mcconf->foc_current_kp, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_current_ki, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_f_sw, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_dt_us, &ind);
-	send_buffer[ind++] = mcconf->foc_encoder_inverted;
-	buffer_append_float32_auto(send_buffer, mcconf->foc_encoder_offset, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_encoder_ratio, &ind);
-	send_buffer[ind++] = mcconf->foc_sensor_mode;
-	buffer_append_float32_auto(send_buffer, mcconf->foc_pll_kp, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_pll_ki, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_motor_l, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_motor_r, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_motor_flux_linkage, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_observer_gain, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_observer_gain_slow, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_duty_dowmramp_kp, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_duty_dowmramp_ki, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_openloop_rpm, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_sl_openloop_hyst, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_sl_openloop_time, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_sl_d_current_duty, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_sl_d_current_factor, &ind);
-	memcpy(send_buffer + ind, mcconf->foc_hall_table, 8);
-	ind += 8;
-	buffer_append_float32_auto(send_buffer, mcconf->foc_sl_erpm, &ind);
-	send_buffer[ind++] = mcconf->foc_sample_v0_v7;
-	send_buffer[ind++] = mcconf->foc_sample_high_current;
-	buffer_append_float32_auto(send_buffer, mcconf->foc_sat_comp, &ind);
-	send_buffer[ind++] = mcconf->foc_temp_comp;
-	buffer_append_float32_auto(send_buffer, mcconf->foc_temp_comp_base_temp, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->foc_current_filter_const, &ind);
-
-	buffer_append_float32_auto(send_buffer, mcconf->s_pid_kp, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->s_pid_ki, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->s_pid_kd, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->s_pid_kd_filter, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->s_pid_min_erpm, &ind);
-	send_buffer[ind++] = mcconf->s_pid_allow_braking;
-
-	buffer_append_float32_auto(send_buffer, mcconf->p_pid_kp, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->p_pid_ki, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->p_pid_kd, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->p_pid_kd_filter, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->p_pid_ang_div, &ind);
-
-	buffer_append_float32_auto(send_buffer, mcconf->cc_startup_boost_duty, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->cc_min_current, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->cc_gain, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->cc_ramp_step_max, &ind);
-
-	buffer_append_int32(send_buffer, mcconf->m_fault_stop_time_ms, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->m_duty_ramp_step, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->m_current_backoff_gain, &ind);
-	buffer_append_uint32(send_buffer, mcconf->m_encoder_counts, &ind);
-	send_buffer[ind++] = mcconf->m_sensor_port_mode;
-	send_buffer[ind++] = mcconf->m_invert_direction;
-	send_buffer[ind++] = mcconf->m_drv8301_oc_mode;
-	send_buffer[ind++] = mcconf->m_drv8301_oc_adj;
-	buffer_append_float32_auto(send_buffer, mcconf->m_bldc_f_sw_min, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->m_bldc_f_sw_max, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->m_dc_f_sw, &ind);
-	buffer_append_float32_auto(send_buffer, mcconf->m_ntc_motor_beta, &ind);
-	send_buffer[ind++] = mcconf->m_out_aux_mode;
-
+	ind += ConfCodec_EncodeMcconf(mcconf, send_buffer + ind);
 	send_packet_no_fwd(send_buffer, ind);
 }
 
@@ -26,12 +26,34 @@
 #include "bldc_interface.h"
 #include "main.h"
 #include "string.h"
+#include "memory_map.h"
 // Settings
 #define PACKET_HANDLER			0
+#define RX_RING_SIZE			512	// USART2 RX DMA ring, holds several replies between polls
+#define TX_RING_SIZE			2048	// USART2 TX frame queue, a power of two
 extern UART_HandleTypeDef huart2;
+
+// Private variables
+DMA_BUFFER static uint8_t rx_ring[RX_RING_SIZE];
+static volatile uint16_t rx_head = 0;	// DMA write position at the last RX event
+static uint16_t rx_tail = 0;			// Bytes before this have been parsed
+static volatile uint8_t rx_restart = 0;	// Set by bldc_interface_uart_rx_error
+static uint32_t rx_timer_tick = 0;
+DMA_BUFFER static uint8_t tx_ring[TX_RING_SIZE];
+static volatile uint32_t tx_head = 0;	// Free running, end of the queued frames
+static volatile uint32_t tx_tail = 0;	// Free running, first byte not yet sent
+static volatile uint32_t tx_dma_len = 0;	// Bytes in the DMA transfer, 0 when idle
+static volatile uint32_t tx_dropped = 0;	// Frames that did not fit the queue
+static volatile uint8_t tx_held = 0;		// Frames collect for one burst, see bldc_interface_uart_tx_hold
+
+_Static_assert((TX_RING_SIZE & (TX_RING_SIZE - 1)) == 0, "TX_RING_SIZE must be a power of two");
+_Static_assert(TX_RING_SIZE >= 2 * (PACKET_MAX_PL_LEN + 5), "the TX queue must hold two full frames");
+_Static_assert(RX_RING_SIZE % MEMORY_MAP_CACHE_LINE == 0, "the RX ring must span whole cache lines");
+
 // Private functions
 static void process_packet(unsigned char *data, unsigned int len);
 static void send_packet_bldc_interface(unsigned char *data, unsigned int len);
+static void tx_start(void);
 
 /**
  * Initialize the UART BLDC interface and provide a function to be used for
@@ -60,6 +82,83 @@ void bldc_interface_uart_process_byte(unsigned char b) {
 	packet_process_byte(b, PACKET_HANDLER);
 }
 
+/**
+ * Start the USART2 receiver. The DMA writes into a circular ring and an RX
+ * event is raised on idle line, half and full ring instead of every byte.
+ *
+ * @return
+ * HAL status of the DMA start
+ */
+HAL_StatusTypeDef bldc_interface_uart_start_rx(void) {
+	rx_head = 0;
+	rx_tail = 0;
+	return HAL_UARTEx_ReceiveToIdle_DMA(&huart2, rx_ring, RX_RING_SIZE);
+}
+
+/**
+ * Call from HAL_UARTEx_RxEventCallback. Only records how far the DMA has
+ * written, parsing happens in bldc_interface_uart_process.
+ *
+ * @param pos
+ * Write position in the ring, the Size argument of the callback
+ */
+void bldc_interface_uart_rx_event(uint16_t pos) {
+	rx_head = (pos >= RX_RING_SIZE) ? 0 : pos;
+}
+
+/**
+ * Call from HAL_UART_ErrorCallback. Overrun and framing errors abort the RX
+ * DMA. Only a restart is requested here, the main loop owns rx_tail and
+ * starts the receiver again in bldc_interface_uart_process.
+ */
+void bldc_interface_uart_rx_error(void) {
+	rx_restart = 1;
+}
+
+/**
+ * Call from the main loop. Hands the bytes received since the last call to
+ * the packet parser as at most two contiguous spans of the ring, restarts
+ * the receiver after an error, and runs the packet timeout and the TX
+ * restart check once per millisecond.
+ */
+void bldc_interface_uart_process(void) {
+	// The ring restarts from 0, bytes left from before the error are dropped
+	if (rx_restart) {
+		rx_restart = 0;
+		if (huart2.RxState == HAL_UART_STATE_READY) {
+			bldc_interface_uart_start_rx();
+		}
+	}
+
+	uint16_t head = rx_head;
+
+	if (head != rx_tail) {
+		if (head > rx_tail) {
+			MemoryMap_InvalidateDCache(rx_ring + rx_tail, head - rx_tail);
+			packet_process_buffer(rx_ring + rx_tail, head - rx_tail, PACKET_HANDLER);
+		} else {
+			MemoryMap_InvalidateDCache(rx_ring + rx_tail, RX_RING_SIZE - rx_tail);
+			MemoryMap_InvalidateDCache(rx_ring, head);
+			packet_process_buffer(rx_ring + rx_tail, RX_RING_SIZE - rx_tail, PACKET_HANDLER);
+			packet_process_buffer(rx_ring, head, PACKET_HANDLER);
+		}
+		rx_tail = head;
+	}
+
+	// After parsing, so bytes that waited in the ring do not time out their own packet
+	uint32_t now = HAL_GetTick();
+	if (now != rx_timer_tick) {
+		rx_timer_tick = now;
+		packet_timerfunc();
+
+		// Frames queued while HAL refused a transfer wait for a kick
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		tx_start();
+		__set_PRIMASK(primask);
+	}
+}
+
 /**
  * Call this function at around 1 khz to reset the state of the packet
  * interface after a timeout in case data is lost.
@@ -96,19 +195,155 @@ static void send_packet_bldc_interface(unsigned char *data, unsigned int len) {
 }
 
 
+/**
+ * Start a DMA transfer of the queued bytes up to the end of the ring, unless
+ * one is already running. Consecutive frames go out in one transfer. The
+ * caller must hold off the USART2 interrupts.
+ */
+static void tx_start(void) {
+	uint32_t queued = tx_head - tx_tail;
+	uint32_t offset = tx_tail & (TX_RING_SIZE - 1);
+
+	if (tx_dma_len != 0 || queued == 0 || tx_held) {
+		return;
+	}
+
+	uint32_t span = TX_RING_SIZE - offset;
+	if (span > queued) {
+		span = queued;
+	}
+
+	MemoryMap_CleanDCache(tx_ring + offset, span);
+	if (HAL_UART_Transmit_DMA(&huart2, tx_ring + offset, span) == HAL_OK) {
+		tx_dma_len = span;
+	}
+}
+
+/**
+ * Queue a frame for USART2. Safe from the main loop and from interrupts, the
+ * frame is copied so the caller may reuse its buffer at once. Frames that do
+ * not fit in the queue are dropped and counted.
+ *
+ * @param data
+ * Frame with start, length, checksum and stop bytes
+ * @param len
+ * Frame length
+ */
 void send_packet(unsigned char *data, unsigned int len)
 {
 	if (len > (PACKET_MAX_PL_LEN + 5)) {
 		return;
 	}
 
-	// Copy the data to a new buffer to ensure it's not overwritten
-	static uint8_t buffer[PACKET_MAX_PL_LEN + 5];
-	memcpy(buffer, data, len);
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if (TX_RING_SIZE - (tx_head - tx_tail) < len) {
+		tx_dropped++;
+		__set_PRIMASK(primask);
+		return;
+	}
+
+	uint32_t offset = tx_head & (TX_RING_SIZE - 1);
+	uint32_t first = TX_RING_SIZE - offset;
+	if (first > len) {
+		first = len;
+	}
+	memcpy(tx_ring + offset, data, first);
+	memcpy(tx_ring, data + first, len - first);
+	tx_head += len;
 
 	HAL_GPIO_WritePin(GPIOB, LD3_Pin,GPIO_PIN_SET);
-	// Send the data over UART
-	HAL_UART_Transmit_DMA(&huart2, buffer, len);
+	tx_start();
+	__set_PRIMASK(primask);
+}
+
+/**
+ * Call from HAL_UART_TxCpltCallback. Releases the bytes just sent and starts
+ * the next transfer.
+ */
+void bldc_interface_uart_tx_complete(void) {
+	tx_tail += tx_dma_len;
+	tx_dma_len = 0;
+	tx_start();
+}
+
+/**
+ * Call from HAL_UART_ErrorCallback. A DMA error ends the transfer without a
+ * complete callback, drop the bytes in flight so the queue keeps moving.
+ */
+void bldc_interface_uart_tx_error(void) {
+	if (tx_dma_len != 0 && huart2.gState == HAL_UART_STATE_READY) {
+		bldc_interface_uart_tx_complete();
+	}
+}
+
+/**
+ * Hold back the transmitter while several frames are queued, so they leave
+ * in one DMA transfer once released.
+ *
+ * @param hold
+ * 1 to hold, 0 to release and start sending
+ */
+void bldc_interface_uart_tx_hold(int hold) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	tx_held = (hold != 0);
+	tx_start();
+	__set_PRIMASK(primask);
+}
 
+/**
+ * @return
+ * 1 when every queued frame has been sent
+ */
+int bldc_interface_uart_tx_idle(void) {
+	return tx_head == tx_tail;
 }
 
+/**
+ * @return
+ * Frames dropped because the TX queue was full
+ */
+uint32_t bldc_interface_uart_tx_dropped(void) {
+	return tx_dropped;
+}
+
+/**
+ * Change the USART2 baud rate. Only possible with an empty TX queue, the
+ * receiver is restarted and bytes not parsed yet are discarded.
+ *
+ * @param baud
+ * New baud rate
+ *
+ * @return
+ * HAL_BUSY while frames are queued, else the HAL status of the restart
+ */
+HAL_StatusTypeDef bldc_interface_uart_set_baud(uint32_t baud) {
+	if (!bldc_interface_uart_tx_idle()) {
+		return HAL_BUSY;
+	}
+
+	HAL_UART_AbortReceive(&huart2);
+	huart2.Init.BaudRate = baud;
+	HAL_StatusTypeDef status = HAL_UART_Init(&huart2);
+	if (status == HAL_OK) {
+		status = bldc_interface_uart_start_rx();
+	}
+
+	// A frame queued from an interrupt meanwhile found the UART busy
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	tx_start();
+	__set_PRIMASK(primask);
+
+	return status;
+}
+
+/**
+ * @return
+ * Current USART2 baud rate
+ */
+uint32_t bldc_interface_uart_get_baud(void) {
+	return huart2.Init.BaudRate;
+}
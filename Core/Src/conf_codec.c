@@ -0,0 +1,247 @@
+/**
+ * @file conf_codec.c
+ * @brief Implementation of the table-driven configuration codec
+ */
+
+#include "conf_codec.h"
+#include "mcconf_table.h"
+#include "buffer.h"
+#include <stddef.h>
+#include <string.h>
+
+/* Field table generation */
+#define CONF_MEMBER_SIZE(type, field)   sizeof(((type*)0)->field)
+#define CONF_FIELD_SIZE(type, wire, field, bytes) \
+    ((CONF_WIRE_##wire == CONF_WIRE_BYTES) ? (bytes) : CONF_MEMBER_SIZE(type, field))
+
+// Scalar wire types need a member they fit in, byte fields a member that holds them
+#define CONF_FIELD_FITS(type, wire, field, bytes) \
+    ((CONF_WIRE_##wire == CONF_WIRE_BYTES) ? CONF_MEMBER_SIZE(type, field) >= (bytes) : \
+     (CONF_WIRE_##wire == CONF_WIRE_BOOL) ? CONF_MEMBER_SIZE(type, field) == sizeof(bool) : \
+     (CONF_WIRE_##wire == CONF_WIRE_U8) ? CONF_MEMBER_SIZE(type, field) <= 4 && \
+                                          CONF_MEMBER_SIZE(type, field) != 3 : \
+     CONF_MEMBER_SIZE(type, field) == 4)
+
+#define MCCONF_FIELD(wire, field, bytes) \
+    { offsetof(mc_configuration, field), CONF_FIELD_SIZE(mc_configuration, wire, field, bytes), \
+      CONF_WIRE_##wire },
+#define MCCONF_CHECK(wire, field, bytes) \
+    _Static_assert(CONF_FIELD_FITS(mc_configuration, wire, field, bytes), \
+                   "mcconf_table.h: " #field " does not match its member");
+
+static const ConfCodec_Field_t mcconf_fields[] = {
+    MCCONF_FIELDS(MCCONF_FIELD)
+};
+MCCONF_FIELDS(MCCONF_CHECK)
+
+#define MCCONF_NUM_FIELDS   (sizeof(mcconf_fields) / sizeof(mcconf_fields[0]))
+
+#define CONF_WIRE_BYTES_OF(wire, bytes) \
+    ((CONF_WIRE_##wire == CONF_WIRE_U8 || CONF_WIRE_##wire == CONF_WIRE_BOOL) ? 1 : \
+     (CONF_WIRE_##wire == CONF_WIRE_BYTES) ? (bytes) : 4)
+#define MCCONF_WIRE_SIZE(wire, field, bytes)    + CONF_WIRE_BYTES_OF(wire, bytes)
+
+_Static_assert(0 MCCONF_FIELDS(MCCONF_WIRE_SIZE) <= CONF_CODEC_MCCONF_MAX_SIZE,
+               "CONF_CODEC_MCCONF_MAX_SIZE is too small for mcconf_table.h");
+
+_Static_assert(sizeof(mc_configuration) <= UINT16_MAX, "field offsets are 16 bit");
+
+/**
+ * @brief Encode a struct
+ */
+int32_t ConfCodec_Encode(const ConfCodec_Field_t* fields, uint32_t count,
+                         const void* conf, uint8_t* buffer)
+{
+    const uint8_t* base = (const uint8_t*)conf;
+    int32_t ind = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const ConfCodec_Field_t* field = &fields[i];
+        const uint8_t* member = base + field->offset;
+        uint32_t value32;
+        float valuef;
+
+        switch (field->wire) {
+        case CONF_WIRE_U8:
+            // Only the low byte goes on the wire, whatever the member width
+            if (field->size == 1) {
+                buffer[ind++] = member[0];
+            } else if (field->size == 2) {
+                uint16_t value16;
+                memcpy(&value16, member, sizeof(value16));
+                buffer[ind++] = (uint8_t)value16;
+            } else {
+                memcpy(&value32, member, sizeof(value32));
+                buffer[ind++] = (uint8_t)value32;
+            }
+            break;
+        case CONF_WIRE_BOOL:
+            buffer[ind++] = member[0];
+            break;
+        case CONF_WIRE_I32:
+        case CONF_WIRE_U32:
+            memcpy(&value32, member, sizeof(value32));
+            buffer_append_uint32(buffer, value32, &ind);
+            break;
+        case CONF_WIRE_F32:
+            memcpy(&valuef, member, sizeof(valuef));
+            buffer_append_float32_auto(buffer, valuef, &ind);
+            break;
+        case CONF_WIRE_BYTES:
+            memcpy(buffer + ind, member, field->size);
+            ind += field->size;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return ind;
+}
+
+/**
+ * @brief Decode a struct
+ */
+int32_t ConfCodec_Decode(const ConfCodec_Field_t* fields, uint32_t count,
+                         const uint8_t* buffer, int32_t length, void* conf)
+{
+    uint8_t* base = (uint8_t*)conf;
+    int32_t ind = 0;
+
+    if (length < ConfCodec_WireSize(fields, count)) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        const ConfCodec_Field_t* field = &fields[i];
+        uint8_t* member = base + field->offset;
+        uint32_t value32;
+        float valuef;
+
+        switch (field->wire) {
+        case CONF_WIRE_U8:
+            // Widened unsigned, as assigning data[ind++] to the member did
+            if (field->size == 1) {
+                member[0] = buffer[ind++];
+            } else if (field->size == 2) {
+                uint16_t value16 = buffer[ind++];
+                memcpy(member, &value16, sizeof(value16));
+            } else {
+                value32 = buffer[ind++];
+                memcpy(member, &value32, sizeof(value32));
+            }
+            break;
+        case CONF_WIRE_BOOL:
+            member[0] = (buffer[ind++] != 0);
+            break;
+        case CONF_WIRE_I32:
+        case CONF_WIRE_U32:
+            value32 = buffer_get_uint32(buffer, &ind);
+            memcpy(member, &value32, sizeof(value32));
+            break;
+        case CONF_WIRE_F32:
+            valuef = buffer_get_float32_auto(buffer, &ind);
+            memcpy(member, &valuef, sizeof(valuef));
+            break;
+        case CONF_WIRE_BYTES:
+            memcpy(member, buffer + ind, field->size);
+            ind += field->size;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return ind;
+}
+
+/**
+ * @brief Get the encoded size of a table
+ */
+int32_t ConfCodec_WireSize(const ConfCodec_Field_t* fields, uint32_t count)
+{
+    int32_t size = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        switch (fields[i].wire) {
+        case CONF_WIRE_U8:
+        case CONF_WIRE_BOOL:
+            size += 1;
+            break;
+        case CONF_WIRE_BYTES:
+            size += fields[i].size;
+            break;
+        default:
+            size += 4;
+            break;
+        }
+    }
+
+    return size;
+}
+
+/**
+ * @brief Count the fields that differ between two structs
+ */
+uint32_t ConfCodec_Diff(const ConfCodec_Field_t* fields, uint32_t count, const void* a, const void* b)
+{
+    uint32_t changed = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (memcmp((const uint8_t*)a + fields[i].offset, (const uint8_t*)b + fields[i].offset,
+                   fields[i].size) != 0) {
+            changed++;
+        }
+    }
+
+    return changed;
+}
+
+/**
+ * @brief Encode an mc_configuration as COMM_SET_MCCONF carries it
+ */
+int32_t ConfCodec_EncodeMcconf(const mc_configuration* conf, uint8_t* buffer)
+{
+    return ConfCodec_Encode(mcconf_fields, MCCONF_NUM_FIELDS, conf, buffer);
+}
+
+/**
+ * @brief Decode a COMM_GET_MCCONF payload
+ */
+int32_t ConfCodec_DecodeMcconf(const uint8_t* buffer, int32_t length, mc_configuration* conf)
+{
+    int32_t ind = ConfCodec_Decode(mcconf_fields, MCCONF_NUM_FIELDS, buffer, length, conf);
+    if (ind < 0) {
+        return -1;
+    }
+
+    // Runtime limits start out as the configured ones, they are not on the wire
+    conf->lo_current_max = conf->l_current_max;
+    conf->lo_current_min = conf->l_current_min;
+    conf->lo_in_current_max = conf->l_in_current_max;
+    conf->lo_in_current_min = conf->l_in_current_min;
+    conf->lo_current_motor_max_now = conf->l_current_max;
+    conf->lo_current_motor_min_now = conf->l_current_min;
+
+    return ind;
+}
+
+/**
+ * @brief Decode one mc_configuration field
+ */
+int32_t ConfCodec_DecodeMcconfField(uint32_t index, const uint8_t* buffer, int32_t length,
+                                    mc_configuration* conf)
+{
+    if (index >= MCCONF_NUM_FIELDS) {
+        return -1;
+    }
+    return ConfCodec_Decode(&mcconf_fields[index], 1, buffer, length, conf);
+}
+
+/**
+ * @brief Count the mc_configuration fields that differ
+ */
+uint32_t ConfCodec_DiffMcconf(const mc_configuration* a, const mc_configuration* b)
+{
+    return ConfCodec_Diff(mcconf_fields, MCCONF_NUM_FIELDS, a, b);
+}
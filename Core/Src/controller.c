@@ -1,41 +1,59 @@
 #include "math.h"
 #include "main.h"
+#include "controller.h"
 #include "data_acquisition.h"
+#include "motor_command.h"
+#include "motor_speed.h"
+#include "setpoint.h"
+#include "trajectory.h"
+#include "timestamp.h"
+#include <string.h>
+#include "memory_map.h"
 
 
-// PID Controller Structure
-typedef struct {
-    float Kp;      // Proportional gain
-    float Ki;      // Integral gain
-    float Kd;      // Derivative gain
-    float Ts;      // Sampling time (1/1000 = 0.001 for 1kHz)
-
-    float integral; // Integral term
-    float prev_error; // Previous error
-    float prev_derivative; // Previous derivative (for derivative filter)
-    float derivative_filter_coeff; //Coefficient for derivative filter
-} PID_Controller;
+/* Private variables */
+DTCM_BSS static PID_Controller pid;            // Stepped by the TIM3 tick
+static volatile Controller_Mode_t mode = CONTROLLER_OPEN_LOOP;
+static volatile float setpoint = 0.0f;         // rpm
+static Controller_Stats_t stats;
 
 // Initialize PID controller parameters
-void PID_Init(PID_Controller *pid, float Kp, float Ki, float Kd, float Ts, float derivative_filter_cutoff_freq) {
+void PID_Init(PID_Controller *pid, float Kp, float Ki, float Kd, float Ts, float derivative_filter_cutoff_freq, float integral_limit) {
     pid->Kp = Kp;
     pid->Ki = Ki;
     pid->Kd = Kd;
     pid->Ts = Ts;
-    pid->integral = 0;
-    pid->prev_error = 0;
-    pid->prev_derivative = 0;
+    pid->integral_limit = integral_limit;
+    pid->output_limit = integral_limit;
+    pid->derivative_filter_cutoff = derivative_filter_cutoff_freq;
+    PID_Reset(pid);
+    PID_SetSampleTime(pid, Ts);
+}
+
+// Change the sampling time, the integrator and the derivative history are kept
+void PID_SetSampleTime(PID_Controller *pid, float Ts) {
+    pid->Ts = Ts;
 
     // Derivative filter coefficient calculation (Tustin/Bilinear transform)
     // A simple first-order low-pass filter for derivative action.
     // Cutoff frequency is important to avoid noise amplification.
-    float wc = 2.0f * M_PI * derivative_filter_cutoff_freq;  // Cutoff angular frequency
+    float wc = 2.0f * M_PI * pid->derivative_filter_cutoff;  // Cutoff angular frequency
     pid->derivative_filter_coeff = 1.0f / (1.0f + wc * pid->Ts);
 }
 
+// Clear the integrator and the derivative history
+void PID_Reset(PID_Controller *pid) {
+    pid->integral = 0;
+    pid->prev_error = 0;
+    pid->prev_derivative = 0;
+    pid->proportional = 0;
+    pid->derivative = 0;
+    pid->output = 0;
+}
+
 
 // PID controller calculation function
-float PID_Compute(PID_Controller *pid, float setpoint, float process_variable) {
+ITCM_CODE float PID_Compute(PID_Controller *pid, float setpoint, float process_variable) {
     float error = setpoint - process_variable;
 
     // Proportional term
@@ -44,17 +62,16 @@ float PID_Compute(PID_Controller *pid, float setpoint, float process_variable) {
     // Integral term (Tustin/Bilinear discretization)
     pid->integral += (pid->Ki * pid->Ts / 2.0f) * (error + pid->prev_error);
 
-    //Anti-windup (optional but highly recommended):
-    float integral_limit = 1000.0f; //Example limit. Tune this!
-    if (pid->integral > integral_limit) {
-        pid->integral = integral_limit;
-    } else if (pid->integral < -integral_limit) {
-        pid->integral = -integral_limit;
+    // Anti-windup
+    if (pid->integral > pid->integral_limit) {
+        pid->integral = pid->integral_limit;
+    } else if (pid->integral < -pid->integral_limit) {
+        pid->integral = -pid->integral_limit;
     }
 
 
-    // Derivative term (Tustin/Bilinear discretization with filter)
-    float derivative = (2.0f * pid->Kd / pid->Ts) * (error - pid->prev_error);
+    // Derivative term (backward difference, low-pass filtered below)
+    float derivative = pid->Kd / pid->Ts * (error - pid->prev_error);
 
     // Apply derivative filter (important for noise reduction)
     float filtered_derivative = pid->derivative_filter_coeff * derivative + (1.0f - pid->derivative_filter_coeff) * pid->prev_derivative;
@@ -63,31 +80,174 @@ float PID_Compute(PID_Controller *pid, float setpoint, float process_variable) {
 
     // PID output
     float output = proportional + pid->integral + filtered_derivative;
+    if (output > pid->output_limit) {
+        output = pid->output_limit;
+    } else if (output < -pid->output_limit) {
+        output = -pid->output_limit;
+    }
 
     pid->prev_error = error; // Store current error for next iteration
+    pid->proportional = proportional;
+    pid->derivative = filtered_derivative;
+    pid->output = output;
 
     return output;
 }
 
+/**
+ * @brief Reset the controller to open loop with the default gains
+ */
+void Controller_Init(float Ts)
+{
+    mode = CONTROLLER_OPEN_LOOP;
+    setpoint = 0.0f;
+    PID_Init(&pid, CONTROLLER_DEFAULT_KP, CONTROLLER_DEFAULT_KI, CONTROLLER_DEFAULT_KD, Ts,
+             CONTROLLER_DERIVATIVE_CUTOFF_HZ, CONTROLLER_DEFAULT_CURRENT_LIMIT);
+    memset(&stats, 0, sizeof(stats));
+}
 
+/**
+ * @brief Set the tick period the PID is discretized with
+ */
+void Controller_SetSampleTime(float Ts)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    PID_SetSampleTime(&pid, Ts);
+    __set_PRIMASK(primask);
+}
 
-float sine1 = 0;
-float sine2 = 0;
-float f_sine =0.2f;
-float sine_bias = 5000.0f;
-float sine_amplitude = 1000.0f;
-float set_rpm;
+/**
+ * @brief Switch between open and closed loop
+ */
+HAL_StatusTypeDef Controller_SetMode(Controller_Mode_t new_mode)
+{
+    if (new_mode != CONTROLLER_OPEN_LOOP && new_mode != CONTROLLER_CLOSED_LOOP) {
+        return HAL_ERROR;
+    }
 
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    PID_Reset(&pid);
+    memset(&stats, 0, sizeof(stats));
+    stats.mode = new_mode;
+    mode = new_mode;
+    if (new_mode == CONTROLLER_OPEN_LOOP) {
+        // Replace the last current command rather than wait for the next setpoint
+        MotorCommand_Set(MOTOR_COMMAND_RPM, setpoint);
+    }
+    __set_PRIMASK(primask);
 
-float Motor_Input(void)
+    return HAL_OK;
+}
+
+/**
+ * @brief Get the control mode
+ */
+Controller_Mode_t Controller_GetMode(void)
+{
+    return mode;
+}
+
+/**
+ * @brief Set the PID gains and the current limit
+ */
+HAL_StatusTypeDef Controller_SetGains(float Kp, float Ki, float Kd, float current_limit)
 {
-	/*EXAMPLE Sine Wave */
-	float time = Get_MilliSecond()/1000.0f; // Time in seconds
-	sine1 = sinf(2*M_PI*f_sine*time);
-	sine2 = sinf(2*M_PI*f_sine*time);
-	set_rpm = sine_bias+ sine_amplitude*sine1 + sine_amplitude/2*sine2;
+    // Negated comparisons also reject NaN
+    if (!(Kp >= 0.0f && Kp < INFINITY) || !(Ki >= 0.0f && Ki < INFINITY) ||
+        !(Kd >= 0.0f && Kd < INFINITY) || !(current_limit > 0.0f && current_limit < INFINITY)) {
+        return HAL_ERROR;
+    }
 
-	set_rpm = 1500.0f;
+    // The integrator is kept so a retune does not bump the output
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    pid.Kp = Kp;
+    pid.Ki = Ki;
+    pid.Kd = Kd;
+    pid.integral_limit = current_limit;
+    pid.output_limit = current_limit;
+    __set_PRIMASK(primask);
+
+    return HAL_OK;
+}
 
-	return set_rpm;
+/**
+ * @brief Take a new setpoint, sent to the VESC right away in open loop
+ */
+ITCM_CODE void Controller_SetSetpoint(float value)
+{
+    setpoint = value;
+    if (mode == CONTROLLER_OPEN_LOOP) {
+        MotorCommand_Set(MOTOR_COMMAND_RPM, value);
+    }
+}
+
+/**
+ * @brief Run one PID step in closed loop, nothing in open loop
+ */
+ITCM_CODE void Controller_Tick(void)
+{
+    if (mode != CONTROLLER_CLOSED_LOOP) {
+        return;
+    }
+
+    float rpm = MotorSpeed_GetRPM();
+    uint32_t start = Timestamp_Cycles();
+    float output = PID_Compute(&pid, setpoint, rpm);
+    uint32_t cycles = Timestamp_Cycles() - start;
+
+    stats.computes++;
+    stats.cycles_last = cycles;
+    if (cycles > stats.cycles_max) {
+        stats.cycles_max = cycles;
+    }
+    if (output >= pid.output_limit || output <= -pid.output_limit) {
+        stats.saturations++;
+    }
+    MotorCommand_Set(MOTOR_COMMAND_CURRENT, output);
+}
+
+/**
+ * @brief Get the terms of the last PID step
+ */
+ITCM_CODE void Controller_GetTerms(float* proportional, float* integral, float* derivative, float* output)
+{
+    if (proportional != NULL) {
+        *proportional = pid.proportional;
+    }
+    if (integral != NULL) {
+        *integral = pid.integral;
+    }
+    if (derivative != NULL) {
+        *derivative = pid.derivative;
+    }
+    if (output != NULL) {
+        *output = pid.output;
+    }
+}
+
+/**
+ * @brief Copy the controller statistics
+ */
+void Controller_GetStats(Controller_Stats_t* out)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *out = stats;
+    __set_PRIMASK(primask);
+}
+
+
+
+/**
+ * @brief Setpoint of the current tick, an uploaded trajectory takes precedence over the generator
+ */
+ITCM_CODE float Motor_Input(void)
+{
+    if (Trajectory_IsActive()) {
+        return Trajectory_Next();
+    }
+    return Setpoint_GetValue();
 }
@@ -1,123 +1,435 @@
 /**
  * @file data_acquisition.c
- * @brief Implementation of data acquisition and buffer management
+ * @brief Implementation of the multi-rate sampling scheduler
  */
 
 #include <data_acquisition.h>
 #include "main.h"
 #include "motor_speed.h"
-#include "bldc_interface.h"
 #include "controller.h"
+#include "setpoint.h"
+#include "sample_ring.h"
+#include "timestamp.h"
+#include "vesc_telemetry.h"
+#include "memory_map.h"
 
 
 /* Private variables */
-static volatile uint32_t usb_buffer_cnt = 0;                   // Current buffer position
-static volatile uint8_t active_buffer = 0;                     // Currently active buffer
-volatile uint8_t buffer_ready_flag = 0;               // Buffer ready for transmission
-static volatile uint32_t time_ms = 0;                         // Time counter
-extern volatile uint32_t adc_buffer[ADC_BUFFER_SIZE];
-extern volatile uint32_t usb_buffer[2][ADC_BUFFER_SIZE+2][USB_BUFFER_SIZE];
+static volatile uint32_t sample_counter = 0;                  // Sequence number of next record
+static volatile uint32_t start_us = 0;                        // Timestamp of the acquisition start
+static volatile uint32_t base_rate_hz = DATAACQ_DEFAULT_BASE_RATE_HZ;
+static volatile uint16_t channel_divider[DATAACQ_NUM_CHANNELS]; // Base ticks per channel sample
+DTCM_BSS static uint16_t channel_countdown[DATAACQ_NUM_CHANNELS]; // Ticks left until channel is due
+static float set_rpm = 0.0f;                                  // Last motor setpoint
+DMA_BUFFER static volatile uint32_t adc_dma_buffer[DATAACQ_ADC_DMA_BUFFER_SIZE]; // Two half blocks of scans
+DTCM_BSS static uint32_t adc_snapshot[2][DATAACQ_NUM_ADC_CHANNELS]; // Averaged half blocks, double buffered
+static volatile uint8_t adc_snapshot_index = 0;               // Snapshot the tick reads
+static uint32_t adc_oversample = 1;                           // Scans per half block for the current rate
+static uint32_t adc_dma_oversample = 1;                       // Scans per half block the DMA runs with
+static ADC_HandleTypeDef* adc_handle = NULL;
+extern TIM_HandleTypeDef htim2;
+extern TIM_HandleTypeDef htim3;
+
+_Static_assert(sizeof(adc_dma_buffer) % MEMORY_MAP_CACHE_LINE == 0, "the ADC DMA buffer must span whole cache lines");
+
+/* ADC scan entries in rank order */
+typedef struct {
+    uint32_t channel;
+    GPIO_TypeDef* port;
+    uint16_t pin;
+} DataAcq_AdcInput_t;
+
+#define DATAACQ_ADC_INPUT(id, name, channel, port, pin)  { channel, port, pin },
+static const DataAcq_AdcInput_t adc_inputs[DATAACQ_NUM_ADC_CHANNELS] = {
+    DATAACQ_ADC_CHANNELS(DATAACQ_ADC_INPUT)
+};
+#undef DATAACQ_ADC_INPUT
+
+#define DATAACQ_ADC_NAME(id, name, channel, port, pin)   name,
+#define DATAACQ_DERIVED_NAME(id, name, kind)             name,
+static const char* const channel_names[DATAACQ_NUM_CHANNELS] = {
+    DATAACQ_ADC_CHANNELS(DATAACQ_ADC_NAME)
+    DATAACQ_DERIVED_CHANNELS(DATAACQ_DERIVED_NAME)
+};
+#undef DATAACQ_ADC_NAME
+#undef DATAACQ_DERIVED_NAME
+
+#define DATAACQ_ADC_KIND(id, name, channel, port, pin)   DATAACQ_KIND_ADC12,
+#define DATAACQ_DERIVED_KIND(id, name, kind)             DATAACQ_KIND_##kind,
+static const uint8_t channel_kinds[DATAACQ_NUM_CHANNELS] = {
+    DATAACQ_ADC_CHANNELS(DATAACQ_ADC_KIND)
+    DATAACQ_DERIVED_CHANNELS(DATAACQ_DERIVED_KIND)
+};
+#undef DATAACQ_ADC_KIND
+#undef DATAACQ_DERIVED_KIND
+
+#define DATAACQ_FIXED_SCALE ((float)(1UL << DATAACQ_FIXED_FRAC_BITS))
+#define DATAACQ_VESC_MASK   ((1UL << DATAACQ_CH_VESC_V_IN) | (1UL << DATAACQ_CH_VESC_I_MOTOR) | \
+                             (1UL << DATAACQ_CH_VESC_DUTY) | (1UL << DATAACQ_CH_VESC_T_MOS))
+#define DATAACQ_PID_MASK    ((1UL << DATAACQ_CH_PID_P) | (1UL << DATAACQ_CH_PID_I) | \
+                             (1UL << DATAACQ_CH_PID_D) | (1UL << DATAACQ_CH_PID_OUT))
+
 /* Private function prototypes */
-static void DataAcq_SwitchBuffers(void);
-static uint32_t DataAcq_ScaleFloatValue(float value);
+static uint32_t DataAcq_ToFixed(float value, float scale);
+static uint32_t DataAcq_GetTimerClock(void);
+static HAL_StatusTypeDef DataAcq_RestartAdc(void);
 
 /**
  * @brief Initialize the data acquisition module
  */
 HAL_StatusTypeDef DataAcq_Init(void)
 {
-    // Initialize counters and flags
-    usb_buffer_cnt = 0;
-    active_buffer = 0;
-    buffer_ready_flag = 3;
-    time_ms = 0;
+    // Initialize counters and the sample ring
+    sample_counter = 0;
+    start_us = Timestamp_Now();
+    set_rpm = 0.0f;
+    SampleRing_Init();
+    Setpoint_Restart();
+
+    // Every channel starts due on the first tick
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+        if (channel_divider[ch] == 0) {
+            channel_divider[ch] = 1;
+        }
+        channel_countdown[ch] = 0;
+    }
+
+    if (DataAcq_SetBaseRate(base_rate_hz) != HAL_OK) {
+        return HAL_ERROR;
+    }
 
+    // Realign the half blocks with the start of the run
+    if (adc_handle != NULL) {
+        return DataAcq_RestartAdc();
+    }
     return HAL_OK;
 }
 
 /**
- * @brief Scale float value to uint32_t with defined scaling factor
+ * @brief Convert a float to a rounded, saturated fixed-point record value
+ * @param scale 2^DATAACQ_FIXED_FRAC_BITS or DATAACQ_MILLI_SCALE, by channel kind
+ * @return int32 value * scale, two's complement in a uint32_t
  */
-static uint32_t DataAcq_ScaleFloatValue(float value)
+ITCM_CODE static uint32_t DataAcq_ToFixed(float value, float scale)
 {
-    return (uint32_t)(value * SCALING_FACTOR);
+    float scaled = value * scale;
+
+    if (scaled >= 2147483520.0f) {
+        return (uint32_t)INT32_MAX;
+    }
+    if (scaled <= -2147483520.0f) {
+        return (uint32_t)INT32_MIN;
+    }
+    return (uint32_t)(int32_t)(scaled >= 0.0f ? scaled + 0.5f : scaled - 0.5f);
 }
 
 /**
- * @brief Switch between double buffers
+ * @brief Configure the ADC1 scan sequence and analog pins from the channel table
  */
-static void DataAcq_SwitchBuffers(void)
+HAL_StatusTypeDef DataAcq_ConfigAdcScan(ADC_HandleTypeDef* hadc)
 {
-    active_buffer = 1 - active_buffer;  // Toggle between 0 and 1
-    usb_buffer_cnt = 0;
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    ADC_ChannelConfTypeDef sConfig = {0};
+
+    // Analog mode for every input in the table
+    GPIO_InitStruct.Mode = GPIO_MODE_ANALOG;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    for (uint32_t i = 0; i < DATAACQ_NUM_ADC_CHANNELS; i++) {
+        GPIO_InitStruct.Pin = adc_inputs[i].pin;
+        HAL_GPIO_Init(adc_inputs[i].port, &GPIO_InitStruct);
+    }
+
+    // Sequence length follows the table, one scan per TIM2 trigger
+    hadc->Init.NbrOfConversion = DATAACQ_NUM_ADC_CHANNELS;
+    hadc->Init.ContinuousConvMode = DISABLE;
+    if (HAL_ADC_Init(hadc) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    sConfig.SamplingTime = ADC_SAMPLETIME_84CYCLES;
+    for (uint32_t i = 0; i < DATAACQ_NUM_ADC_CHANNELS; i++) {
+        sConfig.Channel = adc_inputs[i].channel;
+        sConfig.Rank = i + 1;
+        if (HAL_ADC_ConfigChannel(hadc, &sConfig) != HAL_OK) {
+            return HAL_ERROR;
+        }
+    }
 
-    // Update buffer ready flag
-    buffer_ready_flag = active_buffer ? BUFFER_STATE_READY_0 : BUFFER_STATE_READY_1;
+    return HAL_OK;
 }
 
 /**
- * @brief Process new data samples in timer interrupt
+ * @brief Start the circular ADC1 DMA into the half block buffer
  */
-void DataAcq_ProcessSamples(TIM_HandleTypeDef* htim)
+HAL_StatusTypeDef DataAcq_StartAdc(ADC_HandleTypeDef* hadc)
 {
-    if (htim->Instance != TIM3) {
-        return;
+    adc_handle = hadc;
+    return DataAcq_RestartAdc();
+}
+
+/**
+ * @brief (Re)start the DMA with the half block length of the current oversampling ratio
+ */
+static HAL_StatusTypeDef DataAcq_RestartAdc(void)
+{
+    HAL_ADC_Stop_DMA(adc_handle);
+
+    adc_dma_oversample = adc_oversample;
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_ADC_CHANNELS; ch++) {
+        adc_snapshot[0][ch] = 0;
+        adc_snapshot[1][ch] = 0;
     }
 
-    // Toggle LED to indicate sampling
-    //HAL_GPIO_TogglePin(GPIOB, LD1_Pin);
+    return HAL_ADC_Start_DMA(adc_handle, (uint32_t*)adc_dma_buffer,
+                             2 * adc_dma_oversample * DATAACQ_NUM_ADC_CHANNELS);
+}
 
+/**
+ * @brief Average one completed half block into the next ADC snapshot
+ */
+void DataAcq_AdcBlockCallback(uint8_t half)
+{
+    const volatile uint32_t* block = &adc_dma_buffer[half * adc_dma_oversample * DATAACQ_NUM_ADC_CHANNELS];
+    uint8_t next = adc_snapshot_index ^ 1;
 
-    // Get motor data
-    float set_rpm = Motor_Input();
-    bldc_interface_set_rpm(Motor_Input());
-    float current_speed = MotorSpeed_GetRPM();
+    MemoryMap_InvalidateDCache(block, adc_dma_oversample * DATAACQ_NUM_ADC_CHANNELS * sizeof(uint32_t));
 
-    // Scale float values to integers
-    uint32_t scaled_set_rpm = DataAcq_ScaleFloatValue(set_rpm);
-    uint32_t scaled_current_speed = DataAcq_ScaleFloatValue(current_speed);
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_ADC_CHANNELS; ch++) {
+        uint32_t sum = 0;
+        for (uint32_t scan = 0; scan < adc_dma_oversample; scan++) {
+            sum += block[scan * DATAACQ_NUM_ADC_CHANNELS + ch];
+        }
+        adc_snapshot[next][ch] = (sum + adc_dma_oversample / 2) / adc_dma_oversample;
+    }
 
-    // Update time counter
-    time_ms++;
+    // Publish the whole scan at once so a tick never mixes two blocks
+    adc_snapshot_index = next;
+}
 
-    // Store data in active buffer
-    usb_buffer[active_buffer][0][usb_buffer_cnt] = time_ms;
-    usb_buffer[active_buffer][1][usb_buffer_cnt] = adc_buffer[0];  // Panasonic
-    usb_buffer[active_buffer][2][usb_buffer_cnt] = adc_buffer[1];  // Load Cell 1
-    usb_buffer[active_buffer][3][usb_buffer_cnt] = scaled_set_rpm; // Motor setpoint
-    usb_buffer[active_buffer][4][usb_buffer_cnt] = scaled_current_speed; // Current speed
+/**
+ * @brief Get the host name of a channel
+ */
+const char* DataAcq_GetChannelName(uint8_t channel)
+{
+    if (channel >= DATAACQ_NUM_CHANNELS) {
+        return NULL;
+    }
+    return channel_names[channel];
+}
 
-    // Increment buffer counter
-    usb_buffer_cnt++;
+/**
+ * @brief Get the value kind of a channel
+ */
+DataAcq_Kind_t DataAcq_GetChannelKind(uint8_t channel)
+{
+    if (channel >= DATAACQ_NUM_CHANNELS) {
+        return DATAACQ_KIND_ADC12;
+    }
+    return (DataAcq_Kind_t)channel_kinds[channel];
+}
+
+/**
+ * @brief Get the TIM3 kernel clock, APB1 timers run at twice PCLK1 when it is divided
+ */
+static uint32_t DataAcq_GetTimerClock(void)
+{
+    uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
 
-    // Check if buffer is full
-    if (usb_buffer_cnt >= USB_BUFFER_SIZE) {
-        DataAcq_SwitchBuffers();
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_HCLK_DIV1) {
+        return pclk1 * 2;
     }
+    return pclk1;
 }
 
 /**
- * @brief Get the current buffer status
+ * @brief Set the base tick rate of TIM3 and the ADC scan rate of TIM2
  */
-uint8_t DataAcq_IsBufferReady(void)
+HAL_StatusTypeDef DataAcq_SetBaseRate(uint32_t rate_hz)
 {
-    return buffer_ready_flag;
+    if (rate_hz < DATAACQ_MIN_BASE_RATE_HZ || rate_hz > DATAACQ_MAX_BASE_RATE_HZ) {
+        return HAL_ERROR;
+    }
+
+    // Count at 1 MHz so the reload value is the tick period in microseconds
+    uint32_t timer_clock = DataAcq_GetTimerClock();
+    uint32_t prescaler = timer_clock / 1000000 - 1;
+    uint32_t period_us = 1000000 / rate_hz;
+
+    __HAL_TIM_SET_PRESCALER(&htim3, prescaler);
+    __HAL_TIM_SET_AUTORELOAD(&htim3, period_us - 1);
+    htim3.Init.Prescaler = prescaler;
+    htim3.Init.Period = period_us - 1;
+
+    // A running timer picks the new values up at its next update, a stopped one needs a reload
+    if ((htim3.Instance->CR1 & TIM_CR1_CEN) == 0) {
+        htim3.Instance->EGR = TIM_EGR_UG;
+        __HAL_TIM_CLEAR_FLAG(&htim3, TIM_FLAG_UPDATE);
+    }
+
+    base_rate_hz = 1000000 / period_us;
+    Controller_SetSampleTime(period_us * 1e-6f);
+    Setpoint_SetTickRate(base_rate_hz);
+
+    // Largest power of two scans per tick the ADC can keep up with
+    uint32_t oversample = DATAACQ_ADC_MAX_OVERSAMPLE;
+    while (oversample > 1 && base_rate_hz * oversample > DATAACQ_ADC_MAX_SCAN_RATE_HZ) {
+        oversample >>= 1;
+    }
+    adc_oversample = oversample;
+
+    // TIM2 is 32 bit and runs unprescaled, one trigger per scan, oversample scans per tick
+    uint32_t scan_period = (timer_clock / 1000000) * period_us / oversample;
+    __HAL_TIM_SET_PRESCALER(&htim2, 0);
+    __HAL_TIM_SET_AUTORELOAD(&htim2, scan_period - 1);
+    htim2.Init.Prescaler = 0;
+    htim2.Init.Period = scan_period - 1;
+    if ((htim2.Instance->CR1 & TIM_CR1_CEN) == 0) {
+        htim2.Instance->EGR = TIM_EGR_UG;
+        __HAL_TIM_CLEAR_FLAG(&htim2, TIM_FLAG_UPDATE);
+    }
+
+    // A new half block length needs the DMA restarted
+    if (adc_handle != NULL && adc_oversample != adc_dma_oversample) {
+        return DataAcq_RestartAdc();
+    }
+
+    return HAL_OK;
 }
 
-uint32_t Get_MilliSecond(void)
+/**
+ * @brief Get the number of ADC scans averaged into each sample
+ */
+uint32_t DataAcq_GetOversample(void)
 {
-    return time_ms;
+    return adc_dma_oversample;
 }
 
 /**
- * @brief Get pointer to the ready buffer for transmission
+ * @brief Get the effective base tick rate
  */
-uint32_t* DataAcq_GetReadyBuffer(uint32_t* buffer_size)
+uint32_t DataAcq_GetBaseRate(void)
 {
-    if (!buffer_ready_flag) {
-        return NULL;
+    return base_rate_hz;
+}
+
+/**
+ * @brief Set the decimation factor of one channel
+ */
+HAL_StatusTypeDef DataAcq_SetChannelDivider(uint8_t channel, uint16_t divider)
+{
+    if (channel >= DATAACQ_NUM_CHANNELS || divider == 0) {
+        return HAL_ERROR;
+    }
+
+    channel_divider[channel] = divider;
+    return HAL_OK;
+}
+
+/**
+ * @brief Get the decimation factor of one channel
+ */
+uint16_t DataAcq_GetChannelDivider(uint8_t channel)
+{
+    if (channel >= DATAACQ_NUM_CHANNELS) {
+        return 0;
+    }
+    return channel_divider[channel];
+}
+
+/**
+ * @brief Process new data samples in timer interrupt
+ */
+ITCM_CODE void DataAcq_ProcessSamples(TIM_HandleTypeDef* htim)
+{
+    if (htim->Instance != TIM3) {
+        return;
     }
 
-    *buffer_size = USB_BUFFER_SIZE * NUM_CHANNELS;
-    return (uint32_t*)usb_buffer[1 - active_buffer];
+    // Stamp the tick first so the time only carries the interrupt latency
+    uint32_t now_us = Timestamp_Now() - start_us;
+
+    // Toggle LED to indicate sampling
+    //HAL_GPIO_TogglePin(GPIOB, LD1_Pin);
+
+    // Work out which channels are due on this tick
+    uint32_t mask = 0;
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+        if (channel_countdown[ch] == 0) {
+            mask |= (1UL << ch);
+            channel_countdown[ch] = channel_divider[ch];
+        }
+        channel_countdown[ch]--;
+    }
+
+    if (mask & (1UL << DATAACQ_CH_SET_RPM)) {
+        // The setpoint is only taken at its own channel rate, the main loop sends it
+        set_rpm = Motor_Input();
+        Controller_SetSetpoint(set_rpm);
+    }
+
+    // The waveform runs on the tick, whether its channel is due or not
+    Setpoint_Tick();
+
+    // The closed loop runs every tick, whether a record is due or not
+    Controller_Tick();
+
+    if (mask == 0) {
+        return;
+    }
+
+    SampleRecord_t record;
+    record.counter = sample_counter++;
+    record.time_us = now_us;
+    record.mask = mask;
+
+    // ADC channel IDs are their scan rank index, all taken from the same averaged block
+    const uint32_t* snapshot = adc_snapshot[adc_snapshot_index];
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_ADC_CHANNELS; ch++) {
+        if (mask & (1UL << ch)) {
+            record.value[ch] = snapshot[ch];
+        }
+    }
+    if (mask & (1UL << DATAACQ_CH_SET_RPM)) {
+        record.value[DATAACQ_CH_SET_RPM] = DataAcq_ToFixed(set_rpm, DATAACQ_FIXED_SCALE);
+    }
+    if (mask & (1UL << DATAACQ_CH_RPM)) {
+        record.value[DATAACQ_CH_RPM] = DataAcq_ToFixed(MotorSpeed_GetRPM(), DATAACQ_FIXED_SCALE);
+    }
+    if (mask & (1UL << DATAACQ_CH_HALL_TIME)) {
+        record.value[DATAACQ_CH_HALL_TIME] = MotorSpeed_GetLastEdgeTime() - start_us;
+    }
+    if (mask & DATAACQ_VESC_MASK) {
+        // Latest poll result, repeated until the next reply arrives
+        VescTelemetry_Values_t vesc;
+        VescTelemetry_GetLatest(&vesc);
+        record.value[DATAACQ_CH_VESC_V_IN] = DataAcq_ToFixed(vesc.v_in, DATAACQ_MILLI_SCALE);
+        record.value[DATAACQ_CH_VESC_I_MOTOR] = DataAcq_ToFixed(vesc.current_motor, DATAACQ_MILLI_SCALE);
+        record.value[DATAACQ_CH_VESC_DUTY] = DataAcq_ToFixed(vesc.duty_now, DATAACQ_MILLI_SCALE);
+        record.value[DATAACQ_CH_VESC_T_MOS] = DataAcq_ToFixed(vesc.temp_mos, DATAACQ_MILLI_SCALE);
+    }
+
+    if (mask & DATAACQ_PID_MASK) {
+        float proportional, integral, derivative, output;
+        Controller_GetTerms(&proportional, &integral, &derivative, &output);
+        record.value[DATAACQ_CH_PID_P] = DataAcq_ToFixed(proportional, DATAACQ_MILLI_SCALE);
+        record.value[DATAACQ_CH_PID_I] = DataAcq_ToFixed(integral, DATAACQ_MILLI_SCALE);
+        record.value[DATAACQ_CH_PID_D] = DataAcq_ToFixed(derivative, DATAACQ_MILLI_SCALE);
+        record.value[DATAACQ_CH_PID_OUT] = DataAcq_ToFixed(output, DATAACQ_MILLI_SCALE);
+    }
+
+    // A full ring drops the record and counts it, the counter gap shows it on the host
+    SampleRing_Push(&record);
+}
+
+/**
+ * @brief Get the number of samples dropped because the host fell behind
+ */
+uint32_t DataAcq_GetOverrunCount(void)
+{
+    return SampleRing_GetOverruns();
+}
+
+uint32_t Get_MilliSecond(void)
+{
+    return (Timestamp_Now() - start_us) / 1000;
 }
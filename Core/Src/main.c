@@ -28,6 +28,14 @@
 #include "usb_comm.h"
 #include "motor_speed.h"
 #include "data_acquisition.h"
+#include "controller.h"
+#include "setpoint.h"
+#include "timestamp.h"
+#include "vesc_telemetry.h"
+#include "vesc_link.h"
+#include "motor_command.h"
+#include "vesc_config.h"
+#include "memory_map.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -73,6 +81,7 @@ ETH_HandleTypeDef heth;
 TIM_HandleTypeDef htim2;
 TIM_HandleTypeDef htim3;
 TIM_HandleTypeDef htim4;
+TIM_HandleTypeDef htim5;
 
 UART_HandleTypeDef huart2;
 UART_HandleTypeDef huart3;
@@ -80,8 +89,7 @@ DMA_HandleTypeDef hdma_usart2_rx;
 DMA_HandleTypeDef hdma_usart2_tx;
 
 /* USER CODE BEGIN PV */
-volatile uint32_t adc_buffer[ADC_BUFFER_SIZE]; // Buffer
-extern uint32_t packet_counter; // Add packet counter
+
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -95,6 +103,7 @@ static void MX_TIM2_Init(void);
 static void MX_TIM3_Init(void);
 static void MX_TIM4_Init(void);
 static void MX_USART2_UART_Init(void);
+static void MX_TIM5_Init(void);
 /* USER CODE BEGIN PFP */
 static HAL_StatusTypeDef ApplicationInit_Sequence(void);				// main before while loop initiazlizations
 static void Application(void);												// while loop applications
@@ -113,9 +122,15 @@ int main(void)
 {
 
   /* USER CODE BEGIN 1 */
-
+  MemoryMap_ConfigureMpu();
   /* USER CODE END 1 */
 
+  /* Enable I-Cache---------------------------------------------------------*/
+  SCB_EnableICache();
+
+  /* Enable D-Cache---------------------------------------------------------*/
+  SCB_EnableDCache();
+
   /* MCU Configuration--------------------------------------------------------*/
 
   /* Reset of all peripherals, Initializes the Flash interface and the Systick. */
@@ -143,6 +158,7 @@ int main(void)
   MX_USB_DEVICE_Init();
   MX_TIM4_Init();
   MX_USART2_UART_Init();
+  MX_TIM5_Init();
 
 
   /* USER CODE BEGIN 2 */
@@ -304,7 +320,11 @@ static void MX_ADC1_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN ADC1_Init 2 */
-
+  /* Extend the scan to every channel in channel_table.h */
+  if (DataAcq_ConfigAdcScan(&hadc1) != HAL_OK)
+  {
+    Error_Handler();
+  }
   /* USER CODE END ADC1_Init 2 */
 
 }
@@ -492,7 +512,7 @@ static void MX_TIM4_Init(void)
   {
     Error_Handler();
   }
-  sConfigIC.ICPolarity = TIM_INPUTCHANNELPOLARITY_RISING;
+  sConfigIC.ICPolarity = TIM_INPUTCHANNELPOLARITY_BOTHEDGE;
   sConfigIC.ICSelection = TIM_ICSELECTION_DIRECTTI;
   sConfigIC.ICPrescaler = TIM_ICPSC_DIV1;
   sConfigIC.ICFilter = 15;
@@ -514,6 +534,51 @@ static void MX_TIM4_Init(void)
 
 }
 
+/**
+  * @brief TIM5 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM5_Init(void)
+{
+
+  /* USER CODE BEGIN TIM5_Init 0 */
+
+  /* USER CODE END TIM5_Init 0 */
+
+  TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+  TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+  /* USER CODE BEGIN TIM5_Init 1 */
+
+  /* USER CODE END TIM5_Init 1 */
+  htim5.Instance = TIM5;
+  htim5.Init.Prescaler = 107;
+  htim5.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim5.Init.Period = 4294967295;
+  htim5.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+  htim5.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  if (HAL_TIM_Base_Init(&htim5) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+  if (HAL_TIM_ConfigClockSource(&htim5, &sClockSourceConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim5, &sMasterConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* USER CODE BEGIN TIM5_Init 2 */
+
+  /* USER CODE END TIM5_Init 2 */
+
+}
+
 /**
   * @brief USART2 Initialization Function
   * @param None
@@ -667,10 +732,10 @@ static void MX_GPIO_Init(void)
 
 static HAL_StatusTypeDef ApplicationInit_Sequence(void)
 {
-    /* Start ADC with DMA */
-    if (HAL_ADC_Start_DMA(&hadc1, (uint32_t*)adc_buffer, ADC_BUFFER_SIZE) != HAL_OK) {
+    /* Start the microsecond time base before anything is stamped */
+    if (Timestamp_Init(&htim5) != HAL_OK) {
         return HAL_ERROR;
-       }
+    }
 
     /* Initialize motor speed monitoring */
     if (MotorSpeed_Init(&htim4) != HAL_OK) {
@@ -682,14 +747,44 @@ static HAL_StatusTypeDef ApplicationInit_Sequence(void)
     if (HAL_TIM_IC_Start_IT(&htim4, TIM_CHANNEL_2) != HAL_OK) return HAL_ERROR;
     if (HAL_TIM_IC_Start_IT(&htim4, TIM_CHANNEL_3) != HAL_OK) return HAL_ERROR;
 
+    /* Open loop until the host closes it, DataAcq_Init sets the tick period */
+    Controller_Init(1.0f / DATAACQ_DEFAULT_BASE_RATE_HZ);
+    Setpoint_Init(DATAACQ_DEFAULT_BASE_RATE_HZ);
+
     /* Initialize data acquisition system */
     if (DataAcq_Init() != HAL_OK) {
     	return HAL_ERROR;
     }
 
+    /* Start ADC block DMA, TIM2 triggers the scans */
+    if (DataAcq_StartAdc(&hadc1) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
     /* Initialize BLDC interface */
     bldc_interface_uart_init(send_packet);
 
+    /* Receive VESC replies through the USART2 DMA ring */
+    if (bldc_interface_uart_start_rx() != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    /* Motor setpoints from the tick are sent by the main loop */
+    MotorCommand_Init();
+
+    /* Move the VESC link from the boot rate to the fast one */
+    if (VescLink_Init(VESC_LINK_DEFAULT_BAUD) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    /* Cache the VESC motor configuration once the link is up */
+    VescConfig_Init();
+
+    /* Poll the VESC motor values for the telemetry channels */
+    if (VescTelemetry_Init() != HAL_OK) {
+        return HAL_ERROR;
+    }
+
     return HAL_OK;
 }
 
@@ -697,6 +792,17 @@ static HAL_StatusTypeDef ApplicationInit_Sequence(void)
 static void Application(void)
 {
 	usb_transmit_task();
+	bldc_interface_uart_process();
+	VescLink_Task();
+
+	// The motor command and the telemetry poll leave in one USART2 burst
+	bldc_interface_uart_tx_hold(1);
+	MotorCommand_Task();
+	if (VescLink_IsReady()) {
+		VescTelemetry_Task();
+		VescConfig_Task();
+	}
+	bldc_interface_uart_tx_hold(0);
 
 }
 
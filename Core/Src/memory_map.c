@@ -0,0 +1,84 @@
+/**
+ * @file memory_map.c
+ * @brief MPU setup for the DMA buffer region and cache maintenance
+ */
+
+#include "memory_map.h"
+
+#define MEMORY_MAP_DTCM_BASE    0x20000000UL
+#define MEMORY_MAP_DTCM_END     0x20020000UL
+#define MEMORY_MAP_SRAM2_BASE   0x2007C000UL
+#define MEMORY_MAP_SRAM2_END    0x20080000UL
+
+/* Private function prototypes */
+static uint8_t MemoryMap_IsCached(uint32_t start, uint32_t end);
+
+/**
+ * @brief Check whether a range goes through the data cache
+ */
+static uint8_t MemoryMap_IsCached(uint32_t start, uint32_t end)
+{
+    if (start >= MEMORY_MAP_DTCM_BASE && end <= MEMORY_MAP_DTCM_END) {
+        return 0;
+    }
+    if (start >= MEMORY_MAP_SRAM2_BASE && end <= MEMORY_MAP_SRAM2_END) {
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Make SRAM2 non-cacheable and enable the MPU
+ */
+void MemoryMap_ConfigureMpu(void)
+{
+    MPU_Region_InitTypeDef region = {0};
+
+    HAL_MPU_Disable();
+
+    // Normal memory, shareable, not cacheable, so DMA and the core agree
+    // without cache maintenance
+    region.Enable = MPU_REGION_ENABLE;
+    region.Number = MPU_REGION_NUMBER0;
+    region.BaseAddress = MEMORY_MAP_SRAM2_BASE;
+    region.Size = MPU_REGION_SIZE_16KB;
+    region.SubRegionDisable = 0x00;
+    region.TypeExtField = MPU_TEX_LEVEL1;
+    region.AccessPermission = MPU_REGION_FULL_ACCESS;
+    region.DisableExec = MPU_INSTRUCTION_ACCESS_DISABLE;
+    region.IsShareable = MPU_ACCESS_SHAREABLE;
+    region.IsCacheable = MPU_ACCESS_NOT_CACHEABLE;
+    region.IsBufferable = MPU_ACCESS_NOT_BUFFERABLE;
+    HAL_MPU_ConfigRegion(&region);
+
+    // The default map stays in place for everything else
+    HAL_MPU_Enable(MPU_PRIVILEGED_DEFAULT);
+}
+
+/**
+ * @brief Write cached data of a buffer back before a DMA transfer reads it
+ */
+void MemoryMap_CleanDCache(const volatile void* addr, uint32_t size)
+{
+    uint32_t start = (uint32_t)addr & ~(MEMORY_MAP_CACHE_LINE - 1);
+    uint32_t end = (uint32_t)addr + size;
+
+    if (size == 0 || !MemoryMap_IsCached(start, end)) {
+        return;
+    }
+    SCB_CleanDCache_by_Addr((uint32_t*)start, (int32_t)(end - start));
+}
+
+/**
+ * @brief Drop cached data of a buffer before the core reads what DMA wrote
+ */
+void MemoryMap_InvalidateDCache(const volatile void* addr, uint32_t size)
+{
+    uint32_t start = (uint32_t)addr & ~(MEMORY_MAP_CACHE_LINE - 1);
+    uint32_t end = (uint32_t)addr + size;
+
+    if (size == 0 || !MemoryMap_IsCached(start, end)) {
+        return;
+    }
+    SCB_InvalidateDCache_by_Addr((uint32_t*)start, (int32_t)(end - start));
+}
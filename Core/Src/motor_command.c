@@ -0,0 +1,195 @@
+/**
+ * @file motor_command.c
+ * @brief Implementation of the motor command scheduler
+ */
+
+#include "motor_command.h"
+#include "bldc_interface.h"
+#include "timestamp.h"
+#include <string.h>
+#include "memory_map.h"
+
+/* Private variables */
+static volatile MotorCommand_Mode_t pending_mode = MOTOR_COMMAND_NONE;  // Written by the tick
+static volatile float pending_value = 0.0f;
+static volatile uint32_t update_count = 0;
+static volatile uint8_t stopped = 1;           // Latched by MotorCommand_Stop, setpoints are ignored
+static MotorCommand_Mode_t sent_mode = MOTOR_COMMAND_NONE;  // Main loop only
+static int32_t sent_wire = 0;           // Last value as encoded on the wire
+static uint32_t sent_updates = 0;       // update_count at the last send
+static uint32_t last_send_us = 0;
+static uint8_t sent_once = 0;           // A command has gone out since the mode changed
+static volatile uint32_t min_period_us = 1000000 / MOTOR_COMMAND_DEFAULT_MAX_RATE_HZ;
+static volatile uint32_t keepalive_period_us = 1000000 / MOTOR_COMMAND_DEFAULT_KEEPALIVE_HZ;
+static MotorCommand_Stats_t stats;
+
+/* Private function prototypes */
+static int32_t MotorCommand_Wire(MotorCommand_Mode_t mode, float value);
+static void MotorCommand_Send(MotorCommand_Mode_t mode, float value);
+
+/**
+ * @brief Value as bldc_interface encodes it, so changes below the wire resolution are not sent
+ */
+static int32_t MotorCommand_Wire(MotorCommand_Mode_t mode, float value)
+{
+    switch (mode) {
+    case MOTOR_COMMAND_RPM:
+        return (int32_t)value;
+    case MOTOR_COMMAND_CURRENT:
+    case MOTOR_COMMAND_BRAKE:
+        return (int32_t)(value * 1000.0f);
+    case MOTOR_COMMAND_DUTY:
+        return (int32_t)(value * 100000.0f);
+    default:
+        return 0;
+    }
+}
+
+static void MotorCommand_Send(MotorCommand_Mode_t mode, float value)
+{
+    switch (mode) {
+    case MOTOR_COMMAND_RPM:
+        bldc_interface_set_rpm((int)value);
+        break;
+    case MOTOR_COMMAND_CURRENT:
+        bldc_interface_set_current(value);
+        break;
+    case MOTOR_COMMAND_BRAKE:
+        bldc_interface_set_current_brake(value);
+        break;
+    case MOTOR_COMMAND_DUTY:
+        bldc_interface_set_duty_cycle(value);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Reset the setpoint, rates and statistics
+ */
+void MotorCommand_Init(void)
+{
+    pending_mode = MOTOR_COMMAND_NONE;
+    pending_value = 0.0f;
+    update_count = 0;
+    stopped = 1;
+    sent_mode = MOTOR_COMMAND_NONE;
+    sent_updates = 0;
+    sent_once = 0;
+    MotorCommand_SetRates(MOTOR_COMMAND_DEFAULT_MAX_RATE_HZ, MOTOR_COMMAND_DEFAULT_KEEPALIVE_HZ);
+    memset(&stats, 0, sizeof(stats));
+}
+
+/**
+ * @brief Store a setpoint
+ */
+ITCM_CODE void MotorCommand_Set(MotorCommand_Mode_t mode, float value)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (!stopped) {
+        pending_mode = mode;
+        pending_value = value;
+        update_count++;
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Stop sending and ignore setpoints until MotorCommand_Release
+ */
+void MotorCommand_Stop(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    stopped = 1;
+    pending_mode = MOTOR_COMMAND_NONE;
+    pending_value = 0.0f;
+    update_count++;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Accept setpoints again
+ */
+void MotorCommand_Release(void)
+{
+    stopped = 0;
+}
+
+/**
+ * @brief Set the send rates
+ */
+HAL_StatusTypeDef MotorCommand_SetRates(uint32_t max_rate_hz, uint32_t keepalive_hz)
+{
+    if (max_rate_hz == 0 || max_rate_hz > MOTOR_COMMAND_LIMIT_RATE_HZ ||
+        keepalive_hz > max_rate_hz) {
+        return HAL_ERROR;
+    }
+
+    min_period_us = 1000000 / max_rate_hz;
+    keepalive_period_us = (keepalive_hz == 0) ? 0 : 1000000 / keepalive_hz;
+    return HAL_OK;
+}
+
+/**
+ * @brief Send the setpoint when it changed or the keep-alive is due
+ */
+void MotorCommand_Task(void)
+{
+    uint32_t now_us = Timestamp_Now();
+
+    // Mode, value and count must belong to the same update
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    MotorCommand_Mode_t mode = pending_mode;
+    float value = pending_value;
+    uint32_t updates = update_count;
+    __set_PRIMASK(primask);
+
+    if (mode == MOTOR_COMMAND_NONE) {
+        sent_mode = MOTOR_COMMAND_NONE;
+        sent_once = 0;
+        return;
+    }
+
+    int32_t wire = MotorCommand_Wire(mode, value);
+    uint8_t changed = !sent_once || mode != sent_mode || wire != sent_wire;
+    uint32_t since_us = now_us - last_send_us;
+
+    if (changed) {
+        if (sent_once && since_us < min_period_us) {
+            return;
+        }
+    } else {
+        uint32_t keepalive_us = keepalive_period_us;
+        if (keepalive_us == 0 || since_us < keepalive_us) {
+            return;
+        }
+        stats.keepalives++;
+    }
+
+    // Every update since the last send except the one going out now was folded
+    uint32_t folded = updates - sent_updates;
+    if (folded > 1) {
+        stats.coalesced += folded - 1;
+    }
+
+    MotorCommand_Send(mode, value);
+    stats.sent++;
+    sent_mode = mode;
+    sent_wire = wire;
+    sent_updates = updates;
+    last_send_us = now_us;
+    sent_once = 1;
+}
+
+/**
+ * @brief Copy the scheduler statistics
+ */
+void MotorCommand_GetStats(MotorCommand_Stats_t* out)
+{
+    *out = stats;
+    out->updates = update_count;
+}
@@ -4,15 +4,91 @@
  */
 
 #include "motor_speed.h"
+#include "timestamp.h"
+#include <string.h>
+#include "memory_map.h"
+
+/* Hall inputs, PD12-PD14 are TIM4_CH1-CH3 */
+#define MOTOR_SPEED_HALL_PORT   GPIOD
+#define MOTOR_SPEED_HALL_SHIFT  12
+#define MOTOR_SPEED_NO_SECTOR   (-1)
+
+/* Sector of each hall state in the forward sequence 1, 3, 2, 6, 4, 5 */
+static const int8_t hall_sector[8] = {
+    MOTOR_SPEED_NO_SECTOR, 0, 2, 1, 4, 5, 3, MOTOR_SPEED_NO_SECTOR
+};
 
 /* Private variables */
 static TIM_HandleTypeDef* motor_timer;        // Timer handle
-static uint32_t last_capture = 0;             // Last captured timer value
-static uint32_t pulse_period = 0;             // Period between pulses
+static int8_t last_sector = MOTOR_SPEED_NO_SECTOR;
+static uint8_t timed = 0;                      // last_edge_us belongs to a valid step
+DTCM_BSS static uint32_t sector_periods[MOTOR_SPEED_HALL_SECTORS]; // Last periods, one electrical cycle
+static uint32_t sector_sum = 0;               // Sum of sector_periods
+static uint8_t sector_index = 0;              // Next entry of sector_periods
+static uint8_t sector_run = 0;                // Consecutive steps in one direction, up to a cycle
+static volatile uint8_t hall_state = 0;
+static volatile int8_t direction = 0;
+static volatile uint32_t sector_period = 0;   // Period of the last sector
 static volatile float current_rpm = 0.0f;              // Calculated RPM value
+static volatile float cycle_rpm = 0.0f;       // RPM over the last electrical cycle
+static volatile uint32_t last_edge_us = 0;    // Time of the last hall edge on the TIM5 time base
+static volatile uint32_t stall_timeout_us = MOTOR_SPEED_DEFAULT_STALL_US;
+static MotorSpeed_Stats_t stats;
 
 /* Private function prototypes */
-static uint32_t MotorSpeed_CalculatePeriod(uint32_t current_capture);
+static uint8_t MotorSpeed_ReadHalls(void);
+static void MotorSpeed_ResetTiming(void);
+static float MotorSpeed_Decay(float rpm);
+
+/**
+ * @brief Sample the three hall inputs, H1 in bit 0
+ */
+ITCM_CODE static uint8_t MotorSpeed_ReadHalls(void)
+{
+    return (MOTOR_SPEED_HALL_PORT->IDR >> MOTOR_SPEED_HALL_SHIFT) & 0x7;
+}
+
+/**
+ * @brief Forget the sector history, the next edge only starts timing
+ */
+ITCM_CODE static void MotorSpeed_ResetTiming(void)
+{
+    timed = 0;
+    sector_sum = 0;
+    sector_index = 0;
+    sector_run = 0;
+    for (uint32_t i = 0; i < MOTOR_SPEED_HALL_SECTORS; i++) {
+        sector_periods[i] = 0;
+    }
+}
+
+/**
+ * @brief Limit a speed by the time since the last edge
+ *
+ * Without edges the last period only says the motor turned that fast, the
+ * next edge is at least as far away as the time already waited. The speed
+ * therefore falls with the wait and is 0 after the stall timeout.
+ */
+ITCM_CODE static float MotorSpeed_Decay(float rpm)
+{
+    // Edge first: a TIM4 edge between the two reads then only makes the wait look longer
+    uint32_t edge_us = last_edge_us;
+    uint32_t since_us = Timestamp_Now() - edge_us;
+
+    if (since_us >= stall_timeout_us) {
+        return 0.0f;
+    }
+    if (since_us > sector_period && since_us > 0) {
+        float limit = 60000000.0f / ((float)MOTOR_SPEED_HALL_EDGES_PER_REV * since_us);
+        if (rpm > limit) {
+            return limit;
+        }
+        if (rpm < -limit) {
+            return -limit;
+        }
+    }
+    return rpm;
+}
 
 /**
  * @brief Initialize the motor speed monitoring module
@@ -24,9 +100,15 @@ HAL_StatusTypeDef MotorSpeed_Init(TIM_HandleTypeDef* htim)
     }
 
     motor_timer = htim;
-    last_capture = 0;
-    pulse_period = 0;
+    MotorSpeed_ResetTiming();
+    hall_state = MotorSpeed_ReadHalls();
+    last_sector = hall_sector[hall_state];
+    direction = 0;
+    sector_period = 0;
     current_rpm = 0.0f;
+    cycle_rpm = 0.0f;
+    last_edge_us = Timestamp_Now();
+    memset(&stats, 0, sizeof(stats));
 
     return HAL_OK;
 }
@@ -34,34 +116,82 @@ HAL_StatusTypeDef MotorSpeed_Init(TIM_HandleTypeDef* htim)
 /**
  * @brief Get the current motor speed in RPM
  */
-float MotorSpeed_GetRPM(void)
+ITCM_CODE float MotorSpeed_GetRPM(void)
 {
-    return current_rpm;
+    return MotorSpeed_Decay(current_rpm);
 }
 
 /**
- * @brief Calculate time period between two captures, handling timer overflow
+ * @brief Get the motor speed averaged over the last electrical cycle
  */
-static uint32_t MotorSpeed_CalculatePeriod(uint32_t current_capture)
+float MotorSpeed_GetCycleRPM(void)
 {
-    if (current_capture > last_capture) {
-        return current_capture - last_capture;
-    } else {
-        // Handle timer overflow
-        return (0xFFFF - last_capture) + current_capture;
+    return MotorSpeed_Decay(cycle_rpm);
+}
+
+/**
+ * @brief Set the stall timeout
+ */
+HAL_StatusTypeDef MotorSpeed_SetStallTimeout(uint32_t timeout_us)
+{
+    if (timeout_us == 0) {
+        return HAL_ERROR;
     }
+
+    stall_timeout_us = timeout_us;
+    return HAL_OK;
+}
+
+/**
+ * @brief Get the hall state
+ */
+uint8_t MotorSpeed_GetHallState(void)
+{
+    return hall_state;
+}
+
+/**
+ * @brief Get the direction of rotation
+ */
+int8_t MotorSpeed_GetDirection(void)
+{
+    return direction;
+}
+
+/**
+ * @brief Get the period of the last sector
+ */
+uint32_t MotorSpeed_GetSectorPeriod(void)
+{
+    return sector_period;
+}
+
+/**
+ * @brief Get the time of the last hall edge
+ */
+ITCM_CODE uint32_t MotorSpeed_GetLastEdgeTime(void)
+{
+    return last_edge_us;
+}
+
+/**
+ * @brief Copy the decoder statistics
+ */
+void MotorSpeed_GetStats(MotorSpeed_Stats_t* out)
+{
+    *out = stats;
 }
 
 /**
  * @brief Timer input capture callback handler
  */
-void MotorSpeed_TimerCallback(TIM_HandleTypeDef* htim)
+ITCM_CODE void MotorSpeed_TimerCallback(TIM_HandleTypeDef* htim)
 {
     if (htim->Instance != TIM4) {
         return;
     }
 
-    uint32_t current_capture = 0;
+    uint16_t current_capture = 0;
 
     // Determine which channel triggered the interrupt
     switch (htim->Channel) {
@@ -81,15 +211,73 @@ void MotorSpeed_TimerCallback(TIM_HandleTypeDef* htim)
             return;  // Invalid channel
     }
 
-    // Calculate period between pulses
-    pulse_period = MotorSpeed_CalculatePeriod(current_capture);
-    last_capture = current_capture;
+    // The capture filter delays the edge, so the pins already show the new state
+    uint8_t state = MotorSpeed_ReadHalls();
+    int8_t sector = hall_sector[state];
 
-    // Calculate RPM
-    if (pulse_period > 0) {
-        // RPM = (60 * timer_clock) / (pulses_per_rev * pulse_period)
-    	current_rpm = 60000000.0f / (MOTOR_SPEED_HALL_PULSES_PER_REV * pulse_period);
-    } else {
-        current_rpm = 0.0f;  // Motor stopped
+    if (sector == MOTOR_SPEED_NO_SECTOR) {
+        stats.invalid++;
+        last_sector = MOTOR_SPEED_NO_SECTOR;
+        MotorSpeed_ResetTiming();
+        return;
+    }
+    if (sector == last_sector) {
+        // Bounce that came back before the ISR ran, nothing commutated
+        stats.glitches++;
+        return;
+    }
+
+    // TIM4 and TIM5 both tick at 1 MHz, so the capture age on TIM4 dates the edge on TIM5.
+    // Periods are taken on the 32-bit TIM5 base, TIM4 only has to cover the ISR latency.
+    uint16_t capture_age = (uint16_t)(__HAL_TIM_GET_COUNTER(htim) - current_capture);
+    uint32_t edge_us = Timestamp_Now() - capture_age;
+    uint32_t period = edge_us - last_edge_us;
+    last_edge_us = edge_us;
+
+    int8_t step = sector - last_sector;
+    if (step > MOTOR_SPEED_HALL_SECTORS / 2) {
+        step -= MOTOR_SPEED_HALL_SECTORS;
+    } else if (step <= -MOTOR_SPEED_HALL_SECTORS / 2) {
+        step += MOTOR_SPEED_HALL_SECTORS;
+    }
+
+    uint8_t from_valid = (last_sector != MOTOR_SPEED_NO_SECTOR);
+    hall_state = state;
+    last_sector = sector;
+
+    if (!from_valid || (step != 1 && step != -1)) {
+        // A sector was missed, the direction and the period are unknown
+        stats.skips++;
+        MotorSpeed_ResetTiming();
+        timed = 1;
+        return;
+    }
+    stats.edges++;
+
+    uint8_t was_timed = timed;
+    if (step != direction) {
+        // Reversal, the sector just ended was only partly run and the cycle mixes both directions
+        direction = step;
+        MotorSpeed_ResetTiming();
+        was_timed = 0;
+    }
+    timed = 1;
+    if (!was_timed || period == 0) {
+        return;
+    }
+
+    // Calculate RPM, one sector is 1/6 of an electrical cycle
+    float sign = (float)(direction * MOTOR_SPEED_FORWARD_SIGN);
+    sector_period = period;
+    current_rpm = sign * 60000000.0f / ((float)MOTOR_SPEED_HALL_EDGES_PER_REV * period);
+
+    sector_sum += period - sector_periods[sector_index];
+    sector_periods[sector_index] = period;
+    sector_index = (sector_index + 1) % MOTOR_SPEED_HALL_SECTORS;
+    if (sector_run < MOTOR_SPEED_HALL_SECTORS) {
+        sector_run++;
+    }
+    if (sector_run == MOTOR_SPEED_HALL_SECTORS) {
+        cycle_rpm = sign * 60000000.0f / ((float)MOTOR_SPEED_POLE_PAIRS * sector_sum);
     }
 }
@@ -41,6 +41,9 @@ typedef struct {
 
 static PACKET_STATE_t handler_states[PACKET_HANDLERS];
 
+// Private functions
+static unsigned int packet_try_frame(PACKET_STATE_t *state, const uint8_t *data, unsigned int len);
+
 void packet_init(void (*s_func)(unsigned char *data, unsigned int len),
 		void (*p_func)(unsigned char *data, unsigned int len), int handler_num) {
 	handler_states[handler_num].send_func = s_func;
@@ -54,7 +57,7 @@ void packet_send_packet(unsigned char *data, unsigned int len, int handler_num)
 
 	int b_ind = 0;
 
-	if (len <= 256) {
+	if (len <= 255) {
 		handler_states[handler_num].tx_buffer[b_ind++] = 2;
 		handler_states[handler_num].tx_buffer[b_ind++] = len;
 	} else {
@@ -90,6 +93,97 @@ void packet_timerfunc(void) {
 	}
 }
 
+/**
+ * Check a frame that starts at the beginning of a span in place, without
+ * copying it into rx_buffer.
+ *
+ * @return
+ * Bytes consumed: the leading non-start bytes, the whole frame if it is
+ * valid, or the start byte only if it is not, so a frame hidden behind a
+ * false start byte is still found. 0 if the frame does not end in this span.
+ */
+static unsigned int packet_try_frame(PACKET_STATE_t *state, const uint8_t *data, unsigned int len) {
+	if (data[0] != 2 && data[0] != 3) {
+		unsigned int skip = 1;
+		while (skip < len && data[skip] != 2 && data[skip] != 3) {
+			skip++;
+		}
+		return skip;
+	}
+
+	unsigned int header = data[0];
+	if (len < header) {
+		return 0;
+	}
+	unsigned int payload_length = (header == 2) ? data[1] :
+			((unsigned int)data[1] << 8 | data[2]);
+	if (payload_length == 0 || payload_length > PACKET_MAX_PL_LEN) {
+		return 1;
+	}
+	if (len < header + payload_length + 3) {
+		return 0;
+	}
+
+	const uint8_t *payload = data + header;
+	const uint8_t *trailer = payload + payload_length;
+	if (trailer[2] != 3 ||
+			crc16(payload, payload_length) != ((unsigned short)trailer[0] << 8 | trailer[1])) {
+		return 1;
+	}
+
+	// Packet received! The payload stays in the caller's span during the callback
+	if (state->process_func) {
+		state->process_func((unsigned char *)payload, payload_length);
+	}
+	return header + payload_length + 3;
+}
+
+/**
+ * Process a span of received bytes, e.g. a block of a DMA ring. Frames that
+ * lie completely inside the span are found and checked in place. A frame
+ * cut off by the end of the span goes through the byte state machine, its
+ * payload bytes are copied in blocks.
+ *
+ * @param data
+ * Received bytes
+ * @param len
+ * Number of bytes
+ * @param handler_num
+ * Packet handler
+ */
+void packet_process_buffer(const uint8_t *data, unsigned int len, int handler_num) {
+	PACKET_STATE_t *state = &handler_states[handler_num];
+
+	while (len > 0) {
+		if (state->rx_state == 0) {
+			unsigned int used = packet_try_frame(state, data, len);
+			if (used > 0) {
+				data += used;
+				len -= used;
+				continue;
+			}
+		}
+
+		if (state->rx_state == 3) {
+			unsigned int chunk = state->payload_length - state->rx_data_ptr;
+			if (chunk > len) {
+				chunk = len;
+			}
+			memcpy(state->rx_buffer + state->rx_data_ptr, data, chunk);
+			state->rx_data_ptr += chunk;
+			data += chunk;
+			len -= chunk;
+			if (state->rx_data_ptr == state->payload_length) {
+				state->rx_state++;
+			}
+			state->rx_timeout = PACKET_RX_TIMEOUT;
+		} else {
+			packet_process_byte(*data++, handler_num);
+			len--;
+		}
+	}
+}
+
 void packet_process_byte(uint8_t rx_data, int handler_num) {
 	switch (handler_states[handler_num].rx_state) {
 	case 0:
@@ -0,0 +1,234 @@
+/**
+ * @file sample_codec.c
+ * @brief Implementation of the compact sample encoding
+ */
+
+#include "sample_codec.h"
+
+_Static_assert(DATAACQ_NUM_CHANNELS <= 24, "the compact mask field is 24 bits");
+
+#define SAMPLE_CODEC_INT24_MAX  0x7FFFFF
+#define SAMPLE_CODEC_UINT24_MAX 0xFFFFFF
+
+/* Private function prototypes */
+static uint8_t* SampleCodec_Put16(uint8_t* out, uint32_t value);
+static uint8_t* SampleCodec_Put24(uint8_t* out, uint32_t value);
+static uint8_t* SampleCodec_Put32(uint8_t* out, uint32_t value);
+static uint32_t SampleCodec_Get16(const uint8_t* in);
+static uint32_t SampleCodec_Get24(const uint8_t* in);
+static uint32_t SampleCodec_Get32(const uint8_t* in);
+static uint32_t SampleCodec_EncodedSize(uint32_t mask, uint8_t absolute);
+
+/**
+ * @brief Start a new self-contained block
+ */
+void SampleCodec_Reset(SampleCodec_State_t* state)
+{
+    state->counter = 0;
+    state->time_us = 0;
+    state->started = 0;
+}
+
+static uint8_t* SampleCodec_Put16(uint8_t* out, uint32_t value)
+{
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    return out + 2;
+}
+
+static uint8_t* SampleCodec_Put24(uint8_t* out, uint32_t value)
+{
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    return out + 3;
+}
+
+static uint8_t* SampleCodec_Put32(uint8_t* out, uint32_t value)
+{
+    out = SampleCodec_Put16(out, value);
+    return SampleCodec_Put16(out, value >> 16);
+}
+
+static uint32_t SampleCodec_Get16(const uint8_t* in)
+{
+    return in[0] | ((uint32_t)in[1] << 8);
+}
+
+static uint32_t SampleCodec_Get24(const uint8_t* in)
+{
+    return in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16);
+}
+
+static uint32_t SampleCodec_Get32(const uint8_t* in)
+{
+    return SampleCodec_Get16(in) | (SampleCodec_Get16(in + 2) << 16);
+}
+
+/**
+ * @brief Get the encoded size of a record with the given mask
+ */
+static uint32_t SampleCodec_EncodedSize(uint32_t mask, uint8_t absolute)
+{
+    uint32_t adc_count = 0;
+    uint32_t size = (absolute ? 9 : 3) + 3;
+
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+        if (mask & (1UL << ch)) {
+            if (ch < DATAACQ_NUM_ADC_CHANNELS) {
+                adc_count++;
+            } else {
+                size += 3;
+            }
+        }
+    }
+
+    return size + (adc_count / 2) * 3 + (adc_count & 1) * 2;
+}
+
+/**
+ * @brief Encode one record
+ */
+uint32_t SampleCodec_Encode(SampleCodec_State_t* state, const SampleRecord_t* record, uint8_t* out)
+{
+    uint8_t* p = out;
+    uint32_t counter_delta = record->counter - state->counter;
+    uint32_t time_delta = record->time_us - state->time_us;
+
+    if (!state->started || counter_delta >= SAMPLE_CODEC_ESCAPE || time_delta > 0xFFFF) {
+        *p++ = SAMPLE_CODEC_ESCAPE;
+        p = SampleCodec_Put32(p, record->counter);
+        p = SampleCodec_Put32(p, record->time_us);
+    } else {
+        *p++ = (uint8_t)counter_delta;
+        p = SampleCodec_Put16(p, time_delta);
+    }
+    p = SampleCodec_Put24(p, record->mask);
+
+    // ADC channels come first, pair them up into 3 bytes
+    uint32_t held = 0;
+    uint8_t holding = 0;
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_ADC_CHANNELS; ch++) {
+        if ((record->mask & (1UL << ch)) == 0) {
+            continue;
+        }
+        uint32_t value = record->value[ch] & 0x0FFF;
+        if (!holding) {
+            held = value;
+            holding = 1;
+        } else {
+            p = SampleCodec_Put24(p, held | (value << 12));
+            holding = 0;
+        }
+    }
+    if (holding) {
+        p = SampleCodec_Put16(p, held);
+    }
+
+    for (uint32_t ch = DATAACQ_NUM_ADC_CHANNELS; ch < DATAACQ_NUM_CHANNELS; ch++) {
+        if ((record->mask & (1UL << ch)) == 0) {
+            continue;
+        }
+        if (DataAcq_GetChannelKind(ch) == DATAACQ_KIND_TIME) {
+            uint32_t age = record->time_us - record->value[ch];
+            p = SampleCodec_Put24(p, age > SAMPLE_CODEC_UINT24_MAX ? SAMPLE_CODEC_UINT24_MAX : age);
+        } else {
+            int32_t value = (int32_t)record->value[ch];
+            if (value > SAMPLE_CODEC_INT24_MAX) {
+                value = SAMPLE_CODEC_INT24_MAX;
+            } else if (value < -SAMPLE_CODEC_INT24_MAX) {
+                value = -SAMPLE_CODEC_INT24_MAX;
+            }
+            p = SampleCodec_Put24(p, (uint32_t)value);
+        }
+    }
+
+    state->counter = record->counter;
+    state->time_us = record->time_us;
+    state->started = 1;
+
+    return p - out;
+}
+
+/**
+ * @brief Decode one record
+ */
+uint32_t SampleCodec_Decode(SampleCodec_State_t* state, const uint8_t* in, uint32_t length, SampleRecord_t* record)
+{
+    const uint8_t* p = in;
+    uint8_t absolute;
+
+    if (length < 6) {
+        return 0;
+    }
+    absolute = (in[0] == SAMPLE_CODEC_ESCAPE);
+    if (absolute && length < 12) {
+        return 0;
+    }
+    uint32_t mask = SampleCodec_Get24(in + (absolute ? 9 : 3));
+    if (mask >= (1UL << DATAACQ_NUM_CHANNELS) || length < SampleCodec_EncodedSize(mask, absolute)) {
+        return 0;
+    }
+
+    if (absolute) {
+        record->counter = SampleCodec_Get32(p + 1);
+        record->time_us = SampleCodec_Get32(p + 5);
+        p += 9;
+    } else {
+        if (!state->started) {
+            return 0;
+        }
+        record->counter = state->counter + p[0];
+        record->time_us = state->time_us + SampleCodec_Get16(p + 1);
+        p += 3;
+    }
+    record->mask = mask;
+    p += 3;
+
+    uint8_t second = 0;
+    uint32_t pair = 0;
+    uint32_t adc_left = 0;
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_ADC_CHANNELS; ch++) {
+        if (mask & (1UL << ch)) {
+            adc_left++;
+        }
+    }
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_ADC_CHANNELS; ch++) {
+        if ((mask & (1UL << ch)) == 0) {
+            continue;
+        }
+        if (second) {
+            record->value[ch] = pair >> 12;
+            second = 0;
+        } else if (adc_left >= 2) {
+            pair = SampleCodec_Get24(p);
+            p += 3;
+            record->value[ch] = pair & 0x0FFF;
+            second = 1;
+        } else {
+            record->value[ch] = SampleCodec_Get16(p) & 0x0FFF;
+            p += 2;
+        }
+        adc_left--;
+    }
+
+    for (uint32_t ch = DATAACQ_NUM_ADC_CHANNELS; ch < DATAACQ_NUM_CHANNELS; ch++) {
+        if ((mask & (1UL << ch)) == 0) {
+            continue;
+        }
+        uint32_t raw = SampleCodec_Get24(p);
+        p += 3;
+        if (DataAcq_GetChannelKind(ch) == DATAACQ_KIND_TIME) {
+            record->value[ch] = record->time_us - raw;
+        } else {
+            // Sign extend the 24-bit field
+            record->value[ch] = (uint32_t)((int32_t)(raw << 8) >> 8);
+        }
+    }
+
+    state->counter = record->counter;
+    state->time_us = record->time_us;
+    state->started = 1;
+
+    return p - in;
+}
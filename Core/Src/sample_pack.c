@@ -0,0 +1,298 @@
+/**
+ * @file sample_pack.c
+ * @brief Implementation of the column-wise sample compression
+ */
+
+#include "sample_pack.h"
+#include <string.h>
+
+/* Private function prototypes */
+static uint8_t* SamplePack_PutColumn(uint8_t* out, const uint32_t* values, uint32_t count, uint8_t order);
+static const uint8_t* SamplePack_GetColumn(const uint8_t* in, const uint8_t* end, uint32_t* values, uint32_t count, uint8_t order);
+static uint32_t SamplePack_ColumnBytes(const SamplePack_ColumnSize_t* column);
+static uint32_t SamplePack_ColumnAdd(SamplePack_ColumnSize_t* column, uint32_t value, uint8_t order);
+
+/**
+ * @brief Write one column: first value, then bit-packed zigzag residuals
+ */
+static uint8_t* SamplePack_PutColumn(uint8_t* out, const uint32_t* values, uint32_t count, uint8_t order)
+{
+    uint32_t prev = values[0];
+    uint32_t prev_delta = 0;
+
+    out[0] = (uint8_t)prev;
+    out[1] = (uint8_t)(prev >> 8);
+    out[2] = (uint8_t)(prev >> 16);
+    out[3] = (uint8_t)(prev >> 24);
+    out += 4;
+
+    for (uint32_t i = 1; i < count; i += SAMPLE_PACK_BLOCK) {
+        uint32_t run = (count - i < SAMPLE_PACK_BLOCK) ? count - i : SAMPLE_PACK_BLOCK;
+        uint32_t zigzag[SAMPLE_PACK_BLOCK];
+        uint32_t any = 0;
+
+        for (uint32_t j = 0; j < run; j++) {
+            uint32_t value = values[i + j];
+            uint32_t delta = value - prev;
+            uint32_t residual = (order == 0) ? value : (order == 1) ? delta : delta - prev_delta;
+
+            zigzag[j] = (residual << 1) ^ (uint32_t)((int32_t)residual >> 31);
+            any |= zigzag[j];
+            prev_delta = delta;
+            prev = value;
+        }
+
+        uint32_t width = any ? 32 - __builtin_clz(any) : 0;
+        *out++ = (uint8_t)width;
+
+        uint64_t bits = 0;
+        uint32_t bit_count = 0;
+        for (uint32_t j = 0; j < run && width > 0; j++) {
+            bits |= (uint64_t)zigzag[j] << bit_count;
+            bit_count += width;
+            while (bit_count >= 8) {
+                *out++ = (uint8_t)bits;
+                bits >>= 8;
+                bit_count -= 8;
+            }
+        }
+        if (bit_count > 0) {
+            *out++ = (uint8_t)bits;
+        }
+    }
+
+    return out;
+}
+
+/**
+ * @brief Read one column, NULL if it runs past end or a width is invalid
+ */
+static const uint8_t* SamplePack_GetColumn(const uint8_t* in, const uint8_t* end, uint32_t* values, uint32_t count, uint8_t order)
+{
+    if (end - in < 4) {
+        return NULL;
+    }
+
+    uint32_t prev = in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+    uint32_t prev_delta = 0;
+    values[0] = prev;
+    in += 4;
+
+    for (uint32_t i = 1; i < count; i += SAMPLE_PACK_BLOCK) {
+        uint32_t run = (count - i < SAMPLE_PACK_BLOCK) ? count - i : SAMPLE_PACK_BLOCK;
+
+        if (in >= end || *in > 32) {
+            return NULL;
+        }
+        uint32_t width = *in++;
+        uint32_t mask = (width == 32) ? 0xFFFFFFFF : ((1UL << width) - 1);
+        if ((uint32_t)(end - in) < (run * width + 7) / 8) {
+            return NULL;
+        }
+
+        uint64_t bits = 0;
+        uint32_t bit_count = 0;
+        for (uint32_t j = 0; j < run; j++) {
+            while (bit_count < width) {
+                bits |= (uint64_t)(*in++) << bit_count;
+                bit_count += 8;
+            }
+            uint32_t zigzag = (uint32_t)bits & mask;
+            bits >>= width;
+            bit_count -= width;
+
+            uint32_t residual = (zigzag >> 1) ^ (0 - (zigzag & 1));
+            uint32_t value;
+            if (order == 0) {
+                value = residual;
+            } else if (order == 1) {
+                value = prev + residual;
+            } else {
+                value = prev + prev_delta + residual;
+            }
+            prev_delta = value - prev;
+            prev = value;
+            values[i + j] = value;
+        }
+    }
+
+    return in;
+}
+
+/**
+ * @brief Bytes a column takes so far, as SamplePack_PutColumn would write it
+ */
+static uint32_t SamplePack_ColumnBytes(const SamplePack_ColumnSize_t* column)
+{
+    uint32_t width = column->run_any ? 32 - __builtin_clz(column->run_any) : 0;
+    uint32_t run = column->run_count ? 1 + (column->run_count * width + 7) / 8 : 0;
+
+    return column->closed + run;
+}
+
+/**
+ * @brief Append one value to a column size
+ * @return Bytes the column grew by
+ */
+static uint32_t SamplePack_ColumnAdd(SamplePack_ColumnSize_t* column, uint32_t value, uint8_t order)
+{
+    uint32_t before = SamplePack_ColumnBytes(column);
+
+    if (column->count == 0) {
+        column->closed = 4;
+    } else {
+        uint32_t delta = value - column->prev;
+        uint32_t residual = (order == 0) ? value : (order == 1) ? delta : delta - column->prev_delta;
+
+        if (column->run_count == SAMPLE_PACK_BLOCK) {
+            column->closed = SamplePack_ColumnBytes(column);
+            column->run_count = 0;
+            column->run_any = 0;
+        }
+        column->run_any |= (residual << 1) ^ (uint32_t)((int32_t)residual >> 31);
+        column->run_count++;
+        column->prev_delta = delta;
+    }
+    column->prev = value;
+    column->count++;
+
+    return SamplePack_ColumnBytes(column) - before;
+}
+
+/**
+ * @brief Start sizing a new block
+ */
+void SamplePack_BeginBlock(SamplePack_Sizer_t* sizer, const uint8_t* orders)
+{
+    memset(sizer->column, 0, sizeof(sizer->column));
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+        // Same fallback as SamplePack_Encode
+        sizer->orders[ch] = (orders[ch] > SAMPLE_PACK_MAX_ORDER) ? 1 : orders[ch];
+    }
+    sizer->size = 0;
+}
+
+/**
+ * @brief Add the next record of the block to its size
+ */
+uint32_t SamplePack_AddRecord(SamplePack_Sizer_t* sizer, const SampleRecord_t* record)
+{
+    sizer->size += SamplePack_ColumnAdd(&sizer->column[0], record->counter, 2);
+    sizer->size += SamplePack_ColumnAdd(&sizer->column[1], record->time_us, 2);
+    sizer->size += SamplePack_ColumnAdd(&sizer->column[2], record->mask, 1);
+
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+        if (record->mask & (1UL << ch)) {
+            SamplePack_ColumnSize_t* column = &sizer->column[3 + ch];
+            // Order byte in front of the first value
+            sizer->size += (column->count == 0) + SamplePack_ColumnAdd(column, record->value[ch], sizer->orders[ch]);
+        }
+    }
+
+    return sizer->size;
+}
+
+/**
+ * @brief Compress a block of records
+ */
+uint32_t SamplePack_Encode(const SampleRecord_t* records, uint32_t count, const uint8_t* orders, uint8_t* out)
+{
+    uint32_t column[SAMPLE_PACK_MAX_RECORDS];
+    uint8_t* p = out;
+
+    if (count == 0 || count > SAMPLE_PACK_MAX_RECORDS) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        column[i] = records[i].counter;
+    }
+    p = SamplePack_PutColumn(p, column, count, 2);
+    for (uint32_t i = 0; i < count; i++) {
+        column[i] = records[i].time_us;
+    }
+    p = SamplePack_PutColumn(p, column, count, 2);
+    for (uint32_t i = 0; i < count; i++) {
+        column[i] = records[i].mask;
+    }
+    p = SamplePack_PutColumn(p, column, count, 1);
+
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            if (records[i].mask & (1UL << ch)) {
+                column[n++] = records[i].value[ch];
+            }
+        }
+        if (n > 0) {
+            uint8_t order = (orders[ch] > SAMPLE_PACK_MAX_ORDER) ? 1 : orders[ch];
+            *p++ = order;
+            p = SamplePack_PutColumn(p, column, n, order);
+        }
+    }
+
+    return p - out;
+}
+
+/**
+ * @brief Decompress a block of records
+ */
+uint32_t SamplePack_Decode(const uint8_t* in, uint32_t length, uint32_t count, SampleRecord_t* records)
+{
+    uint32_t column[SAMPLE_PACK_MAX_RECORDS];
+    const uint8_t* end = in + length;
+    const uint8_t* p = in;
+
+    if (count == 0 || count > SAMPLE_PACK_MAX_RECORDS) {
+        return 0;
+    }
+
+    if ((p = SamplePack_GetColumn(p, end, column, count, 2)) == NULL) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        records[i].counter = column[i];
+    }
+    if ((p = SamplePack_GetColumn(p, end, column, count, 2)) == NULL) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        records[i].time_us = column[i];
+    }
+    if ((p = SamplePack_GetColumn(p, end, column, count, 1)) == NULL) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (column[i] >= (1UL << DATAACQ_NUM_CHANNELS)) {
+            return 0;
+        }
+        records[i].mask = column[i];
+    }
+
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            if (records[i].mask & (1UL << ch)) {
+                n++;
+            }
+        }
+        if (n == 0) {
+            continue;
+        }
+        if (p >= end || *p > SAMPLE_PACK_MAX_ORDER) {
+            return 0;
+        }
+        uint8_t order = *p++;
+        if ((p = SamplePack_GetColumn(p, end, column, n, order)) == NULL) {
+            return 0;
+        }
+        n = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            if (records[i].mask & (1UL << ch)) {
+                records[i].value[ch] = column[n++];
+            }
+        }
+    }
+
+    return p - in;
+}
@@ -0,0 +1,121 @@
+/**
+ * @file sample_ring.c
+ * @brief Implementation of the SPSC sample ring
+ */
+
+#include "sample_ring.h"
+#include "memory_map.h"
+
+#if (SAMPLE_RING_SIZE & (SAMPLE_RING_SIZE - 1)) != 0
+#error "SAMPLE_RING_SIZE must be a power of two"
+#endif
+
+#define SAMPLE_RING_MASK (SAMPLE_RING_SIZE - 1)
+
+/* Private variables */
+DTCM_BSS static SampleRecord_t ring[SAMPLE_RING_SIZE];
+static volatile uint32_t head = 0;            // Free running, written by producer only
+static volatile uint32_t tail = 0;            // Free running, written by consumer only
+static volatile uint32_t overruns = 0;        // Records dropped on a full ring
+static volatile uint32_t high_water = 0;      // Peak fill level
+
+/**
+ * @brief Empty the ring and clear its statistics
+ */
+void SampleRing_Init(void)
+{
+    head = 0;
+    tail = 0;
+    overruns = 0;
+    high_water = 0;
+}
+
+/**
+ * @brief Append a record (producer side)
+ */
+ITCM_CODE uint8_t SampleRing_Push(const SampleRecord_t* record)
+{
+    uint32_t h = head;
+    uint32_t used = h - tail;
+
+    if (used >= SAMPLE_RING_SIZE) {
+        overruns++;
+        return 0;
+    }
+
+    ring[h & SAMPLE_RING_MASK] = *record;
+
+    // Record contents must be visible before the consumer sees the new head
+    __DMB();
+    head = h + 1;
+
+    if (used + 1 > high_water) {
+        high_water = used + 1;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Remove the oldest record (consumer side)
+ */
+uint8_t SampleRing_Pop(SampleRecord_t* record)
+{
+    uint32_t t = tail;
+
+    if (head == t) {
+        return 0;
+    }
+
+    // Do not read the slot before the head that published it
+    __DMB();
+    *record = ring[t & SAMPLE_RING_MASK];
+
+    // Slot must be fully read before the producer may reuse it
+    __DMB();
+    tail = t + 1;
+
+    return 1;
+}
+
+/**
+ * @brief Read the oldest record without removing it (consumer side)
+ */
+uint8_t SampleRing_Peek(SampleRecord_t* record)
+{
+    uint32_t t = tail;
+
+    if (head == t) {
+        return 0;
+    }
+
+    // Do not read the slot before the head that published it
+    __DMB();
+    *record = ring[t & SAMPLE_RING_MASK];
+
+    return 1;
+}
+
+/**
+ * @brief Get the number of records waiting to be consumed
+ */
+uint32_t SampleRing_Count(void)
+{
+    return head - tail;
+}
+
+/**
+ * @brief Get the number of records dropped because the ring was full
+ */
+uint32_t SampleRing_GetOverruns(void)
+{
+    return overruns;
+}
+
+/**
+ * @brief Get the highest fill level seen since the last init
+ */
+uint32_t SampleRing_GetHighWater(void)
+{
+    return high_water;
+}
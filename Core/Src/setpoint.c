@@ -0,0 +1,308 @@
+/**
+ * @file setpoint.c
+ * @brief Implementation of the setpoint waveform generator
+ */
+
+#include "setpoint.h"
+#include <math.h>
+#include <string.h>
+#include "memory_map.h"
+
+#define SETPOINT_SINE_SIZE      (1UL << SETPOINT_SINE_BITS)
+#define SETPOINT_FRAC_BITS      (32 - SETPOINT_SINE_BITS)
+#define SETPOINT_TWO_POW_32     4294967296.0
+#define SETPOINT_TWO_POW_64     18446744073709551616.0
+#define SETPOINT_LFSR_SEED      0x7FFF
+
+/* Generator state derived from the parameters and the tick rate */
+typedef struct {
+    uint32_t waveform;
+    uint32_t tones;                         // Phase accumulators in use
+    float bias;
+    float amplitude;                        // Per tone for a multisine
+    uint32_t phase[SETPOINT_MAX_TONES];
+    uint32_t start_phase[SETPOINT_MAX_TONES];
+    uint32_t increment[SETPOINT_MAX_TONES];
+    uint64_t chirp_increment;               // Increment of tone 0, 32.32 fixed point
+    uint64_t chirp_start;
+    int64_t chirp_step;                     // Added to chirp_increment every tick
+    uint32_t chirp_ticks;                   // Ticks per sweep
+    uint32_t chirp_tick;
+    uint16_t lfsr;
+} Setpoint_Generator_t;
+
+/* Private variables */
+DTCM_BSS static float sine_table[SETPOINT_SINE_SIZE + 1]; // One period, the last entry repeats the first
+DTCM_BSS static float table[SETPOINT_TABLE_SIZE];
+static volatile uint32_t table_length = 0;
+DTCM_BSS static Setpoint_Generator_t gen;           // Stepped by the TIM3 tick
+static Setpoint_Params_t params;
+static uint32_t tick_rate = 1000;
+
+/* Private function prototypes */
+static HAL_StatusTypeDef Setpoint_Build(const Setpoint_Params_t* p, uint32_t rate, Setpoint_Generator_t* g);
+static uint32_t Setpoint_Increment(float frequency, uint32_t rate);
+static float Setpoint_Sine(uint32_t phase);
+
+/**
+ * @brief Phase increment per tick of a frequency
+ */
+static uint32_t Setpoint_Increment(float frequency, uint32_t rate)
+{
+    return (uint32_t)((double)frequency / rate * SETPOINT_TWO_POW_32 + 0.5);
+}
+
+/**
+ * @brief Interpolated sine of a full-scale phase
+ */
+ITCM_CODE static float Setpoint_Sine(uint32_t phase)
+{
+    uint32_t index = phase >> SETPOINT_FRAC_BITS;
+    float frac = (float)(phase & ((1UL << SETPOINT_FRAC_BITS) - 1)) * (1.0f / (1UL << SETPOINT_FRAC_BITS));
+    float a = sine_table[index];
+
+    return a + (sine_table[index + 1] - a) * frac;
+}
+
+/**
+ * @brief Work out the generator state, checking the parameters
+ */
+static HAL_StatusTypeDef Setpoint_Build(const Setpoint_Params_t* p, uint32_t rate, Setpoint_Generator_t* g)
+{
+    float nyquist = rate / 2.0f;
+
+    if (!isfinite(p->bias) || !isfinite(p->amplitude) || p->waveform >= SETPOINT_NUM_WAVEFORMS) {
+        return HAL_ERROR;
+    }
+    if (p->waveform != SETPOINT_CONSTANT && !(p->f0 > 0.0f && p->f0 < nyquist)) {
+        // A chirp may start at 0 Hz
+        if (p->waveform != SETPOINT_CHIRP || p->f0 != 0.0f) {
+            return HAL_ERROR;
+        }
+    }
+
+    memset(g, 0, sizeof(*g));
+    g->waveform = p->waveform;
+    g->bias = p->bias;
+    g->amplitude = p->amplitude;
+    g->lfsr = SETPOINT_LFSR_SEED;
+    g->tones = (p->waveform == SETPOINT_CONSTANT) ? 0 : 1;
+    g->increment[0] = Setpoint_Increment(p->f0, rate);
+
+    switch (p->waveform) {
+    case SETPOINT_MULTISINE: {
+        if (!(p->f1 >= p->f0 && p->f1 < nyquist)) {
+            return HAL_ERROR;
+        }
+        uint32_t tones = (uint32_t)(p->f1 / p->f0 + 0.001f);
+        if (tones > SETPOINT_MAX_TONES) {
+            tones = SETPOINT_MAX_TONES;
+        }
+        // Schroeder phases -pi k (k - 1) / N keep the crest factor low
+        for (uint32_t k = 1; k <= tones; k++) {
+            double turns = -0.5 * k * (k - 1) / tones;
+            g->increment[k - 1] = Setpoint_Increment(p->f0 * k, rate);
+            g->start_phase[k - 1] = (uint32_t)(int64_t)(turns * SETPOINT_TWO_POW_32);
+        }
+        g->tones = tones;
+        g->amplitude = p->amplitude / tones;
+        break;
+    }
+    case SETPOINT_CHIRP: {
+        if (!(p->f1 >= 0.0f && p->f1 < nyquist) || !(p->duration > 0.0f) ||
+            p->duration * rate >= (float)UINT32_MAX) {
+            return HAL_ERROR;
+        }
+        uint32_t ticks = (uint32_t)(p->duration * rate + 0.5f);
+        if (ticks == 0) {
+            ticks = 1;
+        }
+        double start = (double)p->f0 / rate * SETPOINT_TWO_POW_64;
+        double end = (double)p->f1 / rate * SETPOINT_TWO_POW_64;
+        g->chirp_start = (uint64_t)start;
+        g->chirp_step = (int64_t)((end - start) / ticks);
+        g->chirp_ticks = ticks;
+        break;
+    }
+    case SETPOINT_TABLE:
+        if (table_length == 0) {
+            return HAL_ERROR;
+        }
+        break;
+    default:
+        break;
+    }
+
+    for (uint32_t k = 0; k < g->tones; k++) {
+        g->phase[k] = g->start_phase[k];
+    }
+    g->chirp_increment = g->chirp_start;
+    return HAL_OK;
+}
+
+/**
+ * @brief Fill the sine table and load the constant default
+ */
+void Setpoint_Init(uint32_t tick_rate_hz)
+{
+    for (uint32_t i = 0; i <= SETPOINT_SINE_SIZE; i++) {
+        sine_table[i] = sinf(2.0f * (float)M_PI * i / SETPOINT_SINE_SIZE);
+    }
+    sine_table[SETPOINT_SINE_SIZE] = sine_table[0];
+
+    tick_rate = tick_rate_hz;
+    memset(&params, 0, sizeof(params));
+    params.waveform = SETPOINT_CONSTANT;
+    params.bias = SETPOINT_DEFAULT_BIAS;
+    Setpoint_Build(&params, tick_rate, &gen);
+}
+
+/**
+ * @brief Load a waveform, it starts from phase 0 on the next tick
+ */
+HAL_StatusTypeDef Setpoint_Load(const Setpoint_Params_t* new_params)
+{
+    Setpoint_Generator_t next;
+
+    if (Setpoint_Build(new_params, tick_rate, &next) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    params = *new_params;
+    gen = next;
+    __set_PRIMASK(primask);
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Get the loaded waveform parameters
+ */
+void Setpoint_GetParams(Setpoint_Params_t* out)
+{
+    *out = params;
+}
+
+/**
+ * @brief Recompute the phase increments for a new tick rate
+ */
+void Setpoint_SetTickRate(uint32_t tick_rate_hz)
+{
+    Setpoint_Generator_t next;
+
+    tick_rate = tick_rate_hz;
+    if (Setpoint_Build(&params, tick_rate, &next) != HAL_OK) {
+        // Frequencies past the new Nyquist limit, hold the bias instead
+        params.waveform = SETPOINT_CONSTANT;
+        Setpoint_Build(&params, tick_rate, &next);
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    gen = next;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Restart the loaded waveform from phase 0
+ */
+void Setpoint_Restart(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (uint32_t k = 0; k < gen.tones; k++) {
+        gen.phase[k] = gen.start_phase[k];
+    }
+    gen.chirp_increment = gen.chirp_start;
+    gen.chirp_tick = 0;
+    gen.lfsr = SETPOINT_LFSR_SEED;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Write entries of the arbitrary table
+ */
+HAL_StatusTypeDef Setpoint_WriteTable(uint16_t offset, const void* values, uint32_t count)
+{
+    if (count == 0 || offset + count > SETPOINT_TABLE_SIZE) {
+        return HAL_ERROR;
+    }
+
+    memcpy(&table[offset], values, count * sizeof(float));
+    if (offset == 0) {
+        table_length = count;
+    } else if (offset + count > table_length) {
+        table_length = offset + count;
+    }
+    return HAL_OK;
+}
+
+/**
+ * @brief Advance the waveform by one tick
+ */
+ITCM_CODE void Setpoint_Tick(void)
+{
+    switch (gen.waveform) {
+    case SETPOINT_CHIRP:
+        gen.phase[0] += (uint32_t)(gen.chirp_increment >> 32);
+        gen.chirp_increment += gen.chirp_step;
+        if (++gen.chirp_tick >= gen.chirp_ticks) {
+            // Back to the start frequency, the phase runs on
+            gen.chirp_tick = 0;
+            gen.chirp_increment = gen.chirp_start;
+        }
+        break;
+    case SETPOINT_PRBS: {
+        uint32_t previous = gen.phase[0];
+        gen.phase[0] += gen.increment[0];
+        if (gen.phase[0] < previous) {
+            // One bit per phase wrap, x^15 + x^14 + 1 is maximal length
+            uint16_t bit = ((gen.lfsr >> 14) ^ (gen.lfsr >> 13)) & 1;
+            gen.lfsr = (uint16_t)(((gen.lfsr << 1) | bit) & 0x7FFF);
+        }
+        break;
+    }
+    default:
+        for (uint32_t k = 0; k < gen.tones; k++) {
+            gen.phase[k] += gen.increment[k];
+        }
+        break;
+    }
+}
+
+/**
+ * @brief Get the setpoint at the current phase
+ */
+ITCM_CODE float Setpoint_GetValue(void)
+{
+    float shape = 0.0f;
+
+    switch (gen.waveform) {
+    case SETPOINT_SINE:
+    case SETPOINT_CHIRP:
+        shape = Setpoint_Sine(gen.phase[0]);
+        break;
+    case SETPOINT_MULTISINE:
+        for (uint32_t k = 0; k < gen.tones; k++) {
+            shape += Setpoint_Sine(gen.phase[k]);
+        }
+        break;
+    case SETPOINT_STEP:
+        shape = (gen.phase[0] & 0x80000000UL) ? 1.0f : 0.0f;
+        break;
+    case SETPOINT_PRBS:
+        shape = (gen.lfsr & 1) ? 1.0f : -1.0f;
+        break;
+    case SETPOINT_TABLE: {
+        uint32_t length = table_length;
+        shape = table[(uint32_t)(((uint64_t)gen.phase[0] * length) >> 32)];
+        break;
+    }
+    default:
+        break;
+    }
+
+    return gen.bias + gen.amplitude * shape;
+}
@@ -28,6 +28,8 @@
 #include "bldc_interface.h"
 #include "controller.h"
 #include "motor_speed.h"
+#include "memory_map.h"
+#include "timestamp.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -47,12 +49,16 @@
 
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN PV */
-
+// Core cycles of the whole handler, HAL dispatch included
+DTCM_BSS static volatile Timestamp_CycleStats_t tick_cycles;   // TIM3, the sampling tick
+DTCM_BSS static volatile Timestamp_CycleStats_t hall_cycles;   // TIM4, the hall captures
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 /* USER CODE BEGIN PFP */
-
+// The generated handlers below take their placement from these declarations
+ITCM_CODE void TIM3_IRQHandler(void);
+ITCM_CODE void TIM4_IRQHandler(void);
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
@@ -260,11 +266,11 @@ void TIM2_IRQHandler(void)
 void TIM3_IRQHandler(void)
 {
   /* USER CODE BEGIN TIM3_IRQn 0 */
-
+  uint32_t start = Timestamp_Cycles();
   /* USER CODE END TIM3_IRQn 0 */
   HAL_TIM_IRQHandler(&htim3);
   /* USER CODE BEGIN TIM3_IRQn 1 */
-
+  Timestamp_RecordCycles(&tick_cycles, start);
   /* USER CODE END TIM3_IRQn 1 */
 }
 
@@ -274,11 +280,11 @@ void TIM3_IRQHandler(void)
 void TIM4_IRQHandler(void)
 {
   /* USER CODE BEGIN TIM4_IRQn 0 */
-
+  uint32_t start = Timestamp_Cycles();
   /* USER CODE END TIM4_IRQn 0 */
   HAL_TIM_IRQHandler(&htim4);
   /* USER CODE BEGIN TIM4_IRQn 1 */
-
+  Timestamp_RecordCycles(&hall_cycles, start);
   /* USER CODE END TIM4_IRQn 1 */
 }
 
@@ -326,8 +332,34 @@ void OTG_FS_IRQHandler(void)
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief Copy the handler cycle statistics
+  * @param tick TIM3 handler
+  * @param hall TIM4 handler
+  */
+void Irq_GetCycleStats(Timestamp_CycleStats_t* tick, Timestamp_CycleStats_t* hall)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  *tick = tick_cycles;
+  *hall = hall_cycles;
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief Clear the handler cycle statistics
+  */
+void Irq_ResetCycleStats(void)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  tick_cycles = (Timestamp_CycleStats_t){0};
+  hall_cycles = (Timestamp_CycleStats_t){0};
+  __set_PRIMASK(primask);
+}
+
 
-void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+ITCM_CODE void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
 {
 	if (htim->Instance == TIM3)
 	{
@@ -336,20 +368,23 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
 		//HAL_GPIO_TogglePin(GPIOB, LD1_Pin);
 	}
 
-	if (htim->Instance == TIM2)
-	{
-		HAL_GPIO_TogglePin(GPIOB, LD1_Pin);
-		HAL_GPIO_TogglePin(GPIOB, LD2_Pin);
-	}
-
 }
 
 
 /*ADC Measurement*/
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef* hadc) {
+	// Called when DMA fills the first half block
+	if (hadc->Instance == ADC1) {
+		DataAcq_AdcBlockCallback(0);
+	}
+}
+
 void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc) {
-	// Called when DMA fills the ENTIRE buffer
-	//HAL_GPIO_TogglePin(GPIOB, LD3_Pin);
-	HAL_GPIO_TogglePin(GPIOB, LD3_Pin);
+	// Called when DMA fills the second half block
+	if (hadc->Instance == ADC1) {
+		DataAcq_AdcBlockCallback(1);
+		HAL_GPIO_TogglePin(GPIOB, LD3_Pin);
+	}
 }
 
 
@@ -357,12 +392,40 @@ void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc) {
 
 
 
-void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim)
+ITCM_CODE void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim)
 {
 	MotorSpeed_TimerCallback(htim);
 }
 
 
+/*VESC UART*/
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+	// Idle line, half or full ring, Size is the DMA write position
+	if (huart->Instance == USART2) {
+		bldc_interface_uart_rx_event(Size);
+	}
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	// Send the frames queued behind the finished transfer
+	if (huart->Instance == USART2) {
+		bldc_interface_uart_tx_complete();
+	}
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	if (huart->Instance != USART2) {
+		return;
+	}
+	// Overrun and framing errors abort the RX DMA, the main loop restarts it
+	bldc_interface_uart_rx_error();
+	bldc_interface_uart_tx_error();
+}
+
+
 
 
 /* USER CODE END 1 */
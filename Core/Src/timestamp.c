@@ -0,0 +1,25 @@
+/**
+ * @file timestamp.c
+ * @brief Implementation of the TIM5 microsecond time base
+ */
+
+#include "timestamp.h"
+
+/**
+ * @brief Start the free-running time base and the DWT cycle counter
+ */
+HAL_StatusTypeDef Timestamp_Init(TIM_HandleTypeDef* htim)
+{
+    if (htim == NULL || htim->Instance != TIM5) {
+        return HAL_ERROR;
+    }
+
+    // The M7 DWT is locked until the lock access register is written
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->LAR = 0xC5ACCE55;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    __HAL_TIM_SET_COUNTER(htim, 0);
+    return HAL_TIM_Base_Start(htim);
+}
@@ -0,0 +1,162 @@
+/**
+ * @file trajectory.c
+ * @brief Implementation of the double-buffered setpoint trajectory
+ */
+
+#include "trajectory.h"
+#include <string.h>
+#include "memory_map.h"
+
+#define TRAJECTORY_NUM_BANKS    2
+
+/* Private variables */
+static float banks[TRAJECTORY_NUM_BANKS][TRAJECTORY_BANK_SIZE];
+static volatile uint16_t bank_length[TRAJECTORY_NUM_BANKS];
+static volatile uint8_t bank_ready[TRAJECTORY_NUM_BANKS];  // Committed and not played out
+static volatile uint8_t bank_last[TRAJECTORY_NUM_BANKS];   // Committed as the final bank
+static uint8_t fill_bank = 0;                   // Host side, next bank to commit
+static uint16_t fill_length = 0;                // Points written into fill_bank
+static uint8_t play_bank = 0;                   // Tick side
+static uint16_t play_index = 0;
+static float held = 0.0f;                       // Last point applied
+static volatile Trajectory_State_t state = TRAJECTORY_IDLE;
+static volatile uint32_t played = 0;
+static volatile uint32_t underruns = 0;
+
+/**
+ * @brief Stop playback and free both banks
+ */
+void Trajectory_Reset(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    state = TRAJECTORY_IDLE;
+    for (uint32_t i = 0; i < TRAJECTORY_NUM_BANKS; i++) {
+        bank_ready[i] = 0;
+        bank_last[i] = 0;
+        bank_length[i] = 0;
+    }
+    fill_bank = 0;
+    fill_length = 0;
+    play_bank = 0;
+    play_index = 0;
+    played = 0;
+    underruns = 0;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Write points into the bank being filled
+ */
+HAL_StatusTypeDef Trajectory_Write(uint16_t offset, const void* values, uint32_t count)
+{
+    if (bank_ready[fill_bank]) {
+        return HAL_BUSY;
+    }
+    if (count == 0 || offset + count > TRAJECTORY_BANK_SIZE) {
+        return HAL_ERROR;
+    }
+
+    // The tick does not read a bank until it is committed
+    memcpy(&banks[fill_bank][offset], values, count * sizeof(float));
+    if (offset + count > fill_length) {
+        fill_length = offset + count;
+    }
+    return HAL_OK;
+}
+
+/**
+ * @brief Queue the bank being filled for playback and start filling the other one
+ */
+HAL_StatusTypeDef Trajectory_Commit(uint8_t last)
+{
+    if (bank_ready[fill_bank] || fill_length == 0) {
+        return HAL_ERROR;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bank_length[fill_bank] = fill_length;
+    bank_last[fill_bank] = (last != 0);
+    bank_ready[fill_bank] = 1;
+    __set_PRIMASK(primask);
+
+    fill_bank ^= 1;
+    fill_length = 0;
+    return HAL_OK;
+}
+
+/**
+ * @brief Start playback on the next set_rpm sample
+ */
+HAL_StatusTypeDef Trajectory_Start(void)
+{
+    HAL_StatusTypeDef status = HAL_ERROR;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (bank_ready[play_bank]) {
+        play_index = 0;
+        played = 0;
+        underruns = 0;
+        state = TRAJECTORY_PLAYING;
+        status = HAL_OK;
+    }
+    __set_PRIMASK(primask);
+
+    return status;
+}
+
+/**
+ * @brief Check whether the trajectory provides the setpoint
+ */
+ITCM_CODE uint8_t Trajectory_IsActive(void)
+{
+    return state != TRAJECTORY_IDLE;
+}
+
+/**
+ * @brief Take the next point
+ */
+ITCM_CODE float Trajectory_Next(void)
+{
+    if (state != TRAJECTORY_PLAYING) {
+        return held;
+    }
+    if (!bank_ready[play_bank]) {
+        // The host has not committed the next bank in time
+        underruns++;
+        return held;
+    }
+
+    held = banks[play_bank][play_index++];
+    played++;
+
+    if (play_index >= bank_length[play_bank]) {
+        uint8_t last = bank_last[play_bank];
+        bank_ready[play_bank] = 0;
+        play_bank ^= 1;
+        play_index = 0;
+        if (last) {
+            state = TRAJECTORY_DONE;
+        }
+    }
+    return held;
+}
+
+/**
+ * @brief Copy the playback statistics
+ */
+void Trajectory_GetStats(Trajectory_Stats_t* stats)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    stats->state = state;
+    stats->played = played;
+    stats->underruns = underruns;
+    stats->banks_free = 0;
+    for (uint32_t i = 0; i < TRAJECTORY_NUM_BANKS; i++) {
+        stats->banks_free += !bank_ready[i];
+    }
+    __set_PRIMASK(primask);
+}
@@ -1,14 +1,25 @@
-#include "usbd_cdc_if.h" // Make sure you include the necessary header for CDC functions
 #include "main.h"
 #include "usbd_cdc_if.h" // For CDC functions
+#include "usb_comm.h"
 #include "data_acquisition.h"
 #include "motor_speed.h"
+#include "sample_ring.h"
+#include "sample_codec.h"
+#include "sample_pack.h"
+#include "timestamp.h"
+#include "vesc_telemetry.h"
+#include "vesc_link.h"
+#include "motor_command.h"
+#include "controller.h"
+#include "setpoint.h"
+#include "trajectory.h"
+#include "vesc_config.h"
+#include "bldc_interface_uart.h"
+#include "stm32f7xx_it.h"
+#include <string.h>
 
 
 
-volatile uint8_t active_buffer = 0;
-volatile uint32_t usb_buffer[2][ADC_BUFFER_SIZE+2][USB_BUFFER_SIZE];
-uint32_t packet_counter = 0;
 // USB Program Run Variables
 uint8_t data_acquisition_running = 0; // Flag to control data acquisition
 uint8_t usb_command_buffer[1]; // Buffer to receive USB commands
@@ -18,55 +29,397 @@ extern TIM_HandleTypeDef htim2;
 extern TIM_HandleTypeDef htim3;
 extern TIM_HandleTypeDef htim4;
 
-extern uint32_t time_ms;
+// CDC sends straight from these buffers, so a slot stays owned by the
+// driver until its transfer complete callback. OTG FS has no DMA, the core
+// copies them into the FIFO, so they need no cache maintenance
+static uint32_t tx_queue[USB_TX_QUEUE_DEPTH][USB_FRAME_MAX_SIZE / sizeof(uint32_t)];
+static uint16_t tx_length[USB_TX_QUEUE_DEPTH];
+static volatile uint32_t tx_head = 0;     // Next slot to fill, main loop only
+static volatile uint32_t tx_tail = 0;     // Slot in flight or next to send, USB ISR only
+static volatile uint8_t tx_active = 0;    // A CDC transfer is in flight
+static uint32_t frame_sequence = 0;       // Sequence number of the next frame
+static uint32_t last_frame_tick = 0;      // HAL tick of the last frame queued
+static UsbTxStats_t tx_stats;
+static uint32_t rate_window_tick = 0;     // Start of the bytes/sec window
+static uint32_t rate_window_bytes = 0;    // bytes_sent at the start of the window
+static volatile uint8_t descriptor_pending = 0;  // Stream descriptor must be sent before more data
+static volatile uint8_t sample_encoding = USB_ENCODING_COMPACT;
+static volatile uint8_t stats_pending = 0;       // Host asked for a stats frame
+static volatile uint8_t start_pending = 0;       // Host asked for a start, the main loop resets the stream
+static uint8_t pack_order[DATAACQ_NUM_CHANNELS] = {  // Delta order per channel in packed frames
+    [0 ... DATAACQ_NUM_CHANNELS - 1] = 1
+};
+static SampleRecord_t pack_block[SAMPLE_PACK_MAX_RECORDS];
+static SamplePack_Sizer_t pack_sizer;
 
-// Assuming usb_buffer is defined like this (adjust types if needed):
-// uint32_t usb_buffer[2][5][USB_BUFFER_SIZE];
-// Function to transmit a single USB packet
-static uint8_t transmit_usb_packet(uint32_t* data, uint16_t data_len) {
-    uint8_t status;
-    uint32_t start_time = HAL_GetTick();
+_Static_assert(sizeof(UsbFrameHeader_t) + SAMPLE_PACK_RECORD_MAX_SIZE <= USB_FRAME_MAX_SIZE,
+               "a packed block of one record must fit in one frame");
 
-    do {
-        status = CDC_Transmit_FS((uint8_t*)data, data_len);
-    } while (status != USBD_OK);
+// Start the next queued frame if the endpoint is free, caller must hold off the USB ISR
+static void start_next_frame(void) {
+    if (tx_active || tx_head == tx_tail) {
+        return;
+    }
+
+    uint32_t slot = tx_tail % USB_TX_QUEUE_DEPTH;
+
+    if (CDC_Transmit_FS((uint8_t*)tx_queue[slot], tx_length[slot]) == USBD_OK) {
+        tx_active = 1;
+    } else {
+        tx_stats.busy_count++;
+    }
+}
+
+// Kick the transmitter from thread context
+static void kick_transmit(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    start_next_frame();
+    __set_PRIMASK(primask);
+}
+
+// Fill in the common frame header
+static void write_header(uint32_t* frame, uint8_t type, uint16_t count, uint16_t payload_size) {
+    UsbFrameHeader_t* header = (UsbFrameHeader_t*)frame;
+
+    header->magic = USB_FRAME_MAGIC;
+    header->sequence = frame_sequence++;
+    header->type = type;
+    header->version = USB_FRAME_VERSION;
+    header->count = count;
+    header->payload_size = payload_size;
+    header->reserved = 0;
+}
+
+// Size a record takes in a USB_FRAME_TYPE_DATA frame
+static uint32_t raw_record_size(const SampleRecord_t* record) {
+    return (3 + __builtin_popcount(record->mask)) * sizeof(uint32_t);
+}
+
+// Pack ring records into one data frame, only the channels flagged in each mask are sent
+static uint16_t build_raw_frame(uint32_t* frame) {
+    uint32_t* out = frame + sizeof(UsbFrameHeader_t) / sizeof(uint32_t);
+    uint32_t* end = frame + USB_FRAME_MAX_SIZE / sizeof(uint32_t);
+    SampleRecord_t record;
+    uint16_t count = 0;
+
+    while ((end - out) * sizeof(uint32_t) >= USB_SAMPLE_MAX_SIZE && SampleRing_Pop(&record)) {
+        *out++ = record.counter;
+        *out++ = record.time_us;
+        *out++ = record.mask;
+        for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+            if (record.mask & (1UL << ch)) {
+                *out++ = record.value[ch];
+            }
+        }
+        tx_stats.raw_bytes += raw_record_size(&record);
+        count++;
+    }
+
+    uint16_t payload_size = (uint8_t*)out - (uint8_t*)frame - sizeof(UsbFrameHeader_t);
+    write_header(frame, USB_FRAME_TYPE_DATA, count, payload_size);
+
+    return sizeof(UsbFrameHeader_t) + payload_size;
+}
+
+// Encode ring records into one compact data frame, the first record is always absolute
+static uint16_t build_compact_frame(uint32_t* frame) {
+    uint8_t* out = (uint8_t*)frame + sizeof(UsbFrameHeader_t);
+    uint8_t* end = (uint8_t*)frame + USB_FRAME_MAX_SIZE;
+    SampleCodec_State_t codec;
+    SampleRecord_t record;
+    uint16_t count = 0;
+
+    SampleCodec_Reset(&codec);
+    while ((uint32_t)(end - out) >= SAMPLE_CODEC_MAX_SIZE && SampleRing_Pop(&record)) {
+        out += SampleCodec_Encode(&codec, &record, out);
+        tx_stats.raw_bytes += raw_record_size(&record);
+        count++;
+    }
+
+    uint16_t payload_size = out - (uint8_t*)frame - sizeof(UsbFrameHeader_t);
+    write_header(frame, USB_FRAME_TYPE_DATA_COMPACT, count, payload_size);
+
+    return sizeof(UsbFrameHeader_t) + payload_size;
+}
 
-    uint32_t transmit_time = HAL_GetTick() - start_time;
+// Compress ring records column-wise into a data frame, the block ends before the record that would not fit
+static uint16_t build_packed_frame(uint32_t* frame) {
+    uint8_t* out = (uint8_t*)frame + sizeof(UsbFrameHeader_t);
+    uint16_t count = 0;
 
-    if (transmit_time > 10) {
-        // Log or debug if transmit time exceeds threshold
+    SamplePack_BeginBlock(&pack_sizer, pack_order);
+    while (count < SAMPLE_PACK_MAX_RECORDS && SampleRing_Peek(&pack_block[count])) {
+        if (SamplePack_AddRecord(&pack_sizer, &pack_block[count]) > USB_FRAME_MAX_SIZE - sizeof(UsbFrameHeader_t)) {
+            break; // Stays in the ring for the next frame
+        }
+        SampleRing_Pop(&pack_block[count]);
+        tx_stats.raw_bytes += raw_record_size(&pack_block[count]);
+        count++;
     }
-    return status; // Return the status of transmission.
+
+    uint16_t payload_size = (count > 0) ? SamplePack_Encode(pack_block, count, pack_sizer.orders, out) : 0;
+    write_header(frame, USB_FRAME_TYPE_DATA_PACKED, count, payload_size);
+
+    return sizeof(UsbFrameHeader_t) + payload_size;
 }
 
+// Build one data frame in the selected encoding and account for its cost
+static uint16_t build_data_frame(uint32_t* frame) {
+    uint32_t start = Timestamp_Cycles();
+    uint16_t length;
 
-// Function to process and transmit a buffer
-static void process_and_transmit_buffer(uint8_t buffer_index, uint32_t* packet_counter) {
-    for (uint16_t i = 0; i < USB_BUFFER_SIZE; i++) {
-        uint32_t header = 0xddccbbaa;
-        uint32_t values[7] = {
-            header,
-            (*packet_counter)++, // Increment and use the packet counter. Important to dereference it.
-            usb_buffer[buffer_index][0][i],
-            usb_buffer[buffer_index][1][i],
-            usb_buffer[buffer_index][2][i],
-            usb_buffer[buffer_index][3][i],
-            usb_buffer[buffer_index][4][i]
-        };
+    if (sample_encoding == USB_ENCODING_PACKED) {
+        length = build_packed_frame(frame);
+    } else if (sample_encoding == USB_ENCODING_COMPACT) {
+        length = build_compact_frame(frame);
+    } else {
+        length = build_raw_frame(frame);
+    }
+
+    tx_stats.encode_cycles += Timestamp_Cycles() - start;
+    tx_stats.encoded_samples += ((UsbFrameHeader_t*)frame)->count;
+    tx_stats.encoded_bytes += length - sizeof(UsbFrameHeader_t);
+
+    return length;
+}
 
-        transmit_usb_packet(values, sizeof(values));
+// Samples that fill one data frame, for packed frames the largest block
+static uint32_t frame_capacity(void) {
+    if (sample_encoding == USB_ENCODING_PACKED) {
+        return SAMPLE_PACK_MAX_RECORDS;
     }
+    if (sample_encoding == USB_ENCODING_COMPACT) {
+        return USB_FRAME_MAX_SAMPLES_COMPACT;
+    }
+    return USB_FRAME_MAX_SAMPLES;
 }
 
+// Describe the base rate and every channel divider so the host can rebuild channel timing
+static uint16_t build_descriptor_frame(uint32_t* frame) {
+    uint8_t* out = (uint8_t*)frame + sizeof(UsbFrameHeader_t);
+    uint32_t base_rate = DataAcq_GetBaseRate();
+
+    memcpy(out, &base_rate, sizeof(base_rate));
+    out += sizeof(base_rate);
 
-void usb_transmit_task() {
-    if (buffer_ready_flag == BUFFER_STATE_READY_0) {
-        process_and_transmit_buffer(0, &packet_counter);
-        buffer_ready_flag = BUFFER_STATE_BUSY;
-    } else if (buffer_ready_flag == BUFFER_STATE_READY_1) {
-        process_and_transmit_buffer(1, &packet_counter);
-        buffer_ready_flag = BUFFER_STATE_BUSY;
+    for (uint8_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+        UsbChannelDescriptor_t desc;
+        desc.id = ch;
+        desc.kind = DataAcq_GetChannelKind(ch);
+        desc.divider = DataAcq_GetChannelDivider(ch);
+        strncpy(desc.name, DataAcq_GetChannelName(ch), sizeof(desc.name));
+        memcpy(out, &desc, sizeof(desc));
+        out += sizeof(desc);
     }
+
+    uint16_t payload_size = out - (uint8_t*)frame - sizeof(UsbFrameHeader_t);
+    write_header(frame, USB_FRAME_TYPE_DESCRIPTOR, DATAACQ_NUM_CHANNELS, payload_size);
+
+    return sizeof(UsbFrameHeader_t) + payload_size;
+}
+
+// Collect the VESC side counters, called from the main loop
+static void get_vesc_stats(UsbVescStats_t* stats) {
+    VescTelemetry_Stats_t telemetry;
+    MotorCommand_Stats_t motor;
+    VescConfig_Stats_t config;
+
+    VescTelemetry_GetStats(&telemetry);
+    MotorCommand_GetStats(&motor);
+    VescConfig_GetStats(&config);
+
+    stats->link_state = VescLink_GetState();
+    stats->link_baud = bldc_interface_uart_get_baud();
+    stats->tx_dropped = bldc_interface_uart_tx_dropped();
+    stats->telemetry_requests = telemetry.requests;
+    stats->telemetry_replies = telemetry.replies;
+    stats->telemetry_timeouts = telemetry.timeouts;
+    stats->telemetry_max_latency_us = telemetry.max_latency_us;
+    stats->motor_sent = motor.sent;
+    stats->motor_keepalives = motor.keepalives;
+    stats->motor_coalesced = motor.coalesced;
+    stats->config_valid = config.valid;
+    stats->config_hash = config.hash;
+    stats->config_writes = config.writes;
+    stats->config_writes_skipped = config.writes_skipped;
+    stats->config_changed_fields = config.changed_fields;
+}
+
+// Collect the speed controller counters
+static void get_control_stats(UsbControlStats_t* stats) {
+    Controller_Stats_t control;
+    Trajectory_Stats_t trajectory;
+
+    Controller_GetStats(&control);
+    Trajectory_GetStats(&trajectory);
+
+    stats->mode = control.mode;
+    stats->computes = control.computes;
+    stats->saturations = control.saturations;
+    stats->cycles_last = control.cycles_last;
+    stats->cycles_max = control.cycles_max;
+    stats->trajectory_state = trajectory.state;
+    stats->trajectory_played = trajectory.played;
+    stats->trajectory_underruns = trajectory.underruns;
+    stats->trajectory_banks_free = trajectory.banks_free;
+}
+
+// Collect the interrupt handler timing
+static void get_isr_stats(UsbIsrStats_t* stats) {
+    Timestamp_CycleStats_t tick;
+    Timestamp_CycleStats_t hall;
+
+    Irq_GetCycleStats(&tick, &hall);
+
+    stats->tick_count = tick.count;
+    stats->tick_cycles_last = tick.last;
+    stats->tick_cycles_max = tick.max;
+    stats->hall_count = hall.count;
+    stats->hall_cycles_last = hall.last;
+    stats->hall_cycles_max = hall.max;
+}
+
+// Snapshot the transmit, VESC, controller and interrupt statistics for the host
+static uint16_t build_stats_frame(uint32_t* frame) {
+    UsbTxStats_t stats;
+    UsbVescStats_t vesc;
+    UsbControlStats_t control;
+    UsbIsrStats_t isr;
+    uint8_t* payload = (uint8_t*)frame + sizeof(UsbFrameHeader_t);
+    uint16_t payload_size = sizeof(stats) + sizeof(vesc) + sizeof(control) + sizeof(isr);
+
+    usb_get_tx_stats(&stats);
+    get_vesc_stats(&vesc);
+    get_control_stats(&control);
+    get_isr_stats(&isr);
+    memcpy(payload, &stats, sizeof(stats));
+    memcpy(payload + sizeof(stats), &vesc, sizeof(vesc));
+    memcpy(payload + sizeof(stats) + sizeof(vesc), &control, sizeof(control));
+    memcpy(payload + sizeof(stats) + sizeof(vesc) + sizeof(control), &isr, sizeof(isr));
+    write_header(frame, USB_FRAME_TYPE_STATS, payload_size / sizeof(uint32_t), payload_size);
+
+    return sizeof(UsbFrameHeader_t) + payload_size;
+}
+
+// Claim the next free queue slot, NULL when the queue is full
+static uint32_t* claim_slot(void) {
+    if (tx_head - tx_tail >= USB_TX_QUEUE_DEPTH) {
+        return NULL;
+    }
+    return tx_queue[tx_head % USB_TX_QUEUE_DEPTH];
+}
+
+// Hand the filled slot over to the transmitter
+static void commit_slot(uint16_t length) {
+    tx_length[tx_head % USB_TX_QUEUE_DEPTH] = length;
+    __DMB();
+    tx_head++;
+    tx_stats.frames_queued++;
+
+    uint32_t depth = tx_head - tx_tail;
+    if (depth > tx_stats.max_queue_depth) {
+        tx_stats.max_queue_depth = depth;
+    }
+}
+
+// Refresh the bytes/sec figure once per second
+static void update_rate(void) {
+    uint32_t now = HAL_GetTick();
+    uint32_t elapsed = now - rate_window_tick;
+
+    if (elapsed >= 1000) {
+        tx_stats.bytes_per_sec = (uint32_t)(((uint64_t)(tx_stats.bytes_sent - rate_window_bytes) * 1000) / elapsed);
+        rate_window_bytes = tx_stats.bytes_sent;
+        rate_window_tick = now;
+    }
+}
+
+// Reset the stream from the consumer side and start the producer. The ring,
+// the frame sequence and the statistics belong to the main loop, resetting
+// them from the USB ISR could land inside SampleRing_Pop()
+static void start_acquisition(void) {
+    DataAcq_Init();
+    frame_sequence = 0;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memset(&tx_stats, 0, sizeof(tx_stats));
+    rate_window_bytes = 0;
+    rate_window_tick = HAL_GetTick();
+    // A stop received meanwhile cancels the start
+    if (start_pending) {
+        start_pending = 0;
+        descriptor_pending = 1; // Stream always opens with its descriptor
+        HAL_TIM_Base_Start_IT(&htim3); // Start TIM3 and interrupts
+        HAL_TIM_Base_Start(&htim2); // Start the ADC scan trigger
+        data_acquisition_running = 1;
+    }
+    __set_PRIMASK(primask);
+}
+
+void usb_transmit_task(void) {
+    uint32_t* slot;
+
+    if (start_pending) {
+        start_acquisition();
+    }
+
+    if (descriptor_pending && (slot = claim_slot()) != NULL) {
+        descriptor_pending = 0;
+        commit_slot(build_descriptor_frame(slot));
+    }
+    if (stats_pending && (slot = claim_slot()) != NULL) {
+        stats_pending = 0;
+        commit_slot(build_stats_frame(slot));
+    }
+
+    // Queue as many frames as the ring and the free slots allow, never wait
+    while (1) {
+        uint32_t pending = SampleRing_Count();
+
+        if (pending == 0) {
+            break;
+        }
+
+        // Hold back partial frames until they fill up or get too old
+        if (pending < frame_capacity() &&
+                (HAL_GetTick() - last_frame_tick) < USB_FRAME_FLUSH_MS) {
+            break;
+        }
+
+        slot = claim_slot();
+        if (slot == NULL) {
+            // Host is not reading fast enough, samples wait in the ring
+            tx_stats.stall_count++;
+            break;
+        }
+
+        commit_slot(build_data_frame(slot));
+        last_frame_tick = HAL_GetTick();
+    }
+
+    kick_transmit();
+    update_rate();
+}
+
+void usb_tx_complete_callback(void) {
+    // Called from the USB ISR once the frame at tx_tail has left the device
+    if (!tx_active) {
+        return;
+    }
+
+    tx_stats.bytes_sent += tx_length[tx_tail % USB_TX_QUEUE_DEPTH];
+    tx_stats.frames_sent++;
+    tx_tail++;
+    tx_active = 0;
+
+    start_next_frame();
+}
+
+void usb_get_tx_stats(UsbTxStats_t* stats) {
+    *stats = tx_stats;
+    stats->queue_depth = tx_head - tx_tail;
 }
 
 uint8_t CDC_Receive_FS_App(uint8_t *Buf, uint32_t *Len)
@@ -77,28 +430,103 @@ uint8_t CDC_Receive_FS_App(uint8_t *Buf, uint32_t *Len)
   // Process received command
   if (*Len > 0) {
     if (Buf[0] == 'S') { // Start command
-      if (!data_acquisition_running) {
-        HAL_TIM_Base_Start_IT(&htim3); // Start TIM3 and interrupts
-        HAL_TIM_Base_Start_IT(&htim2); // Start TIM2 and interrupts (if needed for toggling)
-        data_acquisition_running = 1;
-        buffer_ready_flag = 3; // Set to initial not ready value.
-        packet_counter = 0; // Reset packet counter
-        DataAcq_Init();
+      if (!data_acquisition_running && !start_pending) {
+        // The ring and the stream are reset by usb_transmit_task() before TIM3 starts
         MotorSpeed_Init(&htim4);
-        active_buffer = 0;
+        Irq_ResetCycleStats();
+        MotorCommand_Release();
+        start_pending = 1;
       } else {
       }
     } else if (Buf[0] == 'T') { // Stop command
-      if (data_acquisition_running) {
+      if (data_acquisition_running || start_pending) {
+        start_pending = 0;
         HAL_TIM_Base_Stop_IT(&htim3); // Stop TIM3 and interrupts
-        HAL_TIM_Base_Stop_IT(&htim2); // Stop TIM2 and interrupts
-        data_acquisition_running = 0;
-        buffer_ready_flag = 3; // Ensure sending loop stops gracefully
+        HAL_TIM_Base_Stop(&htim2); // Stop the ADC scan trigger
+        data_acquisition_running = 0; // Records already in the ring are still sent
+        MotorCommand_Stop(); // Silence, the VESC timeout releases the motor
+      } else {
+      }
+    } else if (Buf[0] == 'F' && *Len >= 5) { // Base rate: u32 Hz
+      uint32_t rate_hz;
+      memcpy(&rate_hz, &Buf[1], sizeof(rate_hz));
+      if (DataAcq_SetBaseRate(rate_hz) == HAL_OK) {
+        descriptor_pending = 1;
+      }
+    } else if (Buf[0] == 'R' && *Len >= 4) { // Channel rate: u8 channel, u16 divider
+      uint16_t divider;
+      memcpy(&divider, &Buf[2], sizeof(divider));
+      if (DataAcq_SetChannelDivider(Buf[1], divider) == HAL_OK) {
+        descriptor_pending = 1;
+      }
+    } else if (Buf[0] == 'E' && *Len >= 2) { // Sample encoding: u8 USB_ENCODING_*
+      if (Buf[1] <= USB_ENCODING_PACKED) {
+        sample_encoding = Buf[1]; // Takes effect with the next frame
+      }
+    } else if (Buf[0] == 'P' && *Len >= 3) { // Packed delta order: u8 channel, u8 order
+      if (Buf[1] < DATAACQ_NUM_CHANNELS && Buf[2] <= SAMPLE_PACK_MAX_ORDER) {
+        pack_order[Buf[1]] = Buf[2];
+      }
+    } else if (Buf[0] == 'V' && *Len >= 3) { // VESC telemetry poll rate: u16 Hz
+      uint16_t rate_hz;
+      memcpy(&rate_hz, &Buf[1], sizeof(rate_hz));
+      VescTelemetry_SetRate(rate_hz);
+    } else if (Buf[0] == 'M' && *Len >= 5) { // Motor command rates: u16 max Hz, u16 keep-alive Hz
+      uint16_t max_rate_hz, keepalive_hz;
+      memcpy(&max_rate_hz, &Buf[1], sizeof(max_rate_hz));
+      memcpy(&keepalive_hz, &Buf[3], sizeof(keepalive_hz));
+      MotorCommand_SetRates(max_rate_hz, keepalive_hz);
+    } else if (Buf[0] == 'H' && *Len >= 5) { // Hall stall timeout: u32 microseconds
+      uint32_t timeout_us;
+      memcpy(&timeout_us, &Buf[1], sizeof(timeout_us));
+      MotorSpeed_SetStallTimeout(timeout_us);
+    } else if (Buf[0] == 'O' && *Len >= 2) { // Control mode: u8 Controller_Mode_t
+      Controller_SetMode((Controller_Mode_t)Buf[1]);
+    } else if (Buf[0] == 'G' && *Len >= 17) { // PID gains: f32 Kp, Ki, Kd, current limit
+      float gains[4];
+      memcpy(gains, &Buf[1], sizeof(gains));
+      Controller_SetGains(gains[0], gains[1], gains[2], gains[3]);
+    } else if (Buf[0] == 'W' && *Len >= 22) { // Setpoint waveform: u8 type, f32 bias, amplitude, f0, f1, duration
+      Setpoint_Params_t params;
+      float values[5];
+      params.waveform = Buf[1];
+      memcpy(values, &Buf[2], sizeof(values));
+      params.bias = values[0];
+      params.amplitude = values[1];
+      params.f0 = values[2];
+      params.f1 = values[3];
+      params.duration = values[4];
+      Setpoint_Load(&params);
+    } else if (Buf[0] == 'A' && *Len >= 7) { // Setpoint table: u16 offset, f32 values to the end
+      uint16_t offset;
+      memcpy(&offset, &Buf[1], sizeof(offset));
+      Setpoint_WriteTable(offset, &Buf[3], (*Len - 3) / sizeof(float));
+    } else if (Buf[0] == 'J' && *Len >= 7) { // Trajectory points: u16 offset, f32 values to the end
+      uint16_t offset;
+      memcpy(&offset, &Buf[1], sizeof(offset));
+      Trajectory_Write(offset, &Buf[3], (*Len - 3) / sizeof(float));
+    } else if (Buf[0] == 'K' && *Len >= 2) { // Commit the trajectory bank: u8 last
+      Trajectory_Commit(Buf[1]);
+    } else if (Buf[0] == 'Y' && *Len >= 2) { // Trajectory playback: u8 1 play, 0 stop
+      if (Buf[1]) {
+        Trajectory_Start();
       } else {
+        Trajectory_Reset();
       }
+    } else if (Buf[0] == 'C') { // Reread the VESC motor configuration
+      VescConfig_Refresh();
+    } else if (Buf[0] == 'X' && *Len >= 3) { // VESC motor configuration fields: (u8 field, value)...
+      VescConfig_RequestFields(&Buf[1], *Len - 1);
+    } else if (Buf[0] == 'B' && *Len >= 5) { // VESC link baud rate: u32
+      uint32_t baud;
+      memcpy(&baud, &Buf[1], sizeof(baud));
+      VescLink_SetBaud(baud);
+    } else if (Buf[0] == 'Q') { // Send a stats frame
+      stats_pending = 1;
+    } else if (Buf[0] == 'D') { // Resend the stream descriptor
+      descriptor_pending = 1;
     } else {
     }
   }
   return USBD_OK;
 }
-
@@ -0,0 +1,242 @@
+/**
+ * @file vesc_config.c
+ * @brief Implementation of the VESC motor configuration cache
+ */
+
+#include "vesc_config.h"
+#include "bldc_interface.h"
+#include "conf_codec.h"
+#include <string.h>
+
+#define VESC_CONFIG_FNV_OFFSET  2166136261UL
+#define VESC_CONFIG_FNV_PRIME   16777619UL
+
+/* Private variables */
+static mc_configuration cache;                      // Main loop only
+static uint8_t cache_wire[CONF_CODEC_MCCONF_MAX_SIZE];  // Encoding of the cache
+static int32_t cache_wire_len = 0;
+static volatile uint8_t refresh_pending = 1;        // Cache empty, a read is due
+static uint8_t read_pending = 0;                    // COMM_GET_MCCONF sent, no reply yet
+static uint32_t read_tick = 0;                      // HAL tick of the last read
+static mc_configuration written;                    // Sent, waiting for the confirmation
+static uint8_t written_wire[CONF_CODEC_MCCONF_MAX_SIZE];
+static int32_t written_wire_len = 0;
+static uint8_t write_pending = 0;                   // COMM_SET_MCCONF sent, not confirmed yet
+static uint32_t write_tick = 0;                     // HAL tick of the last write
+static uint8_t request[VESC_CONFIG_MAX_REQUEST];    // Field changes from the host
+static volatile uint32_t request_length = 0;        // Nonzero while a request is queued
+static VescConfig_Stats_t stats;
+
+/* Private function prototypes */
+static void VescConfig_OnMcconf(mc_configuration* conf);
+static void VescConfig_OnWriteAck(void);
+static void VescConfig_Store(const mc_configuration* conf, const uint8_t* wire, int32_t length);
+static uint32_t VescConfig_Hash(const uint8_t* data, int32_t length);
+static void VescConfig_ApplyRequest(void);
+
+/**
+ * @brief FNV-1a, small and good enough to tell configurations apart
+ */
+static uint32_t VescConfig_Hash(const uint8_t* data, int32_t length)
+{
+    uint32_t hash = VESC_CONFIG_FNV_OFFSET;
+
+    for (int32_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= VESC_CONFIG_FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Take a configuration and its encoding as the VESC state
+ */
+static void VescConfig_Store(const mc_configuration* conf, const uint8_t* wire, int32_t length)
+{
+    cache = *conf;
+    memcpy(cache_wire, wire, length);
+    cache_wire_len = length;
+    stats.hash = VescConfig_Hash(wire, length);
+    stats.valid = 1;
+}
+
+/**
+ * @brief bldc_interface configuration callback, runs in the main loop
+ */
+static void VescConfig_OnMcconf(mc_configuration* conf)
+{
+    uint8_t wire[CONF_CODEC_MCCONF_MAX_SIZE];
+
+    // A refresh requested while this read was on its way asks again
+    if (!read_pending) {
+        return;
+    }
+    read_pending = 0;
+    VescConfig_Store(conf, wire, ConfCodec_EncodeMcconf(conf, wire));
+}
+
+/**
+ * @brief bldc_interface write confirmation callback, the cache takes the written configuration
+ */
+static void VescConfig_OnWriteAck(void)
+{
+    stats.writes_acked++;
+    if (write_pending) {
+        write_pending = 0;
+        VescConfig_Store(&written, written_wire, written_wire_len);
+    }
+}
+
+/**
+ * @brief Apply the queued field changes to the cache and write the result
+ */
+static void VescConfig_ApplyRequest(void)
+{
+    mc_configuration conf = cache;
+    uint32_t ind = 0;
+
+    while (ind < request_length) {
+        int32_t read = ConfCodec_DecodeMcconfField(request[ind], &request[ind + 1],
+                                                   request_length - ind - 1, &conf);
+        if (read < 0) {
+            // Nothing is written from a request that does not parse
+            stats.requests_rejected++;
+            return;
+        }
+        ind += 1 + read;
+    }
+    VescConfig_Write(&conf);
+}
+
+/**
+ * @brief Register the configuration callbacks with bldc_interface
+ */
+void VescConfig_Init(void)
+{
+    bldc_interface_set_rx_mcconf_func(VescConfig_OnMcconf);
+    bldc_interface_set_rx_mcconf_received_func(VescConfig_OnWriteAck);
+    memset(&stats, 0, sizeof(stats));
+    read_pending = 0;
+    write_pending = 0;
+    request_length = 0;
+    refresh_pending = 1;
+}
+
+/**
+ * @brief Drop the cache and read the configuration again
+ */
+void VescConfig_Refresh(void)
+{
+    refresh_pending = 1;
+}
+
+/**
+ * @brief Request the configuration while the cache is empty
+ */
+void VescConfig_Task(void)
+{
+    if (write_pending && HAL_GetTick() - write_tick >= VESC_CONFIG_WRITE_TIMEOUT_MS) {
+        // The VESC may or may not hold the write, only a read tells
+        stats.write_timeouts++;
+        refresh_pending = 1;
+    }
+
+    if (refresh_pending) {
+        refresh_pending = 0;
+        stats.valid = 0;
+        stats.hash = 0;
+        read_pending = 0;
+        write_pending = 0;
+    }
+
+    if (stats.valid) {
+        // Requests wait for the cache and for the previous write
+        if (request_length != 0 && !write_pending) {
+            VescConfig_ApplyRequest();
+            request_length = 0;
+        }
+        return;
+    }
+
+    // One read in flight, ask again when its reply is overdue
+    if (read_pending && HAL_GetTick() - read_tick < VESC_CONFIG_REPLY_TIMEOUT_MS) {
+        return;
+    }
+    read_pending = 1;
+    read_tick = HAL_GetTick();
+    stats.reads++;
+    bldc_interface_get_mcconf();
+}
+
+/**
+ * @brief Copy the cached configuration
+ */
+HAL_StatusTypeDef VescConfig_Get(mc_configuration* conf)
+{
+    if (!stats.valid) {
+        return HAL_ERROR;
+    }
+
+    *conf = cache;
+    return HAL_OK;
+}
+
+/**
+ * @brief Write a configuration unless the VESC already holds it
+ */
+HAL_StatusTypeDef VescConfig_Write(const mc_configuration* conf)
+{
+    uint8_t wire[CONF_CODEC_MCCONF_MAX_SIZE];
+    int32_t length;
+
+    if (!stats.valid) {
+        return HAL_ERROR;
+    }
+    if (write_pending) {
+        return HAL_BUSY;
+    }
+
+    // Compare encodings, fields that do not go on the wire cannot differ
+    length = ConfCodec_EncodeMcconf(conf, wire);
+    if (length == cache_wire_len && memcmp(wire, cache_wire, length) == 0) {
+        stats.writes_skipped++;
+        return HAL_OK;
+    }
+
+    stats.changed_fields = ConfCodec_DiffMcconf(conf, &cache);
+    stats.writes++;
+    bldc_interface_set_mcconf(conf);
+
+    // The cache follows once the VESC confirms
+    written = *conf;
+    memcpy(written_wire, wire, length);
+    written_wire_len = length;
+    write_pending = 1;
+    write_tick = HAL_GetTick();
+    return HAL_OK;
+}
+
+/**
+ * @brief Queue field changes for VescConfig_Task to write
+ */
+HAL_StatusTypeDef VescConfig_RequestFields(const uint8_t* fields, uint32_t length)
+{
+    if (length == 0 || length > VESC_CONFIG_MAX_REQUEST) {
+        return HAL_ERROR;
+    }
+    if (request_length != 0) {
+        return HAL_BUSY;
+    }
+
+    memcpy(request, fields, length);
+    request_length = length;
+    return HAL_OK;
+}
+
+/**
+ * @brief Copy the cache statistics
+ */
+void VescConfig_GetStats(VescConfig_Stats_t* out)
+{
+    *out = stats;
+}
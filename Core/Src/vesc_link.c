@@ -0,0 +1,191 @@
+/**
+ * @file vesc_link.c
+ * @brief Implementation of the USART2 baud rate negotiation
+ */
+
+#include "vesc_link.h"
+#include "bldc_interface.h"
+#include "bldc_interface_uart.h"
+
+/* Private variables */
+static volatile VescLink_State_t state = VESC_LINK_FAILED;
+static volatile uint32_t target_baud = VESC_LINK_DEFAULT_BAUD;
+static volatile uint8_t restart_pending = 0;    // Set by VescLink_SetBaud
+static volatile uint8_t fw_received = 0;        // Firmware version reply seen
+static volatile uint8_t fw_conf_known = 0;      // Its app configuration layout is decoded
+static volatile uint8_t conf_received = 0;      // App configuration reply seen
+static app_configuration conf;                  // Copy of the VESC app configuration
+static uint32_t state_tick = 0;                 // HAL tick when the current step started
+static uint32_t attempts = 0;                   // Probes since the negotiation started
+
+/* Private function prototypes */
+static void VescLink_OnFwVersion(int major, int minor);
+static void VescLink_OnAppconf(app_configuration* appconf);
+static void VescLink_Probe(uint32_t baud);
+static void VescLink_Restart(void);
+
+/**
+ * @brief bldc_interface firmware version callback
+ */
+static void VescLink_OnFwVersion(int major, int minor)
+{
+    // bldc_interface reports -1 for a reply it cannot decode
+    if (major < 0 || minor < 0) {
+        return;
+    }
+    fw_conf_known = (major == VESC_LINK_CONF_FW_MAJOR &&
+                     minor >= VESC_LINK_CONF_FW_MINOR_MIN &&
+                     minor <= VESC_LINK_CONF_FW_MINOR_MAX);
+    fw_received = 1;
+}
+
+/**
+ * @brief bldc_interface app configuration callback
+ */
+static void VescLink_OnAppconf(app_configuration* appconf)
+{
+    conf = *appconf;
+    conf_received = 1;
+}
+
+/**
+ * @brief Switch USART2 to baud and ask for the firmware version
+ */
+static void VescLink_Probe(uint32_t baud)
+{
+    if (bldc_interface_uart_get_baud() != baud) {
+        bldc_interface_uart_set_baud(baud);
+    }
+    fw_received = 0;
+    attempts++;
+    state_tick = HAL_GetTick();
+    bldc_interface_get_fw_version();
+}
+
+/**
+ * @brief Start looking for the VESC at the target rate
+ */
+static void VescLink_Restart(void)
+{
+    attempts = 0;
+    state = VESC_LINK_PROBE;
+    VescLink_Probe(target_baud);
+}
+
+/**
+ * @brief Register the reply callbacks with bldc_interface and start the negotiation
+ */
+HAL_StatusTypeDef VescLink_Init(uint32_t baud)
+{
+    bldc_interface_set_rx_fw_func(VescLink_OnFwVersion);
+    bldc_interface_set_rx_appconf_func(VescLink_OnAppconf);
+    return VescLink_SetBaud(baud);
+}
+
+/**
+ * @brief Request a new target baud rate, the negotiation starts over
+ */
+HAL_StatusTypeDef VescLink_SetBaud(uint32_t baud)
+{
+    if (baud < VESC_LINK_MIN_BAUD || baud > VESC_LINK_MAX_BAUD) {
+        return HAL_ERROR;
+    }
+
+    target_baud = baud;
+    restart_pending = 1;
+    return HAL_OK;
+}
+
+/**
+ * @brief Advance the negotiation
+ */
+void VescLink_Task(void)
+{
+    uint32_t elapsed = HAL_GetTick() - state_tick;
+
+    // Only the main loop touches the UART, the request just sets a flag
+    if (restart_pending) {
+        restart_pending = 0;
+        VescLink_Restart();
+        return;
+    }
+
+    switch (state) {
+    case VESC_LINK_PROBE:
+        if (fw_received) {
+            if (bldc_interface_uart_get_baud() == target_baud) {
+                state = VESC_LINK_READY;
+            } else if (!fw_conf_known) {
+                // Writing back a configuration decoded with the wrong
+                // layout would corrupt it, stay at the boot rate
+                state = VESC_LINK_READY;
+            } else {
+                // Found at the boot rate, move the VESC over
+                conf_received = 0;
+                state_tick = HAL_GetTick();
+                state = VESC_LINK_GET_CONF;
+                bldc_interface_get_appconf();
+            }
+        } else if (elapsed >= VESC_LINK_REPLY_TIMEOUT_MS) {
+            if (attempts >= VESC_LINK_MAX_ATTEMPTS) {
+                bldc_interface_uart_set_baud(VESC_LINK_BOOT_BAUD);
+                state = VESC_LINK_FAILED;
+            } else {
+                // Alternate between the target and the boot rate
+                VescLink_Probe((bldc_interface_uart_get_baud() == target_baud) ?
+                               VESC_LINK_BOOT_BAUD : target_baud);
+            }
+        }
+        break;
+
+    case VESC_LINK_GET_CONF:
+        if (conf_received) {
+            conf.app_uart_baudrate = target_baud;
+            bldc_interface_set_appconf(&conf);
+            state_tick = HAL_GetTick();
+            state = VESC_LINK_SWITCH;
+        } else if (elapsed >= VESC_LINK_REPLY_TIMEOUT_MS) {
+            state = VESC_LINK_PROBE;
+            VescLink_Probe(target_baud);
+        }
+        break;
+
+    case VESC_LINK_SWITCH:
+        // The configuration must leave at the old rate before USART2 changes
+        if (elapsed >= VESC_LINK_SETTLE_MS && bldc_interface_uart_tx_idle()) {
+            state = VESC_LINK_VERIFY;
+            VescLink_Probe(target_baud);
+        }
+        break;
+
+    case VESC_LINK_VERIFY:
+        if (fw_received) {
+            state = VESC_LINK_READY;
+        } else if (elapsed >= VESC_LINK_REPLY_TIMEOUT_MS) {
+            state = VESC_LINK_PROBE;
+            VescLink_Probe(VESC_LINK_BOOT_BAUD);
+        }
+        break;
+
+    case VESC_LINK_READY:
+    case VESC_LINK_FAILED:
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Get the negotiation state
+ */
+VescLink_State_t VescLink_GetState(void)
+{
+    return state;
+}
+
+/**
+ * @brief Check whether requests can be sent
+ */
+uint8_t VescLink_IsReady(void)
+{
+    return state == VESC_LINK_READY;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file vesc_telemetry.c
+ * @brief Implementation of the VESC motor value poller
+ */
+
+#include "vesc_telemetry.h"
+#include "bldc_interface.h"
+#include "timestamp.h"
+#include "memory_map.h"
+
+/* Private variables */
+static VescTelemetry_Values_t latest[2];        // Double buffered, readers take latest_index
+static volatile uint8_t latest_index = 0;
+static uint32_t reply_count = 0;
+static volatile uint32_t poll_period_us = 0;    // 0 when polling is stopped
+static uint32_t last_request_us = 0;            // Polling schedule
+static uint32_t request_sent_us = 0;            // Time the pending request went out
+static uint8_t request_pending = 0;             // Sent and not answered yet
+static VescTelemetry_Stats_t stats;
+
+/* Private function prototypes */
+static void VescTelemetry_OnValues(mc_values* values);
+
+/**
+ * @brief bldc_interface value callback, runs in the main loop from the UART receive path
+ */
+static void VescTelemetry_OnValues(mc_values* values)
+{
+    uint32_t now_us = Timestamp_Now();
+    uint8_t next = latest_index ^ 1;
+    VescTelemetry_Values_t* slot = &latest[next];
+
+    slot->v_in = values->v_in;
+    slot->current_motor = values->current_motor;
+    slot->current_in = values->current_in;
+    slot->duty_now = values->duty_now;
+    slot->temp_mos = values->temp_mos;
+    slot->temp_motor = values->temp_motor;
+    slot->time_us = now_us;
+    slot->count = ++reply_count;
+
+    // Publish the complete set at once, like the ADC snapshot
+    __DMB();
+    latest_index = next;
+
+    stats.replies++;
+    if (request_pending) {
+        request_pending = 0;
+        stats.last_latency_us = now_us - request_sent_us;
+        if (stats.last_latency_us > stats.max_latency_us) {
+            stats.max_latency_us = stats.last_latency_us;
+        }
+    }
+}
+
+/**
+ * @brief Register the value callback with bldc_interface and start polling at the default rate
+ */
+HAL_StatusTypeDef VescTelemetry_Init(void)
+{
+    bldc_interface_set_rx_value_func(VescTelemetry_OnValues);
+    request_pending = 0;
+    last_request_us = Timestamp_Now();
+    return VescTelemetry_SetRate(VESC_TELEMETRY_DEFAULT_RATE_HZ);
+}
+
+/**
+ * @brief Set the polling rate
+ */
+HAL_StatusTypeDef VescTelemetry_SetRate(uint32_t rate_hz)
+{
+    if (rate_hz > VESC_TELEMETRY_MAX_RATE_HZ) {
+        return HAL_ERROR;
+    }
+
+    poll_period_us = (rate_hz == 0) ? 0 : 1000000 / rate_hz;
+    return HAL_OK;
+}
+
+/**
+ * @brief Get the polling rate
+ */
+uint32_t VescTelemetry_GetRate(void)
+{
+    uint32_t period_us = poll_period_us;
+    return (period_us == 0) ? 0 : 1000000 / period_us;
+}
+
+/**
+ * @brief Send the next request when it is due
+ */
+void VescTelemetry_Task(void)
+{
+    uint32_t period_us = poll_period_us;
+    uint32_t now_us = Timestamp_Now();
+
+    if (period_us == 0 || now_us - last_request_us < period_us) {
+        return;
+    }
+
+    // A lost reply must not stall polling, count it and ask again
+    if (request_pending) {
+        stats.timeouts++;
+    }
+
+    // Keep the schedule on its grid unless we fell more than a period behind
+    last_request_us += period_us;
+    if (now_us - last_request_us >= period_us) {
+        last_request_us = now_us;
+    }
+
+    request_pending = 1;
+    request_sent_us = now_us;
+    stats.requests++;
+    bldc_interface_get_values();
+}
+
+/**
+ * @brief Copy the latest values
+ */
+ITCM_CODE void VescTelemetry_GetLatest(VescTelemetry_Values_t* values)
+{
+    *values = latest[latest_index];
+}
+
+/**
+ * @brief Copy the polling statistics
+ */
+void VescTelemetry_GetStats(VescTelemetry_Stats_t* out)
+{
+    *out = stats;
+}
@@ -8,52 +8,88 @@ C_SRCS += \
 ../Core/Src/bldc_interface.c \
 ../Core/Src/bldc_interface_uart.c \
 ../Core/Src/buffer.c \
+../Core/Src/conf_codec.c \
 ../Core/Src/controller.c \
 ../Core/Src/crc.c \
 ../Core/Src/data_acquisition.c \
 ../Core/Src/main.c \
+../Core/Src/memory_map.c \
+../Core/Src/motor_command.c \
 ../Core/Src/motor_speed.c \
 ../Core/Src/packet.c \
+../Core/Src/sample_codec.c \
+../Core/Src/sample_pack.c \
+../Core/Src/sample_ring.c \
+../Core/Src/setpoint.c \
 ../Core/Src/stm32f7xx_hal_msp.c \
 ../Core/Src/stm32f7xx_it.c \
 ../Core/Src/syscalls.c \
 ../Core/Src/sysmem.c \
 ../Core/Src/system_stm32f7xx.c \
-../Core/Src/usb_comm.c 
+../Core/Src/timestamp.c \
+../Core/Src/trajectory.c \
+../Core/Src/usb_comm.c \
+../Core/Src/vesc_config.c \
+../Core/Src/vesc_link.c \
+../Core/Src/vesc_telemetry.c 
 
 OBJS += \
 ./Core/Src/bldc_interface.o \
 ./Core/Src/bldc_interface_uart.o \
 ./Core/Src/buffer.o \
+./Core/Src/conf_codec.o \
 ./Core/Src/controller.o \
 ./Core/Src/crc.o \
 ./Core/Src/data_acquisition.o \
 ./Core/Src/main.o \
+./Core/Src/memory_map.o \
+./Core/Src/motor_command.o \
 ./Core/Src/motor_speed.o \
 ./Core/Src/packet.o \
+./Core/Src/sample_codec.o \
+./Core/Src/sample_pack.o \
+./Core/Src/sample_ring.o \
+./Core/Src/setpoint.o \
 ./Core/Src/stm32f7xx_hal_msp.o \
 ./Core/Src/stm32f7xx_it.o \
 ./Core/Src/syscalls.o \
 ./Core/Src/sysmem.o \
 ./Core/Src/system_stm32f7xx.o \
-./Core/Src/usb_comm.o 
+./Core/Src/timestamp.o \
+./Core/Src/trajectory.o \
+./Core/Src/usb_comm.o \
+./Core/Src/vesc_config.o \
+./Core/Src/vesc_link.o \
+./Core/Src/vesc_telemetry.o 
 
 C_DEPS += \
 ./Core/Src/bldc_interface.d \
 ./Core/Src/bldc_interface_uart.d \
 ./Core/Src/buffer.d \
+./Core/Src/conf_codec.d \
 ./Core/Src/controller.d \
 ./Core/Src/crc.d \
 ./Core/Src/data_acquisition.d \
 ./Core/Src/main.d \
+./Core/Src/memory_map.d \
+./Core/Src/motor_command.d \
 ./Core/Src/motor_speed.d \
 ./Core/Src/packet.d \
+./Core/Src/sample_codec.d \
+./Core/Src/sample_pack.d \
+./Core/Src/sample_ring.d \
+./Core/Src/setpoint.d \
 ./Core/Src/stm32f7xx_hal_msp.d \
 ./Core/Src/stm32f7xx_it.d \
 ./Core/Src/syscalls.d \
 ./Core/Src/sysmem.d \
 ./Core/Src/system_stm32f7xx.d \
-./Core/Src/usb_comm.d 
+./Core/Src/timestamp.d \
+./Core/Src/trajectory.d \
+./Core/Src/usb_comm.d \
+./Core/Src/vesc_config.d \
+./Core/Src/vesc_link.d \
+./Core/Src/vesc_telemetry.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes
@@ -63,7 +99,7 @@ Core/Src/%.o Core/Src/%.su Core/Src/%.cyclo: ../Core/Src/%.c Core/Src/subdir.mk
 clean: clean-Core-2f-Src
 
 clean-Core-2f-Src:
-	-$(RM) ./Core/Src/bldc_interface.cyclo ./Core/Src/bldc_interface.d ./Core/Src/bldc_interface.o ./Core/Src/bldc_interface.su ./Core/Src/bldc_interface_uart.cyclo ./Core/Src/bldc_interface_uart.d ./Core/Src/bldc_interface_uart.o ./Core/Src/bldc_interface_uart.su ./Core/Src/buffer.cyclo ./Core/Src/buffer.d ./Core/Src/buffer.o ./Core/Src/buffer.su ./Core/Src/controller.cyclo ./Core/Src/controller.d ./Core/Src/controller.o ./Core/Src/controller.su ./Core/Src/crc.cyclo ./Core/Src/crc.d ./Core/Src/crc.o ./Core/Src/crc.su ./Core/Src/data_acquisition.cyclo ./Core/Src/data_acquisition.d ./Core/Src/data_acquisition.o ./Core/Src/data_acquisition.su ./Core/Src/main.cyclo ./Core/Src/main.d ./Core/Src/main.o ./Core/Src/main.su ./Core/Src/motor_speed.cyclo ./Core/Src/motor_speed.d ./Core/Src/motor_speed.o ./Core/Src/motor_speed.su ./Core/Src/packet.cyclo ./Core/Src/packet.d ./Core/Src/packet.o ./Core/Src/packet.su ./Core/Src/stm32f7xx_hal_msp.cyclo ./Core/Src/stm32f7xx_hal_msp.d ./Core/Src/stm32f7xx_hal_msp.o ./Core/Src/stm32f7xx_hal_msp.su ./Core/Src/stm32f7xx_it.cyclo ./Core/Src/stm32f7xx_it.d ./Core/Src/stm32f7xx_it.o ./Core/Src/stm32f7xx_it.su ./Core/Src/syscalls.cyclo ./Core/Src/syscalls.d ./Core/Src/syscalls.o ./Core/Src/syscalls.su ./Core/Src/sysmem.cyclo ./Core/Src/sysmem.d ./Core/Src/sysmem.o ./Core/Src/sysmem.su ./Core/Src/system_stm32f7xx.cyclo ./Core/Src/system_stm32f7xx.d ./Core/Src/system_stm32f7xx.o ./Core/Src/system_stm32f7xx.su ./Core/Src/usb_comm.cyclo ./Core/Src/usb_comm.d ./Core/Src/usb_comm.o ./Core/Src/usb_comm.su
+	-$(RM) ./Core/Src/bldc_interface.cyclo ./Core/Src/bldc_interface.d ./Core/Src/bldc_interface.o ./Core/Src/bldc_interface.su ./Core/Src/bldc_interface_uart.cyclo ./Core/Src/bldc_interface_uart.d ./Core/Src/bldc_interface_uart.o ./Core/Src/bldc_interface_uart.su ./Core/Src/buffer.cyclo ./Core/Src/buffer.d ./Core/Src/buffer.o ./Core/Src/buffer.su ./Core/Src/conf_codec.cyclo ./Core/Src/conf_codec.d ./Core/Src/conf_codec.o ./Core/Src/conf_codec.su ./Core/Src/controller.cyclo ./Core/Src/controller.d ./Core/Src/controller.o ./Core/Src/controller.su ./Core/Src/crc.cyclo ./Core/Src/crc.d ./Core/Src/crc.o ./Core/Src/crc.su ./Core/Src/data_acquisition.cyclo ./Core/Src/data_acquisition.d ./Core/Src/data_acquisition.o ./Core/Src/data_acquisition.su ./Core/Src/main.cyclo ./Core/Src/main.d ./Core/Src/main.o ./Core/Src/main.su ./Core/Src/memory_map.cyclo ./Core/Src/memory_map.d ./Core/Src/memory_map.o ./Core/Src/memory_map.su ./Core/Src/motor_command.cyclo ./Core/Src/motor_command.d ./Core/Src/motor_command.o ./Core/Src/motor_command.su ./Core/Src/motor_speed.cyclo ./Core/Src/motor_speed.d ./Core/Src/motor_speed.o ./Core/Src/motor_speed.su ./Core/Src/packet.cyclo ./Core/Src/packet.d ./Core/Src/packet.o ./Core/Src/packet.su ./Core/Src/sample_codec.cyclo ./Core/Src/sample_codec.d ./Core/Src/sample_codec.o ./Core/Src/sample_codec.su ./Core/Src/sample_pack.cyclo ./Core/Src/sample_pack.d ./Core/Src/sample_pack.o ./Core/Src/sample_pack.su ./Core/Src/sample_ring.cyclo ./Core/Src/sample_ring.d ./Core/Src/sample_ring.o ./Core/Src/sample_ring.su ./Core/Src/setpoint.cyclo ./Core/Src/setpoint.d ./Core/Src/setpoint.o ./Core/Src/setpoint.su ./Core/Src/stm32f7xx_hal_msp.cyclo ./Core/Src/stm32f7xx_hal_msp.d ./Core/Src/stm32f7xx_hal_msp.o ./Core/Src/stm32f7xx_hal_msp.su ./Core/Src/stm32f7xx_it.cyclo ./Core/Src/stm32f7xx_it.d ./Core/Src/stm32f7xx_it.o ./Core/Src/stm32f7xx_it.su ./Core/Src/syscalls.cyclo ./Core/Src/syscalls.d ./Core/Src/syscalls.o ./Core/Src/syscalls.su ./Core/Src/sysmem.cyclo ./Core/Src/sysmem.d ./Core/Src/sysmem.o ./Core/Src/sysmem.su ./Core/Src/system_stm32f7xx.cyclo ./Core/Src/system_stm32f7xx.d ./Core/Src/system_stm32f7xx.o ./Core/Src/system_stm32f7xx.su ./Core/Src/timestamp.cyclo ./Core/Src/timestamp.d ./Core/Src/timestamp.o ./Core/Src/timestamp.su ./Core/Src/trajectory.cyclo ./Core/Src/trajectory.d ./Core/Src/trajectory.o ./Core/Src/trajectory.su ./Core/Src/usb_comm.cyclo ./Core/Src/usb_comm.d ./Core/Src/usb_comm.o ./Core/Src/usb_comm.su ./Core/Src/vesc_config.cyclo ./Core/Src/vesc_config.d ./Core/Src/vesc_config.o ./Core/Src/vesc_config.su ./Core/Src/vesc_link.cyclo ./Core/Src/vesc_link.d ./Core/Src/vesc_link.o ./Core/Src/vesc_link.su ./Core/Src/vesc_telemetry.cyclo ./Core/Src/vesc_telemetry.d ./Core/Src/vesc_telemetry.o ./Core/Src/vesc_telemetry.su
 
 .PHONY: clean-Core-2f-Src
 
@@ -0,0 +1,234 @@
+/**
+ * @file eds_columns.c
+ * @brief Implementation of the columnar session writer
+ */
+
+#include "eds_columns.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define EDS_COLUMNS_FILE_BUFFER  (256 * 1024)
+
+_Static_assert(sizeof(EdsChunkIndex_t) == 40, "index entries are read as 40 byte records");
+
+/* Private function prototypes */
+static FILE* EdsColumns_Create(const EdsColumns_t* columns, const char* name, const char* suffix);
+static int EdsColumns_OpenColumn(const EdsColumns_t* columns, EdsColumn_t* column,
+                                 const char* name, const char* value_suffix);
+static void EdsColumns_Put32(FILE* file, uint32_t value);
+static void EdsColumns_Push(EdsColumn_t* column, uint64_t time_us, uint32_t time, int32_t value);
+static void EdsColumns_FlushChunk(EdsColumn_t* column);
+static int EdsColumns_CloseColumn(EdsColumn_t* column);
+
+/**
+ * @brief Open one file in the session directory with a large buffer
+ */
+static FILE* EdsColumns_Create(const EdsColumns_t* columns, const char* name, const char* suffix)
+{
+    char path[sizeof(columns->directory) + 64];
+    FILE* file;
+
+    snprintf(path, sizeof(path), "%s/%s%s", columns->directory, name, suffix);
+    file = fopen(path, "wb");
+    if (file != NULL) {
+        setvbuf(file, NULL, _IOFBF, EDS_COLUMNS_FILE_BUFFER);
+    }
+    return file;
+}
+
+static int EdsColumns_OpenColumn(const EdsColumns_t* columns, EdsColumn_t* column,
+                                 const char* name, const char* value_suffix)
+{
+    memset(column, 0, sizeof(*column));
+    column->time = EdsColumns_Create(columns, name, ".t.u32");
+    column->value = EdsColumns_Create(columns, name, value_suffix);
+    column->index = EdsColumns_Create(columns, name, ".idx");
+    return (column->time != NULL && column->value != NULL && column->index != NULL) ? 0 : -1;
+}
+
+static void EdsColumns_Put32(FILE* file, uint32_t value)
+{
+    uint8_t bytes[4] = {
+        (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)
+    };
+    fwrite(bytes, 1, sizeof(bytes), file);
+}
+
+/**
+ * @brief Write the index entry of the chunk being filled and start the next one
+ */
+static void EdsColumns_FlushChunk(EdsColumn_t* column)
+{
+    if (column->chunk.count == 0) {
+        return;
+    }
+    // Index entries are written as laid out in memory, little-endian hosts only
+    fwrite(&column->chunk, sizeof(column->chunk), 1, column->index);
+    memset(&column->chunk, 0, sizeof(column->chunk));
+}
+
+/**
+ * @brief Append one sample to a column and update its chunk summary
+ */
+static void EdsColumns_Push(EdsColumn_t* column, uint64_t time_us, uint32_t time, int32_t value)
+{
+    EdsChunkIndex_t* chunk = &column->chunk;
+
+    EdsColumns_Put32(column->time, time);
+    EdsColumns_Put32(column->value, (uint32_t)value);
+
+    if (chunk->count == 0) {
+        chunk->first_sample = column->samples;
+        chunk->t_first_us = time_us;
+        chunk->min = value;
+        chunk->max = value;
+    } else if (value < chunk->min) {
+        chunk->min = value;
+    } else if (value > chunk->max) {
+        chunk->max = value;
+    }
+    chunk->t_last_us = time_us;
+    chunk->count++;
+    column->samples++;
+
+    if (chunk->count == EDS_COLUMNS_CHUNK_SAMPLES) {
+        EdsColumns_FlushChunk(column);
+    }
+}
+
+static int EdsColumns_CloseColumn(EdsColumn_t* column)
+{
+    int result = 0;
+
+    if (column->index != NULL) {
+        EdsColumns_FlushChunk(column);
+    }
+    FILE* files[] = { column->time, column->value, column->index };
+    for (uint32_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        if (files[i] != NULL && fclose(files[i]) != 0) {
+            result = -1;
+        }
+    }
+    memset(column, 0, sizeof(*column));
+    return result;
+}
+
+/**
+ * @brief Create the output directory and the record column
+ */
+int EdsColumns_Open(EdsColumns_t* columns, const char* directory)
+{
+    memset(columns, 0, sizeof(*columns));
+    if (strlen(directory) >= sizeof(columns->directory)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(columns->directory, directory);
+
+    if (mkdir(directory, 0777) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    return EdsColumns_OpenColumn(columns, &columns->records, "records", ".u32");
+}
+
+/**
+ * @brief Adopt a descriptor, opens the channel columns on the first one
+ */
+int EdsColumns_SetDescriptor(EdsColumns_t* columns, const EdsDescriptor_t* descriptor)
+{
+    // Rates may change during a session, the names and kinds cannot
+    uint8_t first = !columns->descriptor.valid;
+    columns->descriptor = *descriptor;
+    if (!first) {
+        return 0;
+    }
+
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+        if (EdsColumns_OpenColumn(columns, &columns->channel[ch], descriptor->name[ch], ".i32") != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Append records
+ */
+void EdsColumns_Append(EdsColumns_t* columns, const SampleRecord_t* records, uint32_t count)
+{
+    // Channel files only exist once the descriptor named them
+    if (!columns->descriptor.valid) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        const SampleRecord_t* record = &records[i];
+
+        // TIM5 wraps every 2^32 us, records arrive in order so the step is always forward
+        if (columns->records.samples == 0) {
+            columns->time_us = record->time_us;
+        } else {
+            columns->time_us += (uint32_t)(record->time_us - columns->last_time);
+        }
+        columns->last_time = record->time_us;
+
+        EdsColumns_Push(&columns->records, columns->time_us, record->time_us, (int32_t)record->counter);
+        for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+            if (record->mask & (1UL << ch)) {
+                EdsColumns_Push(&columns->channel[ch], columns->time_us, record->time_us,
+                                (int32_t)record->value[ch]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Index the last partial chunks, close every column and write meta.txt
+ */
+int EdsColumns_Close(EdsColumns_t* columns, const EdsStreamStats_t* stats)
+{
+    const EdsDescriptor_t* desc = &columns->descriptor;
+    uint64_t records = columns->records.samples;
+    int result = 0;
+    FILE* meta;
+
+    if (EdsColumns_CloseColumn(&columns->records) != 0) {
+        result = -1;
+    }
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+        if (EdsColumns_CloseColumn(&columns->channel[ch]) != 0) {
+            result = -1;
+        }
+    }
+
+    meta = EdsColumns_Create(columns, "meta", ".txt");
+    if (meta == NULL) {
+        return -1;
+    }
+    fprintf(meta, "format = eds_columns %d\n", EDS_COLUMNS_FORMAT);
+    fprintf(meta, "frame_version = %d\n", USB_FRAME_VERSION);
+    fprintf(meta, "chunk_samples = %d\n", EDS_COLUMNS_CHUNK_SAMPLES);
+    fprintf(meta, "fixed_frac_bits = %d\n", DATAACQ_FIXED_FRAC_BITS);
+    fprintf(meta, "records = %llu\n", (unsigned long long)records);
+    fprintf(meta, "base_rate = %u\n", (unsigned)desc->base_rate);
+    fprintf(meta, "channels = %d\n", desc->valid ? DATAACQ_NUM_CHANNELS : 0);
+    for (uint32_t ch = 0; desc->valid && ch < DATAACQ_NUM_CHANNELS; ch++) {
+        fprintf(meta, "channel%u = %s %u %u\n", (unsigned)ch, desc->name[ch],
+                (unsigned)desc->kind[ch], (unsigned)desc->divider[ch]);
+    }
+    if (stats != NULL) {
+        fprintf(meta, "bytes = %llu\n", (unsigned long long)stats->bytes);
+        fprintf(meta, "frames = %llu\n", (unsigned long long)stats->frames);
+        fprintf(meta, "frames_lost = %llu\n", (unsigned long long)stats->frames_lost);
+        fprintf(meta, "bad_frames = %llu\n", (unsigned long long)stats->bad_frames);
+        fprintf(meta, "skipped_bytes = %llu\n", (unsigned long long)stats->skipped_bytes);
+        fprintf(meta, "samples = %llu\n", (unsigned long long)stats->samples);
+        fprintf(meta, "samples_lost = %llu\n", (unsigned long long)stats->samples_lost);
+    }
+    if (fclose(meta) != 0) {
+        result = -1;
+    }
+
+    return result;
+}
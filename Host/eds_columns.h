@@ -0,0 +1,91 @@
+/**
+ * @file eds_columns.h
+ * @brief Columnar on-disk log of decoded records
+ *
+ * A session is written to one directory. Every column has three files:
+ *   <name>.t.u32                 time_us of every sample
+ *   <name>.i32 (records.u32)     value of every sample (record counter)
+ *   <name>.idx                   one EdsChunkIndex_t per EDS_COLUMNS_CHUNK_SAMPLES
+ * "records" holds one entry per record, the channel columns only the ticks
+ * on which that channel was sampled. meta.txt holds the descriptor and the
+ * decoder statistics as key = value lines.
+ *
+ * All files are little-endian. Values are stored as sent by the device:
+ * ADC counts, fixed-point with DATAACQ_FIXED_FRAC_BITS fraction bits,
+ * thousandths, or microseconds, as given by the kind in meta.txt. The 32-bit times wrap
+ * after 71 minutes, the index carries the unwrapped 64-bit times, so a
+ * reader maps only the chunks that overlap a time range and unwraps from
+ * the chunk start. Columns grow by appending, memory use does not depend
+ * on the session length.
+ */
+
+#ifndef EDS_COLUMNS_H
+#define EDS_COLUMNS_H
+
+#include <stdio.h>
+#include "eds_stream.h"
+
+#define EDS_COLUMNS_FORMAT          2
+#define EDS_COLUMNS_CHUNK_SAMPLES   4096    // Samples summarised by one index entry
+
+/* Index entry, little-endian, 40 bytes */
+typedef struct {
+    uint64_t first_sample;  // Position of the chunk in the column, in samples
+    uint64_t t_first_us;    // Unwrapped time of the first sample
+    uint64_t t_last_us;     // Unwrapped time of the last sample
+    uint32_t count;         // Samples in the chunk
+    int32_t min;            // Smallest raw value
+    int32_t max;            // Largest raw value
+    uint32_t reserved;
+} EdsChunkIndex_t;
+
+typedef struct {
+    FILE* time;
+    FILE* value;
+    FILE* index;
+    uint64_t samples;       // Samples written so far
+    EdsChunkIndex_t chunk;  // Chunk being filled
+} EdsColumn_t;
+
+typedef struct {
+    char directory[512];
+    EdsColumn_t records;
+    EdsColumn_t channel[DATAACQ_NUM_CHANNELS];
+    EdsDescriptor_t descriptor;
+    uint64_t time_us;       // Unwrapped time of the last record
+    uint32_t last_time;     // Its 32-bit device time
+} EdsColumns_t;
+
+/**
+ * @brief Create the output directory and the record column
+ * @param columns Writer state
+ * @param directory Output directory, created if missing
+ * @return 0 on success, -1 with errno set
+ */
+int EdsColumns_Open(EdsColumns_t* columns, const char* directory);
+
+/**
+ * @brief Adopt a descriptor, opens the channel columns on the first one
+ * @param columns Writer state
+ * @param descriptor Stream descriptor
+ * @return 0 on success, -1 with errno set
+ */
+int EdsColumns_SetDescriptor(EdsColumns_t* columns, const EdsDescriptor_t* descriptor);
+
+/**
+ * @brief Append records
+ * @param columns Writer state
+ * @param records Decoded records
+ * @param count Number of records
+ */
+void EdsColumns_Append(EdsColumns_t* columns, const SampleRecord_t* records, uint32_t count);
+
+/**
+ * @brief Index the last partial chunks, close every column and write meta.txt
+ * @param columns Writer state
+ * @param stats Decoder statistics to record
+ * @return 0 on success, -1 with errno set
+ */
+int EdsColumns_Close(EdsColumns_t* columns, const EdsStreamStats_t* stats);
+
+#endif /* EDS_COLUMNS_H */
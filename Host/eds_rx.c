@@ -0,0 +1,240 @@
+/**
+ * @file eds_rx.c
+ * @brief Command line receiver: reads the logger CDC port and writes columns
+ *
+ * Usage:
+ *   eds_rx -d /dev/ttyACM0 -o session [-e raw|compact|packed] [-r rate_hz]
+ *          [-t seconds] [-w capture.bin]
+ *   eds_rx -i capture.bin -o session
+ *
+ * The receiver sends 'S' on start and 'T' on exit (Ctrl+C or -t), and
+ * prints the decode rate and losses once per second. -w keeps a copy of the
+ * raw stream, -i decodes such a copy offline.
+ */
+
+#include "eds_stream.h"
+#include "eds_columns.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define EDS_RX_READ_SIZE    (64 * 1024)
+
+/* Private variables */
+static volatile sig_atomic_t stop_requested = 0;
+static EdsStream_t stream;
+static EdsColumns_t columns;
+
+/* Private function prototypes */
+static void EdsRx_OnSignal(int signal_number);
+static void EdsRx_OnDescriptor(void* context, const EdsDescriptor_t* descriptor);
+static void EdsRx_OnRecords(void* context, const SampleRecord_t* records, uint32_t count);
+static int EdsRx_OpenPort(const char* device);
+static int EdsRx_Send(int fd, const uint8_t* command, size_t length);
+static double EdsRx_Now(void);
+static void EdsRx_Usage(const char* program);
+
+static void EdsRx_OnSignal(int signal_number)
+{
+    (void)signal_number;
+    stop_requested = 1;
+}
+
+static void EdsRx_OnDescriptor(void* context, const EdsDescriptor_t* descriptor)
+{
+    if (EdsColumns_SetDescriptor((EdsColumns_t*)context, descriptor) != 0) {
+        perror("eds_rx: channel columns");
+        stop_requested = 1;
+    }
+}
+
+static void EdsRx_OnRecords(void* context, const SampleRecord_t* records, uint32_t count)
+{
+    EdsColumns_Append((EdsColumns_t*)context, records, count);
+}
+
+/**
+ * @brief Open the CDC tty in raw mode, the baud rate is ignored by CDC
+ */
+static int EdsRx_OpenPort(const char* device)
+{
+    struct termios tio;
+    int fd = open(device, O_RDWR | O_NOCTTY);
+
+    if (fd < 0) {
+        return -1;
+    }
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tio.c_cc[VMIN] = 0;
+        tio.c_cc[VTIME] = 1;    // Return at least every 100 ms so signals and -t are seen
+        tcsetattr(fd, TCSANOW, &tio);
+        tcflush(fd, TCIFLUSH);
+    }
+    return fd;
+}
+
+static int EdsRx_Send(int fd, const uint8_t* command, size_t length)
+{
+    return (write(fd, command, length) == (ssize_t)length) ? 0 : -1;
+}
+
+static double EdsRx_Now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void EdsRx_Usage(const char* program)
+{
+    fprintf(stderr,
+            "usage: %s -d device -o dir [-e raw|compact|packed] [-r rate_hz] [-t seconds] [-w capture]\n"
+            "       %s -i capture -o dir\n", program, program);
+}
+
+int main(int argc, char** argv)
+{
+    static uint8_t chunk[EDS_RX_READ_SIZE];
+    const char* device = NULL;
+    const char* input = NULL;
+    const char* output = NULL;
+    const char* capture_path = NULL;
+    int encoding = USB_ENCODING_COMPACT;
+    uint32_t rate_hz = 0;
+    double duration = 0.0;
+    FILE* capture = NULL;
+    int fd;
+    int option;
+
+    while ((option = getopt(argc, argv, "d:i:o:e:r:t:w:")) != -1) {
+        switch (option) {
+            case 'd': device = optarg; break;
+            case 'i': input = optarg; break;
+            case 'o': output = optarg; break;
+            case 'w': capture_path = optarg; break;
+            case 'r': rate_hz = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 't': duration = atof(optarg); break;
+            case 'e':
+                if (strcmp(optarg, "raw") == 0) {
+                    encoding = USB_ENCODING_RAW;
+                } else if (strcmp(optarg, "packed") == 0) {
+                    encoding = USB_ENCODING_PACKED;
+                } else if (strcmp(optarg, "compact") == 0) {
+                    encoding = USB_ENCODING_COMPACT;
+                } else {
+                    EdsRx_Usage(argv[0]);
+                    return 2;
+                }
+                break;
+            default:
+                EdsRx_Usage(argv[0]);
+                return 2;
+        }
+    }
+    if (output == NULL || (device == NULL) == (input == NULL)) {
+        EdsRx_Usage(argv[0]);
+        return 2;
+    }
+
+    fd = (input != NULL) ? open(input, O_RDONLY) : EdsRx_OpenPort(device);
+    if (fd < 0) {
+        perror(input != NULL ? input : device);
+        return 1;
+    }
+    if (EdsColumns_Open(&columns, output) != 0) {
+        perror(output);
+        return 1;
+    }
+    if (capture_path != NULL && (capture = fopen(capture_path, "wb")) == NULL) {
+        perror(capture_path);
+        return 1;
+    }
+
+    EdsStreamHandlers_t handlers = {
+        .on_descriptor = EdsRx_OnDescriptor,
+        .on_records = EdsRx_OnRecords,
+        .context = &columns
+    };
+    EdsStream_Init(&stream, &handlers);
+
+    signal(SIGINT, EdsRx_OnSignal);
+    signal(SIGTERM, EdsRx_OnSignal);
+
+    if (device != NULL) {
+        uint8_t command[5];
+        command[0] = 'E';
+        command[1] = (uint8_t)encoding;
+        EdsRx_Send(fd, command, 2);
+        if (rate_hz != 0) {
+            command[0] = 'F';
+            memcpy(&command[1], &rate_hz, sizeof(rate_hz));  // Little-endian hosts only
+            EdsRx_Send(fd, command, 5);
+        }
+        EdsRx_Send(fd, (const uint8_t*)"S", 1);
+    }
+
+    double start = EdsRx_Now();
+    double last_report = start;
+    uint64_t last_samples = 0;
+    uint64_t last_bytes = 0;
+
+    while (!stop_requested) {
+        ssize_t length = read(fd, chunk, sizeof(chunk));
+        if (length < 0 && errno != EINTR) {
+            perror("read");
+            break;
+        }
+        if (length == 0 && input != NULL) {
+            break;  // End of the capture file
+        }
+        if (length > 0) {
+            if (capture != NULL) {
+                fwrite(chunk, 1, (size_t)length, capture);
+            }
+            EdsStream_Feed(&stream, chunk, (size_t)length);
+        }
+
+        double now = EdsRx_Now();
+        if (device != NULL && now - last_report >= 1.0) {
+            const EdsStreamStats_t* stats = &stream.stats;
+            fprintf(stderr, "%8.0f samples/s %8.0f kB/s  lost: %llu frames %llu samples  bad: %llu\n",
+                    (stats->samples - last_samples) / (now - last_report),
+                    (stats->bytes - last_bytes) / (now - last_report) / 1000.0,
+                    (unsigned long long)stats->frames_lost, (unsigned long long)stats->samples_lost,
+                    (unsigned long long)stats->bad_frames);
+            last_samples = stats->samples;
+            last_bytes = stats->bytes;
+            last_report = now;
+        }
+        if (duration > 0.0 && now - start >= duration) {
+            break;
+        }
+    }
+
+    if (device != NULL) {
+        EdsRx_Send(fd, (const uint8_t*)"T", 1);
+    }
+    close(fd);
+    if (capture != NULL) {
+        fclose(capture);
+    }
+
+    const EdsStreamStats_t* stats = &stream.stats;
+    fprintf(stderr, "%llu samples in %llu frames, lost %llu frames and %llu samples, %llu bad frames\n",
+            (unsigned long long)stats->samples, (unsigned long long)stats->frames,
+            (unsigned long long)stats->frames_lost, (unsigned long long)stats->samples_lost,
+            (unsigned long long)stats->bad_frames);
+
+    if (EdsColumns_Close(&columns, stats) != 0) {
+        perror(output);
+        return 1;
+    }
+    return 0;
+}
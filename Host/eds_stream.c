@@ -0,0 +1,312 @@
+/**
+ * @file eds_stream.c
+ * @brief Implementation of the host side stream decoder
+ */
+
+#include "eds_stream.h"
+#include <string.h>
+
+/* Value kinds the shared decoders look up, firmware defaults until a descriptor arrives */
+#define DATAACQ_ADC_KIND(id, name, channel, port, pin)   DATAACQ_KIND_ADC12,
+#define DATAACQ_DERIVED_KIND(id, name, kind)             DATAACQ_KIND_##kind,
+static uint8_t channel_kinds[DATAACQ_NUM_CHANNELS] = {
+    DATAACQ_ADC_CHANNELS(DATAACQ_ADC_KIND)
+    DATAACQ_DERIVED_CHANNELS(DATAACQ_DERIVED_KIND)
+};
+#undef DATAACQ_ADC_KIND
+#undef DATAACQ_DERIVED_KIND
+
+/* Private function prototypes */
+static uint32_t EdsStream_Get16(const uint8_t* in);
+static uint32_t EdsStream_Get32(const uint8_t* in);
+static size_t EdsStream_FindMagic(const uint8_t* data, size_t length);
+static int EdsStream_DecodeFrame(EdsStream_t* stream, const UsbFrameHeader_t* header, const uint8_t* payload);
+static int EdsStream_DecodeRaw(const uint8_t* payload, uint32_t size, uint32_t count, SampleRecord_t* records);
+static int EdsStream_DecodeCompact(const uint8_t* payload, uint32_t size, uint32_t count, SampleRecord_t* records);
+static int EdsStream_DecodeDescriptor(EdsStream_t* stream, const uint8_t* payload, uint32_t size, uint32_t count);
+static void EdsStream_CheckCounters(EdsStream_t* stream, const SampleRecord_t* records, uint32_t count);
+
+/**
+ * @brief Value kind used by the shared sample decoders
+ * @note Replaces the firmware implementation in data_acquisition.c
+ */
+DataAcq_Kind_t DataAcq_GetChannelKind(uint8_t channel)
+{
+    if (channel >= DATAACQ_NUM_CHANNELS) {
+        return DATAACQ_KIND_ADC12;
+    }
+    return (DataAcq_Kind_t)channel_kinds[channel];
+}
+
+static uint32_t EdsStream_Get16(const uint8_t* in)
+{
+    return in[0] | ((uint32_t)in[1] << 8);
+}
+
+static uint32_t EdsStream_Get32(const uint8_t* in)
+{
+    return EdsStream_Get16(in) | (EdsStream_Get16(in + 2) << 16);
+}
+
+/**
+ * @brief Reset a decoder
+ */
+void EdsStream_Init(EdsStream_t* stream, const EdsStreamHandlers_t* handlers)
+{
+    memset(stream, 0, sizeof(*stream));
+    if (handlers != NULL) {
+        stream->handlers = *handlers;
+    }
+}
+
+/**
+ * @brief Offset of the first magic word, or of the bytes that may start one at the end
+ */
+static size_t EdsStream_FindMagic(const uint8_t* data, size_t length)
+{
+    const uint8_t* p = data;
+    const uint8_t* end = data + length;
+
+    // memchr is vectorised in every libc we care about, the magic is rare in the data
+    while ((p = memchr(p, USB_FRAME_MAGIC & 0xFF, end - p)) != NULL) {
+        if (end - p < 4) {
+            return p - data;
+        }
+        if (EdsStream_Get32(p) == USB_FRAME_MAGIC) {
+            return p - data;
+        }
+        p++;
+    }
+    return length;
+}
+
+/**
+ * @brief Decode a USB_FRAME_TYPE_DATA payload
+ */
+static int EdsStream_DecodeRaw(const uint8_t* payload, uint32_t size, uint32_t count, SampleRecord_t* records)
+{
+    const uint8_t* p = payload;
+    const uint8_t* end = payload + size;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (end - p < 12) {
+            return -1;
+        }
+        records[i].counter = EdsStream_Get32(p);
+        records[i].time_us = EdsStream_Get32(p + 4);
+        records[i].mask = EdsStream_Get32(p + 8);
+        p += 12;
+        if (records[i].mask >= (1UL << DATAACQ_NUM_CHANNELS)) {
+            return -1;
+        }
+        for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+            if (records[i].mask & (1UL << ch)) {
+                if (end - p < 4) {
+                    return -1;
+                }
+                records[i].value[ch] = EdsStream_Get32(p);
+                p += 4;
+            }
+        }
+    }
+
+    return (p == end) ? 0 : -1;
+}
+
+/**
+ * @brief Decode a USB_FRAME_TYPE_DATA_COMPACT payload
+ */
+static int EdsStream_DecodeCompact(const uint8_t* payload, uint32_t size, uint32_t count, SampleRecord_t* records)
+{
+    SampleCodec_State_t codec;
+    uint32_t offset = 0;
+
+    SampleCodec_Reset(&codec);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t used = SampleCodec_Decode(&codec, payload + offset, size - offset, &records[i]);
+        if (used == 0) {
+            return -1;
+        }
+        offset += used;
+    }
+
+    return (offset == size) ? 0 : -1;
+}
+
+/**
+ * @brief Decode a descriptor payload and adopt its channel kinds
+ */
+static int EdsStream_DecodeDescriptor(EdsStream_t* stream, const uint8_t* payload, uint32_t size, uint32_t count)
+{
+    EdsDescriptor_t* desc = &stream->descriptor;
+
+    if (count != DATAACQ_NUM_CHANNELS || size != 4 + count * sizeof(UsbChannelDescriptor_t)) {
+        return -1;
+    }
+
+    desc->base_rate = EdsStream_Get32(payload);
+    for (uint32_t ch = 0; ch < count; ch++) {
+        UsbChannelDescriptor_t entry;
+        memcpy(&entry, payload + 4 + ch * sizeof(entry), sizeof(entry));
+        desc->kind[ch] = entry.kind;
+        desc->divider[ch] = entry.divider;
+        memcpy(desc->name[ch], entry.name, DATAACQ_CHANNEL_NAME_LEN);
+        desc->name[ch][DATAACQ_CHANNEL_NAME_LEN] = '\0';
+        channel_kinds[ch] = entry.kind;
+    }
+    desc->valid = 1;
+
+    if (stream->handlers.on_descriptor != NULL) {
+        stream->handlers.on_descriptor(stream->handlers.context, desc);
+    }
+    return 0;
+}
+
+/**
+ * @brief Count records missing between and within frames
+ */
+static void EdsStream_CheckCounters(EdsStream_t* stream, const SampleRecord_t* records, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        if (stream->have_counter && records[i].counter != stream->next_counter) {
+            stream->stats.samples_lost += (uint32_t)(records[i].counter - stream->next_counter);
+        }
+        stream->next_counter = records[i].counter + 1;
+        stream->have_counter = 1;
+    }
+    stream->stats.samples += count;
+}
+
+/**
+ * @brief Decode one complete frame, -1 if the payload does not match the header
+ */
+static int EdsStream_DecodeFrame(EdsStream_t* stream, const UsbFrameHeader_t* header, const uint8_t* payload)
+{
+    static SampleRecord_t records[USB_FRAME_MAX_SIZE / 5];
+    int result;
+
+    switch (header->type) {
+        case USB_FRAME_TYPE_DESCRIPTOR:
+            return EdsStream_DecodeDescriptor(stream, payload, header->payload_size, header->count);
+
+        case USB_FRAME_TYPE_STATS:
+            if (header->payload_size != sizeof(UsbTxStats_t) + sizeof(UsbVescStats_t) + sizeof(UsbControlStats_t) +
+                                       sizeof(UsbIsrStats_t)) {
+                return -1;
+            }
+            if (stream->handlers.on_stats != NULL) {
+                UsbTxStats_t tx;
+                UsbVescStats_t vesc;
+                UsbControlStats_t control;
+                UsbIsrStats_t isr;
+                memcpy(&tx, payload, sizeof(tx));
+                memcpy(&vesc, payload + sizeof(tx), sizeof(vesc));
+                memcpy(&control, payload + sizeof(tx) + sizeof(vesc), sizeof(control));
+                memcpy(&isr, payload + sizeof(tx) + sizeof(vesc) + sizeof(control), sizeof(isr));
+                stream->handlers.on_stats(stream->handlers.context, &tx, &vesc, &control, &isr);
+            }
+            return 0;
+
+        case USB_FRAME_TYPE_DATA:
+            if (header->count > USB_FRAME_MAX_SAMPLES) {
+                return -1;
+            }
+            result = EdsStream_DecodeRaw(payload, header->payload_size, header->count, records);
+            break;
+
+        case USB_FRAME_TYPE_DATA_COMPACT:
+            if (header->count > sizeof(records) / sizeof(records[0])) {
+                return -1;
+            }
+            result = EdsStream_DecodeCompact(payload, header->payload_size, header->count, records);
+            break;
+
+        case USB_FRAME_TYPE_DATA_PACKED:
+            if (header->count == 0) {
+                result = (header->payload_size == 0) ? 0 : -1;
+            } else {
+                result = (SamplePack_Decode(payload, header->payload_size, header->count, records)
+                          == header->payload_size) ? 0 : -1;
+            }
+            break;
+
+        default:
+            return -1;
+    }
+
+    if (result == 0 && header->count > 0) {
+        EdsStream_CheckCounters(stream, records, header->count);
+        if (stream->handlers.on_records != NULL) {
+            stream->handlers.on_records(stream->handlers.context, records, header->count);
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Decode as much of the stream as possible
+ */
+void EdsStream_Feed(EdsStream_t* stream, const uint8_t* data, size_t length)
+{
+    stream->stats.bytes += length;
+
+    while (length > 0) {
+        size_t chunk = sizeof(stream->buffer) - stream->length;
+        if (chunk > length) {
+            chunk = length;
+        }
+        memcpy(stream->buffer + stream->length, data, chunk);
+        stream->length += chunk;
+        data += chunk;
+        length -= chunk;
+
+        size_t pos = 0;
+        while (1) {
+            size_t skip = EdsStream_FindMagic(stream->buffer + pos, stream->length - pos);
+            stream->stats.skipped_bytes += skip;
+            pos += skip;
+            if (stream->length - pos < sizeof(UsbFrameHeader_t)) {
+                break;
+            }
+
+            UsbFrameHeader_t header;
+            memcpy(&header, stream->buffer + pos, sizeof(header));
+            if (header.version != USB_FRAME_VERSION ||
+                    header.type > USB_FRAME_TYPE_STATS ||
+                    sizeof(header) + header.payload_size > USB_FRAME_MAX_SIZE) {
+                // Magic value inside sample data, look further
+                pos++;
+                stream->stats.skipped_bytes++;
+                continue;
+            }
+            if (stream->length - pos < sizeof(header) + header.payload_size) {
+                break;  // Rest of the frame has not arrived yet
+            }
+
+            // The device restarts both sequences on every start command
+            if (header.sequence == 0) {
+                stream->have_sequence = 0;
+                stream->have_counter = 0;
+            }
+
+            if (EdsStream_DecodeFrame(stream, &header, stream->buffer + pos + sizeof(header)) != 0) {
+                stream->stats.bad_frames++;
+                stream->stats.skipped_bytes++;
+                pos++;
+                continue;
+            }
+
+            if (stream->have_sequence && header.sequence != stream->next_sequence) {
+                stream->stats.frames_lost += (uint32_t)(header.sequence - stream->next_sequence);
+            }
+            stream->next_sequence = header.sequence + 1;
+            stream->have_sequence = 1;
+            stream->stats.frames++;
+            pos += sizeof(header) + header.payload_size;
+        }
+
+        // Keep only the unparsed tail, the buffer never grows past its fixed size
+        memmove(stream->buffer, stream->buffer + pos, stream->length - pos);
+        stream->length -= pos;
+    }
+}
@@ -0,0 +1,82 @@
+/**
+ * @file eds_stream.h
+ * @brief Host side decoder of the EDS_Logger USB stream
+ *
+ * Raw bytes from the CDC port are fed in any split. The decoder finds
+ * frames by their magic word, checks the header and payload, and hands
+ * every decoded record to a callback, whatever the frame encoding. Frames
+ * that fail to decode are skipped byte by byte until the next magic word.
+ * Frame sequence and sample counter gaps are counted as losses.
+ *
+ * The frame layout and the compact and packed encodings come from the
+ * firmware headers in Core/Inc, and the reference decoders in Core/Src are
+ * compiled into the host build, so both sides always agree.
+ */
+
+#ifndef EDS_STREAM_H
+#define EDS_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "usb_comm.h"
+
+/* Configuration Constants */
+#define EDS_STREAM_BUFFER_SIZE  (32 * USB_FRAME_MAX_SIZE)   // Unparsed bytes kept between feeds
+
+/* Last stream descriptor */
+typedef struct {
+    uint8_t valid;                      // 0 until the first descriptor frame
+    uint32_t base_rate;                 // Base tick rate in Hz
+    uint16_t divider[DATAACQ_NUM_CHANNELS];
+    uint8_t kind[DATAACQ_NUM_CHANNELS]; // DataAcq_Kind_t
+    char name[DATAACQ_NUM_CHANNELS][DATAACQ_CHANNEL_NAME_LEN + 1];
+} EdsDescriptor_t;
+
+/* Decoder statistics */
+typedef struct {
+    uint64_t bytes;             // Bytes fed
+    uint64_t frames;            // Frames decoded
+    uint64_t frames_lost;       // Frames missing from the sequence
+    uint64_t bad_frames;        // Frames with a valid header that did not decode
+    uint64_t skipped_bytes;     // Bytes dropped while resynchronising
+    uint64_t samples;           // Records decoded
+    uint64_t samples_lost;      // Records missing from the counter sequence
+} EdsStreamStats_t;
+
+/* Callbacks, any of them may be NULL */
+typedef struct {
+    void (*on_descriptor)(void* context, const EdsDescriptor_t* descriptor);
+    void (*on_records)(void* context, const SampleRecord_t* records, uint32_t count);
+    void (*on_stats)(void* context, const UsbTxStats_t* tx, const UsbVescStats_t* vesc,
+                     const UsbControlStats_t* control, const UsbIsrStats_t* isr);
+    void* context;
+} EdsStreamHandlers_t;
+
+typedef struct {
+    uint8_t buffer[EDS_STREAM_BUFFER_SIZE];
+    size_t length;
+    EdsDescriptor_t descriptor;
+    EdsStreamStats_t stats;
+    EdsStreamHandlers_t handlers;
+    uint8_t have_sequence;
+    uint32_t next_sequence;
+    uint8_t have_counter;
+    uint32_t next_counter;
+} EdsStream_t;
+
+/**
+ * @brief Reset a decoder
+ * @param stream Decoder state
+ * @param handlers Callbacks, copied
+ */
+void EdsStream_Init(EdsStream_t* stream, const EdsStreamHandlers_t* handlers);
+
+/**
+ * @brief Decode as much of the stream as possible
+ * @param stream Decoder state
+ * @param data Received bytes
+ * @param length Number of received bytes
+ */
+void EdsStream_Feed(EdsStream_t* stream, const uint8_t* data, size_t length);
+
+#endif /* EDS_STREAM_H */
@@ -0,0 +1,29 @@
+/**
+ * @file stm32f7xx_hal.h
+ * @brief Host build stand-in for the HAL types named by the shared firmware headers
+ *
+ * Only Core/Inc headers that describe the stream format are used on the
+ * host. They mention HAL handle types in prototypes the host never calls.
+ * The host tests also build the sample ring, whose barriers map to a full
+ * compiler and CPU fence here.
+ */
+
+#ifndef HOST_SHIM_STM32F7XX_HAL_H
+#define HOST_SHIM_STM32F7XX_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum {
+    HAL_OK = 0,
+    HAL_ERROR,
+    HAL_BUSY,
+    HAL_TIMEOUT
+} HAL_StatusTypeDef;
+
+typedef struct __ADC_HandleTypeDef ADC_HandleTypeDef;
+typedef struct __TIM_HandleTypeDef TIM_HandleTypeDef;
+
+#define __DMB() __sync_synchronize()
+
+#endif /* HOST_SHIM_STM32F7XX_HAL_H */
@@ -0,0 +1,11 @@
+/**
+ * @file usbd_cdc_if.h
+ * @brief Host build stand-in for the CDC interface header included by usb_comm.h
+ */
+
+#ifndef HOST_SHIM_USBD_CDC_IF_H
+#define HOST_SHIM_USBD_CDC_IF_H
+
+#define APP_TX_DATA_SIZE  2048  // Must match USB_DEVICE/App/usbd_cdc_if.h
+
+#endif /* HOST_SHIM_USBD_CDC_IF_H */
@@ -0,0 +1,371 @@
+/**
+ * @file test_conf_codec.c
+ * @brief mc_configuration table codec against the VESC 3.39/3.40 wire layout
+ *
+ * The fixture below is the hand-written COMM_SET_MCCONF encoder and
+ * COMM_GET_MCCONF decoder that bldc_interface.c used before mcconf_table.h,
+ * which follow the 3.39/3.40 firmware field by field. Arbitrary payloads
+ * must decode to the same struct through both. Random configurations, built
+ * field by field with values the wire format can carry, must encode to the
+ * fixture bytes and survive a round trip. Every payload shorter than the
+ * layout must be rejected without touching the configuration.
+ */
+
+#include "conf_codec.h"
+#include "mcconf_table.h"
+#include "buffer.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_ROUNDS         20000
+#define TEST_WIRE_SIZE      340     // Bytes of an mc_configuration in 3.39/3.40
+
+/* Private variables */
+static uint32_t rng_state = 0x6A09E667;
+static uint32_t failures = 0;
+
+/* Private function prototypes */
+static uint32_t Test_Random(void);
+static void Test_Fill(void* data, uint32_t length);
+static void Test_Assert(int condition, const char* what, uint32_t value);
+static int32_t Test_RandomPayload(uint8_t* buffer);
+static int32_t Test_FixtureEncode(const mc_configuration* conf, uint8_t* buffer);
+static int32_t Test_FixtureDecode(const uint8_t* buffer, mc_configuration* conf);
+
+/**
+ * @brief xorshift32, reproducible across hosts
+ */
+static uint32_t Test_Random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void Test_Fill(void* data, uint32_t length)
+{
+    for (uint32_t i = 0; i < length; i++) {
+        ((uint8_t*)data)[i] = (uint8_t)Test_Random();
+    }
+}
+
+static void Test_Assert(int condition, const char* what, uint32_t value)
+{
+    if (!condition && failures++ < 10) {
+        printf("%s (%u)\n", what, value);
+    }
+}
+
+/**
+ * @brief Payload of a random configuration, floats are finite and bools 0 or 1
+ */
+static int32_t Test_RandomPayload(uint8_t* buffer)
+{
+    int32_t ind = 0;
+
+#define TEST_WIRE_U8(field, bytes)      buffer[ind++] = (uint8_t)Test_Random();
+#define TEST_WIRE_BOOL(field, bytes)    buffer[ind++] = Test_Random() & 1;
+#define TEST_WIRE_I32(field, bytes)     buffer_append_int32(buffer, (int32_t)Test_Random(), &ind);
+#define TEST_WIRE_U32(field, bytes)     buffer_append_uint32(buffer, Test_Random(), &ind);
+#define TEST_WIRE_F32(field, bytes) \
+    buffer_append_float32_auto(buffer, ldexpf((int32_t)(Test_Random() << 8) / 2147483648.0f, \
+                                              (int32_t)(Test_Random() % 61) - 30), &ind);
+#define TEST_WIRE_BYTES(field, bytes) \
+    for (int32_t i = 0; i < (bytes); i++) { buffer[ind++] = (uint8_t)Test_Random(); }
+#define TEST_FIELD(wire, field, bytes)  TEST_WIRE_##wire(field, bytes)
+
+    MCCONF_FIELDS(TEST_FIELD)
+
+    return ind;
+}
+
+/**
+ * @brief COMM_SET_MCCONF payload after the command byte, 3.39/3.40 layout
+ */
+static int32_t Test_FixtureEncode(const mc_configuration* conf, uint8_t* buffer)
+{
+    int32_t ind = 0;
+
+    buffer[ind++] = conf->pwm_mode;
+    buffer[ind++] = conf->comm_mode;
+    buffer[ind++] = conf->motor_type;
+    buffer[ind++] = conf->sensor_mode;
+
+    buffer_append_float32_auto(buffer, conf->l_current_max, &ind);
+    buffer_append_float32_auto(buffer, conf->l_current_min, &ind);
+    buffer_append_float32_auto(buffer, conf->l_in_current_max, &ind);
+    buffer_append_float32_auto(buffer, conf->l_in_current_min, &ind);
+    buffer_append_float32_auto(buffer, conf->l_abs_current_max, &ind);
+    buffer_append_float32_auto(buffer, conf->l_min_erpm, &ind);
+    buffer_append_float32_auto(buffer, conf->l_max_erpm, &ind);
+    buffer_append_float32_auto(buffer, conf->l_erpm_start, &ind);
+    buffer_append_float32_auto(buffer, conf->l_max_erpm_fbrake, &ind);
+    buffer_append_float32_auto(buffer, conf->l_max_erpm_fbrake_cc, &ind);
+    buffer_append_float32_auto(buffer, conf->l_min_vin, &ind);
+    buffer_append_float32_auto(buffer, conf->l_max_vin, &ind);
+    buffer_append_float32_auto(buffer, conf->l_battery_cut_start, &ind);
+    buffer_append_float32_auto(buffer, conf->l_battery_cut_end, &ind);
+    buffer[ind++] = conf->l_slow_abs_current;
+    buffer_append_float32_auto(buffer, conf->l_temp_fet_start, &ind);
+    buffer_append_float32_auto(buffer, conf->l_temp_fet_end, &ind);
+    buffer_append_float32_auto(buffer, conf->l_temp_motor_start, &ind);
+    buffer_append_float32_auto(buffer, conf->l_temp_motor_end, &ind);
+    buffer_append_float32_auto(buffer, conf->l_temp_accel_dec, &ind);
+    buffer_append_float32_auto(buffer, conf->l_min_duty, &ind);
+    buffer_append_float32_auto(buffer, conf->l_max_duty, &ind);
+    buffer_append_float32_auto(buffer, conf->l_watt_max, &ind);
+    buffer_append_float32_auto(buffer, conf->l_watt_min, &ind);
+
+    buffer_append_float32_auto(buffer, conf->sl_min_erpm, &ind);
+    buffer_append_float32_auto(buffer, conf->sl_min_erpm_cycle_int_limit, &ind);
+    buffer_append_float32_auto(buffer, conf->sl_max_fullbreak_current_dir_change, &ind);
+    buffer_append_float32_auto(buffer, conf->sl_cycle_int_limit, &ind);
+    buffer_append_float32_auto(buffer, conf->sl_phase_advance_at_br, &ind);
+    buffer_append_float32_auto(buffer, conf->sl_cycle_int_rpm_br, &ind);
+    buffer_append_float32_auto(buffer, conf->sl_bemf_coupling_k, &ind);
+
+    memcpy(buffer + ind, conf->hall_table, 8);
+    ind += 8;
+    buffer_append_float32_auto(buffer, conf->hall_sl_erpm, &ind);
+
+    buffer_append_float32_auto(buffer, conf->foc_current_kp, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_current_ki, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_f_sw, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_dt_us, &ind);
+    buffer[ind++] = conf->foc_encoder_inverted;
+    buffer_append_float32_auto(buffer, conf->foc_encoder_offset, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_encoder_ratio, &ind);
+    buffer[ind++] = conf->foc_sensor_mode;
+    buffer_append_float32_auto(buffer, conf->foc_pll_kp, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_pll_ki, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_motor_l, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_motor_r, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_motor_flux_linkage, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_observer_gain, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_observer_gain_slow, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_duty_dowmramp_kp, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_duty_dowmramp_ki, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_openloop_rpm, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_sl_openloop_hyst, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_sl_openloop_time, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_sl_d_current_duty, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_sl_d_current_factor, &ind);
+    memcpy(buffer + ind, conf->foc_hall_table, 8);
+    ind += 8;
+    buffer_append_float32_auto(buffer, conf->foc_sl_erpm, &ind);
+    buffer[ind++] = conf->foc_sample_v0_v7;
+    buffer[ind++] = conf->foc_sample_high_current;
+    buffer_append_float32_auto(buffer, conf->foc_sat_comp, &ind);
+    buffer[ind++] = conf->foc_temp_comp;
+    buffer_append_float32_auto(buffer, conf->foc_temp_comp_base_temp, &ind);
+    buffer_append_float32_auto(buffer, conf->foc_current_filter_const, &ind);
+
+    buffer_append_float32_auto(buffer, conf->s_pid_kp, &ind);
+    buffer_append_float32_auto(buffer, conf->s_pid_ki, &ind);
+    buffer_append_float32_auto(buffer, conf->s_pid_kd, &ind);
+    buffer_append_float32_auto(buffer, conf->s_pid_kd_filter, &ind);
+    buffer_append_float32_auto(buffer, conf->s_pid_min_erpm, &ind);
+    buffer[ind++] = conf->s_pid_allow_braking;
+
+    buffer_append_float32_auto(buffer, conf->p_pid_kp, &ind);
+    buffer_append_float32_auto(buffer, conf->p_pid_ki, &ind);
+    buffer_append_float32_auto(buffer, conf->p_pid_kd, &ind);
+    buffer_append_float32_auto(buffer, conf->p_pid_kd_filter, &ind);
+    buffer_append_float32_auto(buffer, conf->p_pid_ang_div, &ind);
+
+    buffer_append_float32_auto(buffer, conf->cc_startup_boost_duty, &ind);
+    buffer_append_float32_auto(buffer, conf->cc_min_current, &ind);
+    buffer_append_float32_auto(buffer, conf->cc_gain, &ind);
+    buffer_append_float32_auto(buffer, conf->cc_ramp_step_max, &ind);
+
+    buffer_append_int32(buffer, conf->m_fault_stop_time_ms, &ind);
+    buffer_append_float32_auto(buffer, conf->m_duty_ramp_step, &ind);
+    buffer_append_float32_auto(buffer, conf->m_current_backoff_gain, &ind);
+    buffer_append_uint32(buffer, conf->m_encoder_counts, &ind);
+    buffer[ind++] = conf->m_sensor_port_mode;
+    buffer[ind++] = conf->m_invert_direction;
+    buffer[ind++] = conf->m_drv8301_oc_mode;
+    buffer[ind++] = conf->m_drv8301_oc_adj;
+    buffer_append_float32_auto(buffer, conf->m_bldc_f_sw_min, &ind);
+    buffer_append_float32_auto(buffer, conf->m_bldc_f_sw_max, &ind);
+    buffer_append_float32_auto(buffer, conf->m_dc_f_sw, &ind);
+    buffer_append_float32_auto(buffer, conf->m_ntc_motor_beta, &ind);
+    buffer[ind++] = conf->m_out_aux_mode;
+
+    return ind;
+}
+
+/**
+ * @brief COMM_GET_MCCONF payload after the command byte, 3.39/3.40 layout
+ */
+static int32_t Test_FixtureDecode(const uint8_t* buffer, mc_configuration* conf)
+{
+    int32_t ind = 0;
+    conf->pwm_mode = buffer[ind++];
+    conf->comm_mode = buffer[ind++];
+    conf->motor_type = buffer[ind++];
+    conf->sensor_mode = buffer[ind++];
+
+    conf->l_current_max = buffer_get_float32_auto(buffer, &ind);
+    conf->l_current_min = buffer_get_float32_auto(buffer, &ind);
+    conf->l_in_current_max = buffer_get_float32_auto(buffer, &ind);
+    conf->l_in_current_min = buffer_get_float32_auto(buffer, &ind);
+    conf->l_abs_current_max = buffer_get_float32_auto(buffer, &ind);
+    conf->l_min_erpm = buffer_get_float32_auto(buffer, &ind);
+    conf->l_max_erpm = buffer_get_float32_auto(buffer, &ind);
+    conf->l_erpm_start = buffer_get_float32_auto(buffer, &ind);
+    conf->l_max_erpm_fbrake = buffer_get_float32_auto(buffer, &ind);
+    conf->l_max_erpm_fbrake_cc = buffer_get_float32_auto(buffer, &ind);
+    conf->l_min_vin = buffer_get_float32_auto(buffer, &ind);
+    conf->l_max_vin = buffer_get_float32_auto(buffer, &ind);
+    conf->l_battery_cut_start = buffer_get_float32_auto(buffer, &ind);
+    conf->l_battery_cut_end = buffer_get_float32_auto(buffer, &ind);
+    conf->l_slow_abs_current = buffer[ind++];
+    conf->l_temp_fet_start = buffer_get_float32_auto(buffer, &ind);
+    conf->l_temp_fet_end = buffer_get_float32_auto(buffer, &ind);
+    conf->l_temp_motor_start = buffer_get_float32_auto(buffer, &ind);
+    conf->l_temp_motor_end = buffer_get_float32_auto(buffer, &ind);
+    conf->l_temp_accel_dec = buffer_get_float32_auto(buffer, &ind);
+    conf->l_min_duty = buffer_get_float32_auto(buffer, &ind);
+    conf->l_max_duty = buffer_get_float32_auto(buffer, &ind);
+    conf->l_watt_max = buffer_get_float32_auto(buffer, &ind);
+    conf->l_watt_min = buffer_get_float32_auto(buffer, &ind);
+
+    conf->lo_current_max = conf->l_current_max;
+    conf->lo_current_min = conf->l_current_min;
+    conf->lo_in_current_max = conf->l_in_current_max;
+    conf->lo_in_current_min = conf->l_in_current_min;
+    conf->lo_current_motor_max_now = conf->l_current_max;
+    conf->lo_current_motor_min_now = conf->l_current_min;
+
+    conf->sl_min_erpm = buffer_get_float32_auto(buffer, &ind);
+    conf->sl_min_erpm_cycle_int_limit = buffer_get_float32_auto(buffer, &ind);
+    conf->sl_max_fullbreak_current_dir_change = buffer_get_float32_auto(buffer, &ind);
+    conf->sl_cycle_int_limit = buffer_get_float32_auto(buffer, &ind);
+    conf->sl_phase_advance_at_br = buffer_get_float32_auto(buffer, &ind);
+    conf->sl_cycle_int_rpm_br = buffer_get_float32_auto(buffer, &ind);
+    conf->sl_bemf_coupling_k = buffer_get_float32_auto(buffer, &ind);
+
+    memcpy(conf->hall_table, buffer + ind, 8);
+    ind += 8;
+    conf->hall_sl_erpm = buffer_get_float32_auto(buffer, &ind);
+
+    conf->foc_current_kp = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_current_ki = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_f_sw = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_dt_us = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_encoder_inverted = buffer[ind++];
+    conf->foc_encoder_offset = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_encoder_ratio = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_sensor_mode = buffer[ind++];
+    conf->foc_pll_kp = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_pll_ki = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_motor_l = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_motor_r = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_motor_flux_linkage = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_observer_gain = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_observer_gain_slow = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_duty_dowmramp_kp = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_duty_dowmramp_ki = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_openloop_rpm = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_sl_openloop_hyst = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_sl_openloop_time = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_sl_d_current_duty = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_sl_d_current_factor = buffer_get_float32_auto(buffer, &ind);
+    memcpy(conf->foc_hall_table, buffer + ind, 8);
+    ind += 8;
+    conf->foc_sl_erpm = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_sample_v0_v7 = buffer[ind++];
+    conf->foc_sample_high_current = buffer[ind++];
+    conf->foc_sat_comp = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_temp_comp = buffer[ind++];
+    conf->foc_temp_comp_base_temp = buffer_get_float32_auto(buffer, &ind);
+    conf->foc_current_filter_const = buffer_get_float32_auto(buffer, &ind);
+
+    conf->s_pid_kp = buffer_get_float32_auto(buffer, &ind);
+    conf->s_pid_ki = buffer_get_float32_auto(buffer, &ind);
+    conf->s_pid_kd = buffer_get_float32_auto(buffer, &ind);
+    conf->s_pid_kd_filter = buffer_get_float32_auto(buffer, &ind);
+    conf->s_pid_min_erpm = buffer_get_float32_auto(buffer, &ind);
+    conf->s_pid_allow_braking = buffer[ind++];
+
+    conf->p_pid_kp = buffer_get_float32_auto(buffer, &ind);
+    conf->p_pid_ki = buffer_get_float32_auto(buffer, &ind);
+    conf->p_pid_kd = buffer_get_float32_auto(buffer, &ind);
+    conf->p_pid_kd_filter = buffer_get_float32_auto(buffer, &ind);
+    conf->p_pid_ang_div = buffer_get_float32_auto(buffer, &ind);
+
+    conf->cc_startup_boost_duty = buffer_get_float32_auto(buffer, &ind);
+    conf->cc_min_current = buffer_get_float32_auto(buffer, &ind);
+    conf->cc_gain = buffer_get_float32_auto(buffer, &ind);
+    conf->cc_ramp_step_max = buffer_get_float32_auto(buffer, &ind);
+
+    conf->m_fault_stop_time_ms = buffer_get_int32(buffer, &ind);
+    conf->m_duty_ramp_step = buffer_get_float32_auto(buffer, &ind);
+    conf->m_current_backoff_gain = buffer_get_float32_auto(buffer, &ind);
+    conf->m_encoder_counts = buffer_get_uint32(buffer, &ind);
+    conf->m_sensor_port_mode = buffer[ind++];
+    conf->m_invert_direction = buffer[ind++];
+    conf->m_drv8301_oc_mode = buffer[ind++];
+    conf->m_drv8301_oc_adj = buffer[ind++];
+    conf->m_bldc_f_sw_min = buffer_get_float32_auto(buffer, &ind);
+    conf->m_bldc_f_sw_max = buffer_get_float32_auto(buffer, &ind);
+    conf->m_dc_f_sw = buffer_get_float32_auto(buffer, &ind);
+    conf->m_ntc_motor_beta = buffer_get_float32_auto(buffer, &ind);
+    conf->m_out_aux_mode = buffer[ind++];
+
+    return ind;
+}
+
+int main(void)
+{
+    static uint8_t wire[CONF_CODEC_MCCONF_MAX_SIZE];
+    static uint8_t encoded[CONF_CODEC_MCCONF_MAX_SIZE];
+    static uint8_t expected[CONF_CODEC_MCCONF_MAX_SIZE];
+    mc_configuration prefill;
+    mc_configuration conf;
+    mc_configuration reference;
+    mc_configuration copy;
+
+    for (uint32_t round = 0; round < TEST_ROUNDS; round++) {
+        // Any payload decodes to the struct the fixture decodes
+        Test_Fill(wire, TEST_WIRE_SIZE);
+        Test_Fill(&prefill, sizeof(prefill));
+        conf = prefill;
+        reference = prefill;
+        Test_Assert(ConfCodec_DecodeMcconf(wire, TEST_WIRE_SIZE, &conf) == TEST_WIRE_SIZE,
+                    "decoded length", round);
+        Test_Assert(Test_FixtureDecode(wire, &reference) == TEST_WIRE_SIZE, "fixture length", round);
+        Test_Assert(memcmp(&conf, &reference, sizeof(conf)) == 0, "decoded struct differs from the fixture", round);
+
+        // A random configuration encodes to the fixture bytes and back
+        Test_Assert(Test_RandomPayload(wire) == TEST_WIRE_SIZE, "random payload length", round);
+        conf = prefill;
+        Test_Assert(ConfCodec_DecodeMcconf(wire, TEST_WIRE_SIZE, &conf) == TEST_WIRE_SIZE,
+                    "decoded length", round);
+        memset(encoded, 0, sizeof(encoded));
+        Test_Assert(ConfCodec_EncodeMcconf(&conf, encoded) == TEST_WIRE_SIZE, "encoded length", round);
+        Test_Assert(Test_FixtureEncode(&conf, expected) == TEST_WIRE_SIZE, "fixture encoded length", round);
+        Test_Assert(memcmp(encoded, expected, TEST_WIRE_SIZE) == 0, "encoded bytes differ from the fixture", round);
+        Test_Assert(memcmp(encoded, wire, TEST_WIRE_SIZE) == 0, "encoded bytes differ from the payload", round);
+
+        copy = prefill;
+        Test_Assert(ConfCodec_DecodeMcconf(encoded, TEST_WIRE_SIZE, &copy) == TEST_WIRE_SIZE,
+                    "round trip length", round);
+        Test_Assert(memcmp(&copy, &conf, sizeof(conf)) == 0, "round trip changed the struct", round);
+    }
+
+    // Short payloads are rejected and leave the configuration alone
+    Test_Fill(wire, TEST_WIRE_SIZE);
+    for (int32_t length = 0; length < TEST_WIRE_SIZE; length++) {
+        Test_Fill(&conf, sizeof(conf));
+        copy = conf;
+        Test_Assert(ConfCodec_DecodeMcconf(wire, length, &conf) == -1, "short payload accepted", length);
+        Test_Assert(memcmp(&conf, &copy, sizeof(conf)) == 0, "short payload changed the struct", length);
+    }
+
+    printf("test_conf_codec: %u configurations, %u failures\n", TEST_ROUNDS, failures);
+    return failures != 0;
+}
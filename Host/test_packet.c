@@ -0,0 +1,306 @@
+/**
+ * @file test_packet.c
+ * @brief VESC packet parser, in-place span parser against the byte state machine
+ *
+ * Streams of valid frames separated by noise must give the same payloads
+ * through packet_process_buffer, cut into random spans, as through
+ * packet_process_byte. Malformed frames must be dropped without hiding the
+ * frame after them, and a truncated frame must deliver nothing and leave
+ * the parser ready for the next frame once the receive timeout expired.
+ */
+
+#include "packet.h"
+#include "crc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_STREAMS        300
+#define TEST_FRAMES         40      // Frames per stream
+#define TEST_STREAM_SIZE    (TEST_FRAMES * (PACKET_MAX_PL_LEN + 6 + 16))
+#define TEST_MALFORMED      20000
+#define TEST_TRUNCATED      5000
+
+/* Payloads delivered by the parser, concatenated */
+typedef struct {
+    uint8_t data[TEST_STREAM_SIZE];
+    unsigned int length[TEST_FRAMES + 1];
+    unsigned int frames;
+    unsigned int size;
+    unsigned int overflow;
+} Test_Log_t;
+
+/* Private variables */
+static uint32_t rng_state = 0x2545F491;
+static uint32_t failures = 0;
+static Test_Log_t expected;
+static Test_Log_t received;
+static uint8_t stream[TEST_STREAM_SIZE];
+
+/* Private function prototypes */
+static uint32_t Test_Random(void);
+static uint8_t Test_Noise(void);
+static void Test_Process(unsigned char* data, unsigned int len);
+static void Test_LogAdd(Test_Log_t* log, const uint8_t* data, unsigned int len);
+static unsigned int Test_Frame(uint8_t* out, const uint8_t* payload, unsigned int len, int long_header);
+static unsigned int Test_ValidFrame(uint8_t* out, int log);
+static unsigned int Test_MalformedFrame(uint8_t* out, uint32_t kind);
+static void Test_ResetParser(void);
+static void Test_FeedSpans(const uint8_t* data, unsigned int len);
+static void Test_Expect(const char* name, uint32_t index);
+static void Test_Equivalence(void);
+static void Test_Malformed(void);
+static void Test_Truncated(void);
+
+/**
+ * @brief xorshift32, reproducible across hosts
+ */
+static uint32_t Test_Random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/**
+ * @brief Random byte that is not a start byte
+ */
+static uint8_t Test_Noise(void)
+{
+    uint8_t b;
+    do {
+        b = (uint8_t)Test_Random();
+    } while (b == 2 || b == 3);
+    return b;
+}
+
+/**
+ * @brief Packet callback, records the payload
+ */
+static void Test_Process(unsigned char* data, unsigned int len)
+{
+    Test_LogAdd(&received, data, len);
+}
+
+static void Test_LogAdd(Test_Log_t* log, const uint8_t* data, unsigned int len)
+{
+    if (log->frames > TEST_FRAMES || log->size + len > sizeof(log->data)) {
+        log->overflow = 1;
+        return;
+    }
+    memcpy(log->data + log->size, data, len);
+    log->length[log->frames++] = len;
+    log->size += len;
+}
+
+/**
+ * @brief Build a frame, the 2-byte length header is also used for short payloads
+ */
+static unsigned int Test_Frame(uint8_t* out, const uint8_t* payload, unsigned int len, int long_header)
+{
+    unsigned int n = 0;
+    if (long_header || len > 255) {
+        out[n++] = 3;
+        out[n++] = (uint8_t)(len >> 8);
+    } else {
+        out[n++] = 2;
+    }
+    out[n++] = (uint8_t)len;
+    memcpy(out + n, payload, len);
+    n += len;
+    unsigned short crc = crc16(payload, len);
+    out[n++] = (uint8_t)(crc >> 8);
+    out[n++] = (uint8_t)crc;
+    out[n++] = 3;
+    return n;
+}
+
+/**
+ * @brief Build a valid frame of random length and content
+ * @param log Nonzero to add the payload to the expected log
+ */
+static unsigned int Test_ValidFrame(uint8_t* out, int log)
+{
+    uint8_t payload[PACKET_MAX_PL_LEN];
+    unsigned int len = (Test_Random() & 3) ? 1 + Test_Random() % 64 : 1 + Test_Random() % PACKET_MAX_PL_LEN;
+    for (unsigned int i = 0; i < len; i++) {
+        payload[i] = (uint8_t)Test_Random();
+    }
+    if (log) {
+        Test_LogAdd(&expected, payload, len);
+    }
+    return Test_Frame(out, payload, len, Test_Random() & 1);
+}
+
+/**
+ * @brief Build a frame the parser must drop
+ *
+ * Apart from its start and stop bytes the frame contains no start bytes, so
+ * the frame behind it is only found once the parser resynchronised.
+ */
+static unsigned int Test_MalformedFrame(uint8_t* out, uint32_t kind)
+{
+    uint8_t payload[64];
+    unsigned int len = 1 + Test_Random() % sizeof(payload);
+    unsigned int n;
+
+    switch (kind) {
+    case 0:     // Bad CRC
+    case 1:     // Bad stop byte
+        while (len == 2 || len == 3) {
+            len = 1 + Test_Random() % sizeof(payload);
+        }
+        for (;;) {
+            for (unsigned int i = 0; i < len; i++) {
+                payload[i] = Test_Noise();
+            }
+            n = Test_Frame(out, payload, len, 0);
+            if (kind == 0) {
+                out[n - 3 + (Test_Random() & 1)] ^= (uint8_t)(1 + Test_Random() % 255);
+            } else {
+                out[n - 1] = Test_Noise();
+            }
+            if (out[n - 3] != 2 && out[n - 3] != 3 && out[n - 2] != 2 && out[n - 2] != 3) {
+                return n;
+            }
+        }
+
+    case 2:     // Zero length
+        n = 0;
+        out[n++] = 2;
+        out[n++] = 0;
+        break;
+
+    case 3:     // Longer than PACKET_MAX_PL_LEN
+        n = 0;
+        out[n++] = 3;
+        out[n++] = (uint8_t)((PACKET_MAX_PL_LEN + 1) >> 8);
+        out[n++] = (uint8_t)(PACKET_MAX_PL_LEN + 1);
+        break;
+
+    default:    // Lone start byte
+        out[0] = 2 + (Test_Random() & 1);
+        return 1;
+    }
+
+    // Rest of a frame that is never completed
+    unsigned int tail = Test_Random() % 8;
+    for (unsigned int i = 0; i < tail; i++) {
+        out[n++] = Test_Noise();
+    }
+    return n;
+}
+
+/**
+ * @brief Let the receive timeout expire
+ */
+static void Test_ResetParser(void)
+{
+    for (int i = 0; i <= PACKET_RX_TIMEOUT; i++) {
+        packet_timerfunc();
+    }
+}
+
+/**
+ * @brief Feed bytes in random spans, as the DMA ring hands them out
+ */
+static void Test_FeedSpans(const uint8_t* data, unsigned int len)
+{
+    while (len > 0) {
+        unsigned int span = (Test_Random() & 1) ? 1 + Test_Random() % 16 : 1 + Test_Random() % 1024;
+        if (span > len) {
+            span = len;
+        }
+        packet_process_buffer(data, span, 0);
+        data += span;
+        len -= span;
+    }
+}
+
+/**
+ * @brief Compare the received payloads with the expected ones and clear both
+ */
+static void Test_Expect(const char* name, uint32_t index)
+{
+    if (received.overflow || received.frames != expected.frames || received.size != expected.size ||
+        memcmp(received.length, expected.length, expected.frames * sizeof(expected.length[0])) != 0 ||
+        memcmp(received.data, expected.data, expected.size) != 0) {
+        if (failures++ < 10) {
+            printf("%s %u: %u frames received, %u expected\n", name, index, received.frames, expected.frames);
+        }
+    }
+    memset(&received, 0, sizeof(received));
+    memset(&expected, 0, sizeof(expected));
+}
+
+/**
+ * @brief Clean streams give the same payloads through both parsers
+ */
+static void Test_Equivalence(void)
+{
+    for (uint32_t s = 0; s < TEST_STREAMS; s++) {
+        unsigned int n = 0;
+        for (unsigned int f = 0; f < TEST_FRAMES; f++) {
+            unsigned int noise = (Test_Random() & 1) ? Test_Random() % 16 : 0;
+            for (unsigned int i = 0; i < noise; i++) {
+                stream[n++] = Test_Noise();
+            }
+            n += Test_ValidFrame(stream + n, 1);
+        }
+
+        // Byte state machine first, the reference
+        Test_Log_t reference = expected;
+        for (unsigned int i = 0; i < n; i++) {
+            packet_process_byte(stream[i], 0);
+        }
+        Test_Expect("byte stream", s);
+
+        expected = reference;
+        Test_FeedSpans(stream, n);
+        Test_Expect("span stream", s);
+    }
+}
+
+/**
+ * @brief Malformed frames are dropped and the next frame is still found
+ */
+static void Test_Malformed(void)
+{
+    for (uint32_t t = 0; t < TEST_MALFORMED; t++) {
+        unsigned int n = Test_MalformedFrame(stream, t % 5);
+        n += Test_ValidFrame(stream + n, 1);
+        packet_process_buffer(stream, n, 0);
+        Test_Expect("malformed", t);
+    }
+}
+
+/**
+ * @brief Truncated frames deliver nothing and time out
+ */
+static void Test_Truncated(void)
+{
+    for (uint32_t t = 0; t < TEST_TRUNCATED; t++) {
+        unsigned int n = Test_ValidFrame(stream, 0);
+        Test_FeedSpans(stream, Test_Random() % n);
+        Test_Expect("truncated", t);
+
+        Test_ResetParser();
+        n = Test_ValidFrame(stream, 1);
+        Test_FeedSpans(stream, n);
+        Test_Expect("after timeout", t);
+    }
+}
+
+int main(void)
+{
+    packet_init(NULL, Test_Process, 0);
+
+    Test_Equivalence();
+    Test_Malformed();
+    Test_Truncated();
+
+    printf("test_packet: %u streams, %u malformed, %u truncated frames, %u failures\n",
+           TEST_STREAMS, TEST_MALFORMED, TEST_TRUNCATED, failures);
+    return failures != 0;
+}
@@ -0,0 +1,164 @@
+/**
+ * @file test_sample_codec.c
+ * @brief Round trip of random records through the compact sample encoding
+ *
+ * Records get random masks, counter and time steps that sometimes need the
+ * absolute escape, and values spread over and beyond the encodable ranges.
+ * Every decoded record must match the encoder input after the documented
+ * quantization: 12-bit ADC values, signed 24-bit saturated derived values
+ * and time channels aged at most 2^24 - 1 us. Every truncated record must
+ * be refused.
+ */
+
+#include "sample_codec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_RECORDS        200000
+#define TEST_BLOCK          40      // Records between resets, as in one frame
+#define TEST_INT24_MAX      0x7FFFFF
+#define TEST_UINT24_MAX     0xFFFFFF
+
+/* Private variables */
+static uint32_t rng_state = 0x12345678;
+static uint32_t failures = 0;
+
+/* Private function prototypes */
+static uint32_t Test_Random(void);
+static void Test_MakeRecord(SampleRecord_t* record, uint32_t counter, uint32_t time_us);
+static uint32_t Test_Expected(const SampleRecord_t* record, uint32_t ch);
+static void Test_Check(const SampleRecord_t* in, const SampleRecord_t* out, uint32_t index);
+
+/**
+ * @brief xorshift32, reproducible across hosts
+ */
+static uint32_t Test_Random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/**
+ * @brief Fill a record with values inside and outside the encodable ranges
+ */
+static void Test_MakeRecord(SampleRecord_t* record, uint32_t counter, uint32_t time_us)
+{
+    memset(record, 0, sizeof(*record));
+    record->counter = counter;
+    record->time_us = time_us;
+    record->mask = Test_Random() & ((1UL << DATAACQ_NUM_CHANNELS) - 1);
+
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+        uint32_t r = Test_Random();
+        if (ch < DATAACQ_NUM_ADC_CHANNELS) {
+            // Bits above 12 must be dropped
+            record->value[ch] = (r & 7) ? (r & 0x0FFF) : r;
+        } else if (DataAcq_GetChannelKind(ch) == DATAACQ_KIND_TIME) {
+            // Ages up to and past the 24-bit limit
+            record->value[ch] = time_us - ((r & 7) ? (Test_Random() & TEST_UINT24_MAX) : Test_Random());
+        } else {
+            record->value[ch] = (r & 7) ? (uint32_t)((int32_t)(Test_Random() << 8) >> 8) : Test_Random();
+        }
+    }
+}
+
+/**
+ * @brief Value a channel must decode to
+ */
+static uint32_t Test_Expected(const SampleRecord_t* record, uint32_t ch)
+{
+    if (ch < DATAACQ_NUM_ADC_CHANNELS) {
+        return record->value[ch] & 0x0FFF;
+    }
+    if (DataAcq_GetChannelKind(ch) == DATAACQ_KIND_TIME) {
+        uint32_t age = record->time_us - record->value[ch];
+        return record->time_us - (age > TEST_UINT24_MAX ? TEST_UINT24_MAX : age);
+    }
+
+    int32_t value = (int32_t)record->value[ch];
+    if (value > TEST_INT24_MAX) {
+        value = TEST_INT24_MAX;
+    } else if (value < -TEST_INT24_MAX) {
+        value = -TEST_INT24_MAX;
+    }
+    return (uint32_t)value;
+}
+
+/**
+ * @brief Compare a decoded record with the encoder input
+ */
+static void Test_Check(const SampleRecord_t* in, const SampleRecord_t* out, uint32_t index)
+{
+    if (out->counter != in->counter || out->time_us != in->time_us || out->mask != in->mask) {
+        if (failures++ < 10) {
+            printf("record %u: header mismatch\n", index);
+        }
+        return;
+    }
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+        if ((in->mask & (1UL << ch)) && out->value[ch] != Test_Expected(in, ch)) {
+            if (failures++ < 10) {
+                printf("record %u channel %u: %08x, expected %08x\n",
+                       index, ch, out->value[ch], Test_Expected(in, ch));
+            }
+        }
+    }
+}
+
+int main(void)
+{
+    SampleCodec_State_t encoder;
+    SampleCodec_State_t decoder;
+    SampleRecord_t in;
+    SampleRecord_t out;
+    uint8_t buffer[SAMPLE_CODEC_MAX_SIZE];
+    uint32_t counter = Test_Random();
+    uint32_t time_us = Test_Random();
+    uint64_t bytes = 0;
+
+    for (uint32_t i = 0; i < TEST_RECORDS; i++) {
+        if (i % TEST_BLOCK == 0) {
+            SampleCodec_Reset(&encoder);
+            SampleCodec_Reset(&decoder);
+        }
+
+        // Mostly small steps, sometimes gaps that need an absolute record
+        uint32_t r = Test_Random();
+        counter += (r & 15) ? 1 : (Test_Random() & 0x3FF);
+        time_us += (r & 31) ? (Test_Random() & 0x3FF) : Test_Random();
+        Test_MakeRecord(&in, counter, time_us);
+
+        uint32_t length = SampleCodec_Encode(&encoder, &in, buffer);
+        if (length > SAMPLE_CODEC_MAX_SIZE) {
+            printf("record %u: %u bytes exceed SAMPLE_CODEC_MAX_SIZE\n", i, length);
+            return 1;
+        }
+
+        // Any shorter input must be refused without touching the state
+        SampleCodec_State_t saved = decoder;
+        uint32_t cut = Test_Random() % length;
+        if (SampleCodec_Decode(&decoder, buffer, cut, &out) != 0 ||
+            memcmp(&saved, &decoder, sizeof(saved)) != 0) {
+            if (failures++ < 10) {
+                printf("record %u: %u of %u bytes accepted\n", i, cut, length);
+            }
+        }
+
+        memset(&out, 0, sizeof(out));
+        if (SampleCodec_Decode(&decoder, buffer, length, &out) != length) {
+            if (failures++ < 10) {
+                printf("record %u: decoded length differs\n", i);
+            }
+            continue;
+        }
+        Test_Check(&in, &out, i);
+        bytes += length;
+    }
+
+    printf("test_sample_codec: %u records, %.1f bytes per record, %u failures\n",
+           TEST_RECORDS, (double)bytes / TEST_RECORDS, failures);
+    return failures != 0;
+}
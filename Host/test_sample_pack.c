@@ -0,0 +1,212 @@
+/**
+ * @file test_sample_pack.c
+ * @brief Column-wise sample compression: sizing, round trip and frame filling
+ *
+ * Streams of records with random masks and channels that are constant, ramp,
+ * drift slowly or are random 32-bit words are cut into blocks the way
+ * build_packed_frame does: records are added until the next one would not
+ * fit the frame. The size SamplePack_AddRecord reports must equal what
+ * SamplePack_Encode writes for every prefix of a block, every block must fit
+ * its frame, decode to the records it was built from, and every truncated
+ * block must be refused.
+ */
+
+#include "sample_pack.h"
+#include "usb_comm.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_STREAMS        60
+#define TEST_STREAM_RECORDS 2000
+#define TEST_ROOM           (USB_FRAME_MAX_SIZE - sizeof(UsbFrameHeader_t))
+
+/* Private variables */
+static uint32_t rng_state = 0x6C8E9CF5;
+static uint32_t failures = 0;
+static SampleRecord_t stream[TEST_STREAM_RECORDS];
+static SampleRecord_t decoded[SAMPLE_PACK_MAX_RECORDS];
+static uint8_t packed[SAMPLE_PACK_MAX_SIZE];
+static uint32_t blocks = 0;
+static uint32_t full_blocks = 0;
+
+/* Private function prototypes */
+static uint32_t Test_Random(void);
+static void Test_Fail(const char* what, uint32_t stream_index, uint32_t value);
+static void Test_MakeStream(void);
+static uint32_t Test_Compare(const SampleRecord_t* a, const SampleRecord_t* b);
+static void Test_Block(const SampleRecord_t* records, uint32_t count, const uint8_t* orders, uint32_t size, uint32_t s);
+static void Test_Stream(uint32_t s);
+
+/**
+ * @brief xorshift32, reproducible across hosts
+ */
+static uint32_t Test_Random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void Test_Fail(const char* what, uint32_t stream_index, uint32_t value)
+{
+    if (failures++ < 10) {
+        printf("stream %u: %s (%u)\n", stream_index, what, value);
+    }
+}
+
+/**
+ * @brief Fill the stream with records, each channel following its own shape
+ */
+static void Test_MakeStream(void)
+{
+    uint32_t shape[DATAACQ_NUM_CHANNELS];
+    uint32_t level[DATAACQ_NUM_CHANNELS];
+    uint32_t sparse = Test_Random() & 1;
+    uint32_t shapes = (Test_Random() & 1) ? 3 : 4;  // Half the streams without noise fill whole blocks
+    uint32_t counter = Test_Random();
+    uint32_t time_us = Test_Random();
+
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+        shape[ch] = Test_Random() % shapes;
+        level[ch] = Test_Random();
+    }
+
+    for (uint32_t i = 0; i < TEST_STREAM_RECORDS; i++) {
+        SampleRecord_t* record = &stream[i];
+        memset(record, 0, sizeof(*record));
+
+        // Mostly steady steps, sometimes a dropped record or a late tick
+        counter += (Test_Random() % 64) ? 1 : 1 + Test_Random() % 1000;
+        time_us += (Test_Random() % 64) ? 100 : Test_Random();
+        record->counter = counter;
+        record->time_us = time_us;
+        record->mask = sparse ? Test_Random() & ((1UL << DATAACQ_NUM_CHANNELS) - 1)
+                              : (1UL << DATAACQ_NUM_CHANNELS) - 1;
+
+        for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+            switch (shape[ch]) {
+            case 0:     // Constant
+                break;
+            case 1:     // Ramp
+                level[ch] += 17;
+                break;
+            case 2:     // Slow drift
+                level[ch] += Test_Random() % 9 - 4;
+                break;
+            default:    // Noise
+                level[ch] = Test_Random();
+                break;
+            }
+            if (record->mask & (1UL << ch)) {
+                record->value[ch] = level[ch];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Nonzero when the records differ in any field the format carries
+ */
+static uint32_t Test_Compare(const SampleRecord_t* a, const SampleRecord_t* b)
+{
+    if (a->counter != b->counter || a->time_us != b->time_us || a->mask != b->mask) {
+        return 1;
+    }
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+        if ((a->mask & (1UL << ch)) && a->value[ch] != b->value[ch]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Encode a finished block, check its size, decode it and truncate it
+ */
+static void Test_Block(const SampleRecord_t* records, uint32_t count, const uint8_t* orders, uint32_t size, uint32_t s)
+{
+    uint32_t length = SamplePack_Encode(records, count, orders, packed);
+
+    blocks++;
+    if (length != size) {
+        Test_Fail("encoded size differs from the sizer", s, length);
+    }
+    if (length > TEST_ROOM) {
+        Test_Fail("block larger than the frame", s, length);
+    }
+    if (SamplePack_Decode(packed, length, count, decoded) != length) {
+        Test_Fail("block not decoded", s, count);
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (Test_Compare(&records[i], &decoded[i])) {
+            Test_Fail("decoded record differs", s, i);
+            break;
+        }
+    }
+    for (uint32_t cut = 0; cut < length; cut++) {
+        if (SamplePack_Decode(packed, cut, count, decoded) != 0) {
+            Test_Fail("truncated block accepted", s, cut);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Cut one stream into frame-sized blocks as build_packed_frame does
+ */
+static void Test_Stream(uint32_t s)
+{
+    SamplePack_Sizer_t sizer;
+    uint8_t orders[DATAACQ_NUM_CHANNELS];
+    uint32_t start = 0;
+
+    // Order 3 is out of range and falls back to 1
+    for (uint32_t ch = 0; ch < DATAACQ_NUM_CHANNELS; ch++) {
+        orders[ch] = Test_Random() % 4;
+    }
+    Test_MakeStream();
+
+    while (start < TEST_STREAM_RECORDS) {
+        uint32_t count = 0;
+        uint32_t size = 0;
+
+        SamplePack_BeginBlock(&sizer, orders);
+        while (count < SAMPLE_PACK_MAX_RECORDS && start + count < TEST_STREAM_RECORDS) {
+            uint32_t next = SamplePack_AddRecord(&sizer, &stream[start + count]);
+            if (next > TEST_ROOM) {
+                break;
+            }
+            size = next;
+            count++;
+
+            // The running size matches the encoder on every prefix
+            uint32_t length = SamplePack_Encode(&stream[start], count, sizer.orders, packed);
+            if (length != size) {
+                Test_Fail("sizer differs from the encoder", s, count);
+            }
+        }
+        if (count == 0) {
+            Test_Fail("record does not fit an empty frame", s, start);
+            return;
+        }
+        if (count == SAMPLE_PACK_MAX_RECORDS) {
+            full_blocks++;
+        }
+
+        Test_Block(&stream[start], count, sizer.orders, size, s);
+        start += count;
+    }
+}
+
+int main(void)
+{
+    for (uint32_t s = 0; s < TEST_STREAMS; s++) {
+        Test_Stream(s);
+    }
+
+    printf("test_sample_pack: %u streams in %u blocks, %u at the %u record limit, %u failures\n",
+           TEST_STREAMS, blocks, full_blocks, SAMPLE_PACK_MAX_RECORDS, failures);
+    return failures != 0;
+}
@@ -0,0 +1,160 @@
+/**
+ * @file test_sample_ring.c
+ * @brief SPSC sample ring: empty, full, peek, overruns, high water and index wrap
+ *
+ * The ring source is included so the free-running indices can be started
+ * just below 2^32. A producer and a consumer thread then check that records
+ * arrive in order and that every record is either delivered or counted as
+ * an overrun.
+ */
+
+#include "../Core/Src/sample_ring.c"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_THREAD_RECORDS 500000
+#define TEST_CONSUMER_BATCH 256     // Records popped between consumer pauses
+
+/* Private variables */
+static uint32_t failures = 0;
+
+/* Private function prototypes */
+static void Test_Assert(int condition, const char* what, uint32_t value);
+static void Test_MakeRecord(SampleRecord_t* record, uint32_t counter);
+static void Test_FillAndDrain(const char* name);
+static void* Test_Producer(void* arg);
+static void Test_Threads(void);
+
+static void Test_Assert(int condition, const char* what, uint32_t value)
+{
+    if (!condition && failures++ < 10) {
+        printf("%s (%u)\n", what, value);
+    }
+}
+
+static void Test_MakeRecord(SampleRecord_t* record, uint32_t counter)
+{
+    memset(record, 0, sizeof(*record));
+    record->counter = counter;
+    record->time_us = counter * 7;
+    record->mask = counter & 0xFF;
+    record->value[DATAACQ_NUM_CHANNELS - 1] = ~counter;
+}
+
+/**
+ * @brief One pass through every state of the ring from the current indices
+ */
+static void Test_FillAndDrain(const char* name)
+{
+    SampleRecord_t record;
+    uint32_t overruns = SampleRing_GetOverruns();
+
+    // Empty
+    Test_Assert(SampleRing_Count() == 0, name, 0);
+    Test_Assert(SampleRing_Pop(&record) == 0, "pop from an empty ring", 0);
+    Test_Assert(SampleRing_Peek(&record) == 0, "peek into an empty ring", 0);
+
+    // Full, then one record more
+    for (uint32_t i = 0; i < SAMPLE_RING_SIZE; i++) {
+        Test_MakeRecord(&record, i);
+        Test_Assert(SampleRing_Push(&record) == 1, "push into a ring with room", i);
+    }
+    Test_Assert(SampleRing_Count() == SAMPLE_RING_SIZE, "count of a full ring", SampleRing_Count());
+    Test_Assert(SampleRing_GetHighWater() == SAMPLE_RING_SIZE, "high water of a full ring", SampleRing_GetHighWater());
+    Test_MakeRecord(&record, SAMPLE_RING_SIZE);
+    Test_Assert(SampleRing_Push(&record) == 0, "push into a full ring", SAMPLE_RING_SIZE);
+    Test_Assert(SampleRing_Push(&record) == 0, "push into a full ring", SAMPLE_RING_SIZE);
+    Test_Assert(SampleRing_GetOverruns() == overruns + 2, "overruns of a full ring", SampleRing_GetOverruns());
+
+    // Oldest first, the dropped records never appear, a peek does not consume
+    for (uint32_t i = 0; i < SAMPLE_RING_SIZE; i++) {
+        SampleRecord_t expected;
+        Test_MakeRecord(&expected, i);
+        Test_Assert(SampleRing_Peek(&record) == 1, "peek into a ring with records", i);
+        Test_Assert(memcmp(&record, &expected, sizeof(record)) == 0, "peeked record contents", i);
+        Test_Assert(SampleRing_Pop(&record) == 1, "pop from a ring with records", i);
+        Test_Assert(memcmp(&record, &expected, sizeof(record)) == 0, "record contents", i);
+    }
+    Test_Assert(SampleRing_Pop(&record) == 0, "pop from a drained ring", 0);
+    Test_Assert(SampleRing_Count() == 0, "count of a drained ring", SampleRing_Count());
+}
+
+static void* Test_Producer(void* arg)
+{
+    SampleRecord_t record;
+    (void)arg;
+
+    for (uint32_t i = 0; i < TEST_THREAD_RECORDS; i++) {
+        // Alternate bursts that wait for room with bursts that overrun a full ring
+        while ((i & 4096) != 0 && SampleRing_Count() >= SAMPLE_RING_SIZE) {
+            sched_yield();
+        }
+        Test_MakeRecord(&record, i);
+        SampleRing_Push(&record);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Concurrent producer and consumer, records arrive in order or are counted lost
+ */
+static void Test_Threads(void)
+{
+    pthread_t producer;
+    SampleRecord_t record;
+    uint32_t received = 0;
+    uint32_t last = 0;
+    int done = 0;
+
+    SampleRing_Init();
+    pthread_create(&producer, NULL, Test_Producer, NULL);
+
+    while (!done || SampleRing_Count() > 0) {
+        // Read the flag first, records pushed before it are still drained
+        done = __atomic_load_n(&head, __ATOMIC_ACQUIRE) + overruns == TEST_THREAD_RECORDS;
+        // Pause between batches so the ring fills up now and then
+        for (uint32_t n = 0; n < TEST_CONSUMER_BATCH && SampleRing_Pop(&record); n++) {
+            SampleRecord_t expected;
+            Test_MakeRecord(&expected, record.counter);
+            Test_Assert(received == 0 || record.counter > last, "records out of order", record.counter);
+            Test_Assert(memcmp(&record, &expected, sizeof(record)) == 0, "torn record", record.counter);
+            last = record.counter;
+            received++;
+        }
+        sched_yield();
+    }
+    pthread_join(producer, NULL);
+
+    Test_Assert(received + SampleRing_GetOverruns() == TEST_THREAD_RECORDS, "records lost without an overrun",
+                received + SampleRing_GetOverruns());
+    printf("test_sample_ring: %u of %u records through two threads, %u overruns, high water %u\n",
+           received, TEST_THREAD_RECORDS, SampleRing_GetOverruns(), SampleRing_GetHighWater());
+}
+
+int main(void)
+{
+    SampleRing_Init();
+    Test_FillAndDrain("count of a new ring");
+
+    // Init clears the statistics
+    SampleRing_Init();
+    Test_Assert(SampleRing_GetOverruns() == 0 && SampleRing_GetHighWater() == 0, "statistics after init", 0);
+
+    // The slot index wraps while the free-running indices do not
+    head = tail = SAMPLE_RING_SIZE / 2 + 3;
+    Test_FillAndDrain("count after a slot wrap");
+
+    // Both indices wrap through 2^32 while the ring is full
+    SampleRing_Init();
+    head = tail = UINT32_MAX - SAMPLE_RING_SIZE / 2;
+    Test_FillAndDrain("count before the index wrap");
+    Test_Assert(head < SAMPLE_RING_SIZE, "head wrapped", head);
+    Test_FillAndDrain("count after the index wrap");
+
+    Test_Threads();
+
+    printf("test_sample_ring: %u failures\n", failures);
+    return failures != 0;
+}
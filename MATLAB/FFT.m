@@ -46,8 +46,24 @@ fs = 1000; % Sampling frequency (Hz)
 % data = load('data.txt');
 
 
-% 2. Define Sampling Frequency (fs) - Already defined above as 1000 Hz
-data = myDataBuffer;
+% 2. Define Sampling Frequency (fs) from the hardware timestamps
+% Reads one channel of a Host/eds_rx session, only the chunks within tRange
+session = "session";
+channel = 'panasonic';
+tRange = []; % e.g. [600 660] seconds, [] for the whole session
+s = readColumns(session, {channel}, tRange);
+t_us = s.(channel).t * 1e6;
+data = s.(channel).v;
+dt_us = diff(t_us);
+fs = 1e6 / median(dt_us);
+disp(['Sampling: fs = ', num2str(fs), ' Hz, jitter std = ', num2str(std(dt_us)), ...
+    ' us, worst = ', num2str(max(abs(dt_us - median(dt_us)))), ' us']);
+if any(abs(dt_us - median(dt_us)) > median(dt_us) / 2)
+    % Missed ticks break the uniform grid the FFT assumes, resample onto it
+    disp('Warning: non-uniform sampling, resampling onto a uniform grid.');
+    t_uniform = (t_us(1):1e6/fs:t_us(end)).';
+    data = interp1(t_us, data, t_uniform, 'linear');
+end
 % 3. Perform FFT
 N = length(data); % Length of the data
 fft_data = fft(data);
@@ -0,0 +1,78 @@
+function report = compression_benchmark(myDataBuffer, descriptor, stats)
+% COMPRESSION_BENCHMARK Packed frame size per channel on a recorded session
+%   report = compression_benchmark(myDataBuffer, descriptor, stats)
+%   myDataBuffer - rows from parseFrames, e.g. loaded from sensor_data_final.mat
+%   descriptor   - stream descriptor from parseFrames
+%   stats        - optional UsbTxStats_t from a 'Q' request, adds the
+%                  measured device cost and ratio of the encoding in use
+%   report       - table with raw bytes and packed bytes per delta order
+%
+%   Mirrors Core/Src/sample_pack.c: blocks of up to 128 records, each
+%   channel column as uint32 first value, then runs of up to 32 zigzag
+%   residuals with one width byte and width bits per residual. Orders:
+%   0 value, 1 delta, 2 delta of delta. The device also ends a block when
+%   the next record would not fit its 2048-byte frame, which only happens
+%   with many noisy channels, so the estimate is then slightly optimistic.
+blockRecords = 128;     % SAMPLE_PACK_MAX_RECORDS
+runResiduals = 32;      % SAMPLE_PACK_BLOCK
+numChannels = numel(descriptor.kinds);
+names = [{'counter', 'time_us', 'mask'}, descriptor.names];
+block = floor((0:size(myDataBuffer, 1)-1)' / blockRecords);
+
+rawBytes = zeros(3 + numChannels, 1);
+packedBytes = zeros(3 + numChannels, 3);
+for c = 1:3 + numChannels
+    values = myDataBuffer(:, c);
+    valid = ~isnan(values);
+    if c > 3 && descriptor.kinds(c - 3) == 1
+        values = mod(round(values * 16), 2^32);    % Back to the int32 fixed-point bit pattern
+    elseif c > 3 && descriptor.kinds(c - 3) == 3
+        values = mod(round(values * 1000), 2^32);  % Milli channels
+    end
+    rawBytes(c) = 4 * sum(valid);
+    for order = 0:2
+        packedBytes(c, order + 1) = columnBytes(values(valid), block(valid), order, runResiduals) + (c > 3) * numel(unique(block(valid)));
+    end
+end
+
+[bestBytes, bestOrder] = min(packedBytes, [], 2);
+report = table(names', rawBytes, packedBytes(:,1), packedBytes(:,2), packedBytes(:,3), bestOrder - 1, ...
+    rawBytes ./ bestBytes, 'VariableNames', ...
+    {'column', 'raw', 'order0', 'order1', 'order2', 'best_order', 'ratio'});
+disp(report);
+fprintf('Packed with the best order per channel: %.2fx smaller than uint32 frames\n', ...
+    sum(rawBytes) / sum(bestBytes));
+
+if nargin > 2 && ~isempty(stats) && stats.encoded_samples > 0
+    fprintf('Device: %.1f cycles/sample, %.2fx smaller than uint32 frames\n', ...
+        stats.encode_cycles / stats.encoded_samples, stats.raw_bytes / stats.encoded_bytes);
+end
+end
+
+function bytes = columnBytes(values, block, order, runResiduals)
+% Encoded size of one column cut into blocks and runs
+bytes = 0;
+for b = unique(block)'
+    v = values(block == b);
+    bytes = bytes + 4;
+    if numel(v) < 2
+        continue;
+    end
+    d = mod(diff(v), 2^32);
+    switch order
+        case 0
+            r = v(2:end);
+        case 1
+            r = d;
+        otherwise
+            r = mod(d - [0; d(1:end-1)], 2^32);
+    end
+    r(r >= 2^31) = r(r >= 2^31) - 2^32;
+    z = 2 * abs(r) - (r < 0);
+    for k = 1:runResiduals:numel(z)
+        run = z(k:min(k + runResiduals - 1, end));
+        width = ceil(log2(max(run) + 1));
+        bytes = bytes + 1 + ceil(numel(run) * width / 8);
+    end
+end
+end
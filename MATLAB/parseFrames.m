@@ -0,0 +1,245 @@
+function [rows, byteBuffer, sequences, descriptor, stats] = parseFrames(byteBuffer, descriptor)
+% PARSEFRAMES Extract every complete frame from a raw USB byte stream
+%   [rows, byteBuffer, sequences, descriptor, stats] = parseFrames(byteBuffer, descriptor)
+%   byteBuffer - uint8 column of received bytes, the unparsed tail is returned
+%   descriptor - last stream descriptor (optional), updated when one arrives:
+%                .baseRate   base tick rate in Hz
+%                .dividers   one divider per channel, channel rate = baseRate./dividers
+%                .names      channel names from Core/Inc/channel_table.h
+%                .kinds      0 ADC counts, 1 fixed-point, 2 time in us, 3 milli
+%   rows       - one row per sample: [counter time_us mask channel values...]
+%                channels not sampled on that tick are NaN, fixed-point
+%                and milli channels are scaled to their physical value
+%   sequences  - frame sequence number of every parsed frame
+%   stats      - last answer to a 'Q' command, UsbTxStats_t, UsbVescStats_t then UsbControlStats_t
+%                fields, [] if none
+%
+%   Frame layout (little-endian), see Core/Inc/usb_comm.h:
+%   uint32 magic 0xddccbbaa | uint32 sequence | uint8 type | uint8 version |
+%   uint16 count | uint16 payload_size | uint16 reserved | payload
+%   Data frames are type 0 (uint32 per value), type 2 (compact, see
+%   Core/Inc/sample_codec.h) or type 3 (packed, see Core/Inc/sample_pack.h).
+if nargin < 2
+    descriptor = [];
+end
+header = uint8([0xAA; 0xBB; 0xCC; 0xDD]);
+headerSize = 16;
+maxFrameSize = 2048;    % APP_TX_DATA_SIZE
+kinds = [zeros(1, 9) 1 1 2 3 3 3 3];   % DataAcq_Kind_t: panasonic, 8 load cells, set_rpm, rpm, hall_us, VESC v_in, i_motor, duty, temp_mos
+if ~isempty(descriptor)
+    kinds = descriptor.kinds;
+end
+numChannels = numel(kinds);
+
+rows = zeros(0, 3 + numChannels);
+sequences = zeros(0, 1);
+stats = [];
+statNames = {'queue_depth', 'max_queue_depth', 'stall_count', 'busy_count', ...
+    'frames_queued', 'frames_sent', 'bytes_sent', 'bytes_per_sec', ...
+    'encode_cycles', 'encoded_samples', 'encoded_bytes', 'raw_bytes', ...
+    'link_state', 'link_baud', 'tx_dropped', 'telemetry_requests', ...
+    'telemetry_replies', 'telemetry_timeouts', 'telemetry_max_latency_us', ...
+    'motor_sent', 'motor_keepalives', 'motor_coalesced', 'config_valid', ...
+    'config_hash', 'config_writes', 'config_writes_skipped', 'config_changed_fields', ...
+    'control_mode', 'control_computes', 'control_saturations', ...
+    'control_cycles_last', 'control_cycles_max', 'trajectory_state', ...
+    'trajectory_played', 'trajectory_underruns', 'trajectory_banks_free', ...
+    'isr_tick_count', 'isr_tick_cycles_last', 'isr_tick_cycles_max', ...
+    'isr_hall_count', 'isr_hall_cycles_last', 'isr_hall_cycles_max'};
+chunks = {};
+pos = 1;
+n = numel(byteBuffer);
+
+while n - pos + 1 >= headerSize
+    % Vectorized search for the next magic word
+    b = byteBuffer(pos:end);
+    idx = find(b(1:end-3) == header(1) & b(2:end-2) == header(2) & ...
+               b(3:end-1) == header(3) & b(4:end) == header(4), 1);
+    if isempty(idx)
+        pos = n - 2;    % Keep the last bytes, they may start a header
+        break;
+    end
+    start = pos + idx - 1;
+    if n - start + 1 < headerSize
+        pos = start;
+        break;
+    end
+
+    type = byteBuffer(start+8);
+    version = byteBuffer(start+9);
+    count = double(typecast(byteBuffer(start+10:start+11), 'uint16'));
+    payloadSize = double(typecast(byteBuffer(start+12:start+13), 'uint16'));
+    frameLen = headerSize + payloadSize;
+    if version ~= 9 || type > 4 || frameLen > maxFrameSize || (type == 0 && mod(payloadSize, 4) ~= 0)
+        pos = start + 1;    % False magic inside the data, resync
+        continue;
+    end
+    if n - start + 1 < frameLen
+        pos = start;        % Incomplete frame, wait for more bytes
+        break;
+    end
+
+    sequences(end+1, 1) = double(typecast(byteBuffer(start+4:start+7), 'uint32')); %#ok<AGROW>
+    payload = byteBuffer(start+headerSize:start+frameLen-1);
+    if type == 1
+        % Descriptor: uint32 base rate, then per channel
+        % uint8 id | uint8 kind | uint16 divider | char name[12]
+        descriptor.baseRate = double(typecast(payload(1:4), 'uint32'));
+        entries = reshape(payload(5:4+16*count), 16, count);
+        descriptor.kinds = double(entries(2, :));
+        descriptor.dividers = double(typecast(reshape(entries(3:4, :), [], 1), 'uint16'))';
+        descriptor.names = cell(1, count);
+        for c = 1:count
+            name = char(entries(5:16, c))';
+            descriptor.names{c} = name(1:find([name 0] == 0, 1) - 1);
+        end
+        kinds = descriptor.kinds;
+        numChannels = count;
+    elseif count > 0 && type == 0
+        chunks{end+1} = scaleFixed(decodeSamples(typecast(payload, 'uint32'), count, numChannels), kinds); %#ok<AGROW>
+    elseif type == 4
+        values = double(typecast(payload, 'uint32'));
+        stats = cell2struct(num2cell(values(1:numel(statNames))), statNames, 1);
+    elseif count > 0 && type == 2
+        chunks{end+1} = scaleFixed(decodeCompact(double(payload), count, kinds), kinds); %#ok<AGROW>
+    elseif count > 0
+        chunks{end+1} = scaleFixed(decodePacked(double(payload), count, numChannels), kinds); %#ok<AGROW>
+    end
+    pos = start + frameLen;
+end
+
+if ~isempty(chunks)
+    rows = vertcat(chunks{:});
+end
+byteBuffer = byteBuffer(max(pos, 1):end);
+end
+
+function rows = decodeSamples(words, count, numChannels)
+% Samples are [counter time_us mask values...] with one value per set mask bit
+words = double(words);
+rows = nan(count, 3 + numChannels);
+mask = words(3);
+bits = find(bitget(mask, 1:numChannels));
+sampleLen = 3 + numel(bits);
+
+% Fast path: every sample in the frame carries the same channels
+if numel(words) == count*sampleLen && all(words(3:sampleLen:end) == mask)
+    block = reshape(words, sampleLen, count)';
+    rows(:, 1:3) = block(:, 1:3);
+    rows(:, 3 + bits) = block(:, 4:end);
+    return;
+end
+
+w = 1;
+for k = 1:count
+    mask = words(w+2);
+    bits = find(bitget(mask, 1:numChannels));
+    rows(k, 1:3) = words(w:w+2);
+    rows(k, 3 + bits) = words(w+3:w+2+numel(bits));
+    w = w + 3 + numel(bits);
+end
+end
+
+function rows = scaleFixed(rows, kinds)
+% Fixed-point values are int32 * 2^4 (DATAACQ_FIXED_FRAC_BITS), milli values int32 * 1000
+cols = 3 + find(kinds == 1 | kinds == 3);
+scale = 16 + (1000 - 16) * (kinds(cols - 3) == 3);
+v = rows(:, cols);
+v(v >= 2^31) = v(v >= 2^31) - 2^32;
+rows(:, cols) = v ./ scale;
+end
+
+function rows = decodeCompact(p, count, kinds)
+% Sample: uint8 counter delta, 255 escapes to uint32 counter | uint32 time_us,
+% otherwise uint16 time delta | uint24 mask | ADC values, two 12-bit per
+% 3 bytes and an odd last one in 2 | 3 bytes per derived value
+numChannels = numel(kinds);
+rows = nan(count, 3 + numChannels);
+pos = 1;
+counter = 0;
+t = 0;
+for k = 1:count
+    if p(pos) == 255
+        counter = p(pos+1) + 256*p(pos+2) + 65536*p(pos+3) + 16777216*p(pos+4);
+        t = p(pos+5) + 256*p(pos+6) + 65536*p(pos+7) + 16777216*p(pos+8);
+        pos = pos + 9;
+    else
+        counter = mod(counter + p(pos), 2^32);
+        t = mod(t + p(pos+1) + 256*p(pos+2), 2^32);
+        pos = pos + 3;
+    end
+    mask = p(pos) + 256*p(pos+1) + 65536*p(pos+2);
+    pos = pos + 3;
+    bits = find(bitget(mask, 1:numChannels));
+    adc = bits(kinds(bits) == 0);
+    derived = bits(kinds(bits) ~= 0);
+
+    numPairs = floor(numel(adc) / 2);
+    b = reshape(p(pos:pos+3*numPairs-1), 3, numPairs);
+    pos = pos + 3*numPairs;
+    v = [b(1,:) + 256*mod(b(2,:), 16); floor(b(2,:) / 16) + 16*b(3,:)];
+    v = v(:)';
+    if mod(numel(adc), 2)
+        v(end+1) = mod(p(pos) + 256*p(pos+1), 4096); %#ok<AGROW>
+        pos = pos + 2;
+    end
+
+    d = reshape(p(pos:pos+3*numel(derived)-1), 3, []);
+    pos = pos + 3*numel(derived);
+    d = d(1,:) + 256*d(2,:) + 65536*d(3,:);
+    fixed = kinds(derived) ~= 2;
+    d(fixed) = mod(d(fixed) - 2^24*(d(fixed) >= 2^23), 2^32);   % int32 bit pattern like type 0
+    d(~fixed) = mod(t - d(~fixed), 2^32);   % Time channels carry their age before the sample
+
+    rows(k, 1:3) = [counter t mask];
+    rows(k, 3 + adc) = v;
+    rows(k, 3 + derived) = d;
+end
+end
+
+function rows = decodePacked(p, count, numChannels)
+% Columns counter, time_us, mask, then one per sampled channel led by its order byte
+pos = 1;
+[counter, pos] = getColumn(p, pos, count, 2);
+[t, pos] = getColumn(p, pos, count, 2);
+[mask, pos] = getColumn(p, pos, count, 1);
+rows = nan(count, 3 + numChannels);
+rows(:, 1:3) = [counter t mask];
+for ch = 1:numChannels
+    has = bitget(mask, ch) == 1;
+    if ~any(has)
+        continue;
+    end
+    order = p(pos);
+    [rows(has, 3 + ch), pos] = getColumn(p, pos + 1, sum(has), order);
+end
+end
+
+function [values, pos] = getColumn(p, pos, count, order)
+% uint32 first value, then runs of up to 32 zigzag residuals sharing one bit width
+first = p(pos) + 256*p(pos+1) + 65536*p(pos+2) + 16777216*p(pos+3);
+pos = pos + 4;
+r = zeros(count - 1, 1);
+i = 1;
+while i <= count - 1
+    run = min(32, count - i);
+    width = p(pos);
+    numBytes = ceil(run * width / 8);
+    if width > 0
+        bits = bitget(repmat(p(pos+1:pos+numBytes), 1, 8), repmat(1:8, numBytes, 1))';
+        bits = reshape(bits(1:run*width), width, run);
+        z = (2.^(0:width-1)) * bits;
+        r(i:i+run-1) = (z(:) / 2) .* (mod(z(:), 2) == 0) - ((z(:) + 1) / 2) .* (mod(z(:), 2) == 1);
+    end
+    pos = pos + 1 + numBytes;
+    i = i + run;
+end
+switch order
+    case 0
+        values = mod([first; r], 2^32);
+    case 1
+        values = mod(first + [0; cumsum(r)], 2^32);
+    otherwise
+        values = mod(first + [0; cumsum(cumsum(r))], 2^32);
+end
+end
@@ -1,23 +1,31 @@
 clear all
 clc
-load("sensor_data_final.mat")
+% Session directory written by Host/eds_rx, tRange in seconds or [] for all
+session = "session";
+tRange = [];
+s = readColumns(session, {'records', 'set_rpm', 'rpm'}, tRange);
 
-cnt = myDataBuffer(:,1);
-time_ms = myDataBuffer(:,2);
-adc_1 = myDataBuffer(:,3);
-motor_rpm = myDataBuffer(:,11)/1000;
-motor_cmd = myDataBuffer(:,10)/1000;
+cnt = s.records.v;
+time_s = s.records.t;
+motor_rpm = s.rpm.v;
+motor_cmd = s.set_rpm.v;
 
 figure(2)
-plot(time_ms,motor_rpm);
+plot(s.rpm.t,motor_rpm);
 hold on
-plot(time_ms,motor_cmd/7,"LineWidth",1);
+plot(s.set_rpm.t,motor_cmd/7,"LineWidth",1);
 legend("Actual","Reference")
 
 
 figure(3)
-plot(time_ms,cnt);
+plot(time_s,cnt);
 
+% Tick jitter from the hardware timestamps
+dt_us = diff(time_s) * 1e6;
+figure(4)
+histogram(dt_us - median(dt_us));
+xlabel("Tick interval deviation (us)")
 
 
-detectJumps(myDataBuffer(:,2),1)
\ No newline at end of file
+
+detectJumps(time_s*1e6,1)
\ No newline at end of file
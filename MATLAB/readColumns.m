@@ -0,0 +1,147 @@
+function [session, meta] = readColumns(directory, names, tRange)
+% READCOLUMNS Load a session written by Host/eds_rx
+%   [session, meta] = readColumns(directory)
+%   [session, meta] = readColumns(directory, names, tRange)
+%   directory - session directory
+%   names     - optional cell array of channel names, e.g. {'rpm'},
+%               default all channels plus 'records'
+%   tRange    - optional [start stop] in seconds, default everything
+%   session   - struct with one field per column, each with
+%               .t     time in seconds since the first record
+%               .v     value: ADC counts, fixed-point and milli scaling
+%                      divided out, or microseconds; the record counter
+%                      for 'records'
+%               .index per-chunk t_first, t_last (s), min, max (scaled)
+%   meta      - key/value pairs from meta.txt, numbers converted
+%
+%   Only the chunks that overlap tRange are memory-mapped, so slicing a
+%   multi-hour session costs about as much as the slice itself. The
+%   index alone is enough for an overview plot of min/max envelopes.
+meta = readMeta(fullfile(directory, 'meta.txt'));
+if meta.format ~= "eds_columns 2"
+    error('readColumns: unsupported format "%s"', meta.format);
+end
+fracScale = 2^meta.fixed_frac_bits;
+
+columns = {'records', 'u32', 0};
+for ch = 0:meta.channels - 1
+    entry = strsplit(meta.(sprintf('channel%d', ch)));
+    columns(end+1, :) = {entry{1}, 'i32', str2double(entry{2})}; %#ok<AGROW>
+end
+if nargin > 1 && ~isempty(names)
+    columns = columns(ismember(columns(:, 1), names), :);
+end
+if nargin < 3
+    tRange = [];
+end
+
+% Session time zero is the first record
+records = readIndex(fullfile(directory, 'records.idx'));
+origin = 0;
+if ~isempty(records.t_first)
+    origin = records.t_first(1);
+end
+
+session = struct();
+for c = 1:size(columns, 1)
+    [name, suffix, kind] = columns{c, :};
+    index = readIndex(fullfile(directory, [name '.idx']));
+    [t, v] = readSlice(fullfile(directory, name), suffix, index, tRange, origin);
+    scale = 1;
+    if kind == 1
+        scale = fracScale;     % DATAACQ_KIND_FIXED
+    elseif kind == 3
+        scale = 1000;          % DATAACQ_KIND_MILLI
+    end
+    index.t_first = (index.t_first - origin) / 1e6;
+    index.t_last = (index.t_last - origin) / 1e6;
+    index.min = index.min / scale;
+    index.max = index.max / scale;
+    session.(matlab.lang.makeValidName(name)) = struct('t', t, 'v', v / scale, ...
+        'index', index, 'kind', kind);
+end
+end
+
+function [t, v] = readSlice(base, suffix, index, tRange, origin)
+% Map the samples of the chunks overlapping tRange and unwrap their time
+if isempty(index.count)
+    t = zeros(0, 1);
+    v = zeros(0, 1);
+    return;
+end
+if isempty(tRange)
+    selected = true(size(index.count));
+else
+    limits = tRange * 1e6 + origin;
+    selected = index.t_last >= limits(1) & index.t_first <= limits(2);
+end
+first = find(selected, 1, 'first');
+last = find(selected, 1, 'last');
+if isempty(first)
+    t = zeros(0, 1);
+    v = zeros(0, 1);
+    return;
+end
+offset = index.first_sample(first);
+count = index.first_sample(last) + index.count(last) - offset;
+
+time32 = double(mapColumn([base '.t.u32'], 'uint32', offset, count));
+step = diff(time32);
+step(step < 0) = step(step < 0) + 2^32;     % TIM5 wrapped
+t = index.t_first(first) + [0; cumsum(step)];
+if suffix == "u32"
+    v = double(mapColumn([base '.' suffix], 'uint32', offset, count));
+else
+    v = double(mapColumn([base '.' suffix], 'int32', offset, count));
+end
+
+if ~isempty(tRange)
+    keep = t >= limits(1) & t <= limits(2);
+    t = t(keep);
+    v = v(keep);
+end
+t = (t - origin) / 1e6;
+end
+
+function values = mapColumn(path, type, offset, count)
+m = memmapfile(path, 'Format', type, 'Offset', offset * 4, 'Repeat', count);
+values = m.Data;
+end
+
+function index = readIndex(path)
+% EdsChunkIndex_t entries, 40 bytes each
+info = dir(path);
+index = struct('first_sample', zeros(0, 1), 't_first', zeros(0, 1), 't_last', zeros(0, 1), ...
+    'count', zeros(0, 1), 'min', zeros(0, 1), 'max', zeros(0, 1));
+if isempty(info) || info.bytes < 40
+    return;
+end
+m = memmapfile(path, 'Format', { ...
+    'uint64', [1 1], 'first_sample'; 'uint64', [1 1], 't_first'; 'uint64', [1 1], 't_last'; ...
+    'uint32', [1 1], 'count'; 'int32', [1 1], 'min'; 'int32', [1 1], 'max'; ...
+    'uint32', [1 1], 'reserved'});
+entries = m.Data;
+index.first_sample = double([entries.first_sample]');
+index.t_first = double([entries.t_first]');
+index.t_last = double([entries.t_last]');
+index.count = double([entries.count]');
+index.min = double([entries.min]');
+index.max = double([entries.max]');
+end
+
+function meta = readMeta(path)
+meta = struct();
+lines = strsplit(fileread(path), newline);
+for i = 1:numel(lines)
+    parts = strsplit(lines{i}, ' = ');
+    if numel(parts) ~= 2
+        continue;
+    end
+    number = str2double(parts{2});
+    if isnan(number)
+        meta.(parts{1}) = parts{2};
+    else
+        meta.(parts{1}) = number;
+    end
+end
+end
@@ -6,11 +6,10 @@ function usb_data_gui()
     handles = guihandles(fig); % Get handles to GUI objects
     handles.isRunning = false;
     handles.s = [];
-    handles.dataBuffer = zeros(0, 7); % Initialize dataBuffer as 0x6 matrix to enforce column number
-    myDataBuffer = zeros(0, 7); % Initialize dataBuffer as 0x6 matrix to enforce column number
+    handles.dataBuffer = zeros(0, 23); % Initialize dataBuffer as 0x23 matrix to enforce column number
+    myDataBuffer = zeros(0, 23); % counter, time_us, mask + 20 channels, one row per sample
+    descriptor = []; % Base rate and channel dividers reported by the STM32
     handles.byteBuffer = uint8([]);
-    handles.header = uint8([0xAA, 0xBB, 0xCC, 0xDD]);
-    handles.packetSize = 28; % Header + Packet Counter + 5 Data Values (uint32_t)
     guidata(fig, handles); % Store handles in figure's user data
     % --- Helper Functions (nested within usb_data_gui_final for access to handles) ---
     function fig = create_gui()
@@ -52,7 +51,7 @@ function usb_data_gui()
             set(handles.statusText, 'String', ['Error opening port: ', e.message]);
             return;
         end
-        handles.dataBuffer = zeros(0, 6); % Re-initialize dataBuffer at start as 0x6 matrix
+        handles.dataBuffer = zeros(0, 23); % Re-initialize dataBuffer at start as 0x23 matrix
         handles.byteBuffer = uint8([]);
         handles.isRunning = true;
         set(handles.statusText, 'String', 'Running... Press "P" to stop.');
@@ -102,45 +101,25 @@ function usb_data_gui()
         % Main data acquisition loop
         handles = guidata(gcbo); % Get handles at start of loop
         packet_count = 0;
-        missed_header_count = 0;
+        lost_frame_count = 0;
+        lastSequence = [];
+        rawFile = fopen('sensor_data_raw.bin', 'w'); % Raw stream, Host/eds_rx -i converts it to columns
         while handles.isRunning
             try
                 if handles.s.NumBytesAvailable > 0
                     newBytes = read(handles.s, handles.s.NumBytesAvailable, 'uint8');
-                    handles.byteBuffer = [handles.byteBuffer; newBytes(:)];
+                    fwrite(rawFile, newBytes, 'uint8');
+                    handles.byteBuffer = [handles.byteBuffer; uint8(newBytes(:))];
                 end
-                while numel(handles.byteBuffer) >= handles.packetSize
-                    headerIdx = findHeader(handles.byteBuffer, handles.header);
-                    if ~isempty(headerIdx)
-                        if (numel(handles.byteBuffer) >= headerIdx + handles.packetSize - 1)
-                            packet = handles.byteBuffer(headerIdx:headerIdx + handles.packetSize - 1);
-                            handles.byteBuffer(1:headerIdx + handles.packetSize - 1) = [];
-                            values = typecast(packet(9:end), 'uint32'); % Skip header and packet counter
-                            packet_info = typecast(packet(5:end), 'uint32'); % Get packet counter value
-                            packet_data = [packet_info(:); values(:)]; % Force both to be column vectors
-                            % whos handles.dataBuffer packet_data' % Debug: Check dimensions
-                            %handles.dataBuffer = [handles.dataBuffer; packet_data']; % Concatenate vertically
-                            myDataBuffer = [myDataBuffer;packet_data'];
-                            packet_count = packet_count + 1;
-                        else
-                            break; % Incomplete packet
-                        end
-                    else
-                        missed_header_count = missed_header_count + 1;
-                        if numel(handles.byteBuffer) > numel(handles.header)
-                            handles.byteBuffer(1) = []; % Remove first byte
-                        else
-                            break; % Buffer too small
-                        end
-                        if missed_header_count > 1000
-                            handles.isRunning = false;
-                            set(handles.statusText, 'String', 'Too many header losses - stopped.');
-                            guidata(gcbo, handles);
-                            break;
-                        end
-                        break; % Search for header again
-                    end
+                % Each frame carries many samples, parse all complete frames at once
+                [packet_data, handles.byteBuffer, sequences, descriptor] = ...
+                    parseFrames(handles.byteBuffer, descriptor);
+                if ~isempty(sequences)
+                    lost_frame_count = lost_frame_count + sum(diff([lastSequence; sequences]) ~= 1);
+                    lastSequence = sequences(end);
                 end
+                myDataBuffer = [myDataBuffer; packet_data];
+                packet_count = packet_count + size(packet_data, 1);
                 pause(0.0005); % Small delay
                 handles = guidata(gcbo); % Get updated handles in each loop iteration (for stop command check)
             catch serial_error
@@ -154,32 +133,10 @@ function usb_data_gui()
         if ~handles.isRunning && ~isempty(handles.s) && isvalid(handles.s) % Check if serial port is valid before clearing/closing
             clear handles.s;
         end
-        save('sensor_data_final.mat','handles','packet_count', 'missed_header_count','packet_data',"myDataBuffer");
-        disp(['Complete. Processed Packets: ', num2str(packet_count), ', Missed Headers: ', num2str(missed_header_count)]);
+        fclose(rawFile);
+        save('sensor_data_final.mat','packet_count', 'lost_frame_count',"myDataBuffer","descriptor");
+        disp(['Complete. Processed Samples: ', num2str(packet_count), ', Lost Frames: ', num2str(lost_frame_count)]);
         set(handles.statusText, 'String', 'Data saved to sensor_data_final.mat.');
         guidata(gcbo, handles); % Update handles one last time before exit
     end % end of data_acquisition_loop
-    function headerIdx = findHeader(buffer, header)
-        % Helper function - Manual Byte Comparison - Optimized
-        headerLen = numel(header);
-        bufferLen = numel(buffer);
-        headerIdx = [];
-        if bufferLen < headerLen
-            return;
-        end
-        for idx = 1:bufferLen - headerLen + 1
-            current_segment = buffer(idx:idx+headerLen-1);
-            isHeader = true;
-            for byteIdx = 1:headerLen
-                if current_segment(byteIdx) ~= header(byteIdx)
-                    isHeader = false;
-                    break;
-                end
-            end
-            if isHeader
-                headerIdx = idx;
-                return;
-            end
-        end
-    end % end of findHeader
 end % end of main function usb_data_gui_final"
\ No newline at end of file
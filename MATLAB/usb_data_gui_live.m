@@ -6,10 +6,9 @@ function usb_data_gui()
     handles = guihandles(fig); 
     handles.isRunning = false;
     handles.s = [];
-    handles.dataBuffer = zeros(0, 6); % 6 columns: packet counter + 5 data values
+    handles.dataBuffer = zeros(0, 23); % counter, time_us, mask + 20 channels
+    handles.descriptor = [];
     handles.byteBuffer = uint8([]);
-    handles.header = uint8([0xAA, 0xBB, 0xCC, 0xDD]);
-    handles.packetSize = 28; 
     guidata(fig, handles); 
 
     % --- Nested Helper Functions ---
@@ -32,16 +31,18 @@ function usb_data_gui()
         % Plot Axes
         ax = axes('Parent', fig, 'Position', [0.1 0.2 0.8 0.7], 'Tag', 'dataAxes');
         hold(ax, 'on');
-        colors = lines(5); % Colors for 5 data channels
-        for i = 1:5
+        colors = lines(11); % Colors for 11 data channels
+        for i = 1:11
             line('XData', [], 'YData', [], 'Color', colors(i,:), ...
                 'Parent', ax, 'Tag', ['line' num2str(i)]);
         end
         hold(ax, 'off');
-        xlabel(ax, 'Packet Counter');
+        xlabel(ax, 'Time (s)');
         ylabel(ax, 'Value');
         title(ax, 'Real-time Data');
-        legend(ax, {'Data1', 'Data2', 'Data3', 'Data4', 'Data5'});
+        legend(ax, {'panasonic', 'load_cell_1', 'load_cell_2', 'load_cell_3', ...
+            'load_cell_4', 'load_cell_5', 'load_cell_6', 'load_cell_7', ...
+            'load_cell_8', 'set_rpm', 'rpm'}, 'Interpreter', 'none');
     end
 
     function startCallback(~, ~)
@@ -59,8 +60,9 @@ function usb_data_gui()
             set(handles.statusText, 'String', ['Error: ', e.message]);
             return;
         end
-        handles.dataBuffer = zeros(0, 6); 
+        handles.dataBuffer = zeros(0, 23); 
         handles.byteBuffer = uint8([]);
+        handles.descriptor = [];
         handles.isRunning = true;
         set(handles.statusText, 'String', 'Running... Press "P" to stop.');
         guidata(gcbo, handles);
@@ -94,41 +96,34 @@ function usb_data_gui()
     function data_acquisition_loop()
         handles = guidata(gcbo);
         packet_count = 0;
-        missed_header_count = 0;
+        lost_frame_count = 0;
+        lastSequence = [];
         lastPlotUpdate = tic; 
+        rawFile = fopen('sensor_data_raw.bin', 'w'); % Raw stream, Host/eds_rx -i converts it to columns
         
         while handles.isRunning
             try
                 if handles.s.NumBytesAvailable > 0
                     newBytes = read(handles.s, handles.s.NumBytesAvailable, 'uint8');
-                    handles.byteBuffer = [handles.byteBuffer; newBytes(:)];
+                    fwrite(rawFile, newBytes, 'uint8');
+                    handles.byteBuffer = [handles.byteBuffer; uint8(newBytes(:))];
                 end
                 
-                while numel(handles.byteBuffer) >= handles.packetSize
-                    headerIdx = findHeader(handles.byteBuffer, handles.header);
-                    if ~isempty(headerIdx)
-                        if (numel(handles.byteBuffer) >= headerIdx + handles.packetSize - 1
-                            packet = handles.byteBuffer(headerIdx:headerIdx + handles.packetSize - 1);
-                            handles.byteBuffer(1:headerIdx + handles.packetSize - 1) = [];
-                            
-                            % Parse packet
-                            packet_counter = typecast(packet(5:8), 'uint32');
-                            data_values = typecast(packet(9:end), 'uint32');
-                            new_row = [packet_counter; data_values]';
-                            handles.dataBuffer = [handles.dataBuffer; new_row];
-                            packet_count = packet_count + 1;
-                            
-                            % Update plot every 0.1 seconds
-                            if toc(lastPlotUpdate) >= 0.1
-                                update_plot(handles.dataBuffer);
-                                lastPlotUpdate = tic;
-                            end
-                        end
-                    else
-                        missed_header_count = missed_header_count + 1;
-                        if numel(handles.byteBuffer) > numel(handles.header)
-                            handles.byteBuffer(1) = [];
-                        end
+                % Parse every complete frame in one pass
+                [rows, handles.byteBuffer, sequences, handles.descriptor] = ...
+                    parseFrames(handles.byteBuffer, handles.descriptor);
+                if ~isempty(sequences)
+                    lost_frame_count = lost_frame_count + sum(diff([lastSequence; sequences]) ~= 1);
+                    lastSequence = sequences(end);
+                end
+                if ~isempty(rows)
+                    handles.dataBuffer = [handles.dataBuffer; rows];
+                    packet_count = packet_count + size(rows, 1);
+                    
+                    % Update plot every 0.1 seconds
+                    if toc(lastPlotUpdate) >= 0.1
+                        update_plot(handles.dataBuffer);
+                        lastPlotUpdate = tic;
                     end
                 end
                 pause(0.0005);
@@ -146,7 +141,10 @@ function usb_data_gui()
         if ~isempty(handles.s) && isvalid(handles.s)
             clear handles.s;
         end
-        save('sensor_data_final.mat', 'handles', 'packet_count', 'missed_header_count');
+        fclose(rawFile);
+        myDataBuffer = handles.dataBuffer;
+        descriptor = handles.descriptor;
+        save('sensor_data_final.mat', 'packet_count', 'lost_frame_count', 'myDataBuffer', 'descriptor');
         set(handles.statusText, 'String', 'Data saved.');
         guidata(gcbo, handles);
     end
@@ -154,10 +152,12 @@ function usb_data_gui()
     function update_plot(data)
         ax = findobj(fig, 'Tag', 'dataAxes');
         if ~isempty(data)
-            xData = data(:,1);
-            for i = 1:5
+            xData = data(:,2) / 1e6;
+            for i = 1:11 % hall_us is a timestamp, not plotted
+                % Channels run at their own rates, skip the ticks they were not sampled on
+                valid = ~isnan(data(:,i+3));
                 line = findobj(ax, 'Tag', ['line' num2str(i)]);
-                set(line, 'XData', xData, 'YData', data(:,i+1));
+                set(line, 'XData', xData(valid), 'YData', data(valid,i+3));
             end
             % Adjust x-axis to show latest 100 points
             if length(xData) > 100
@@ -168,15 +168,4 @@ function usb_data_gui()
             drawnow limitrate;
         end
     end
-
-    function headerIdx = findHeader(buffer, header)
-        headerLen = length(header);
-        for idx = 1:length(buffer)-headerLen+1
-            if isequal(buffer(idx:idx+headerLen-1), header)
-                headerIdx = idx;
-                return;
-            end
-        end
-        headerIdx = [];
-    end
 end
\ No newline at end of file